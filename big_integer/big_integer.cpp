@@ -36,6 +36,17 @@ BigInt& BigInt::operator=(const BigInt& other) {
   return *this;
 }
 
+BigInt& BigInt::operator=(BigInt&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+  digits_.swap(other.digits_);
+  std::swap(is_negative_, other.is_negative_);
+  other.digits_.clear();
+  other.is_negative_ = false;
+  return *this;
+}
+
 static int DigitValue(char digit) {
   const int kValueOfA = 10;
   if ('0' <= digit && digit <= '9') {
@@ -326,8 +337,8 @@ BigInt BigInt::operator--(int) {
 }
 
 BigInt operator*(const BigInt& left, const BigInt& right) {
-  BigInt result = left;
-  result *= right;
+  BigInt result;
+  result.AddMul(left, right);
   return result;
 }
 
@@ -370,6 +381,52 @@ BigInt& BigInt::operator*=(const BigInt& factor) {
   return *this;
 }
 
+void BigInt::AddMulAbs(const BigInt& left, const BigInt& right) {
+  // one extra digit for the final carry
+  size_t size = digits_.size();
+  if (size < left.Size() + right.Size()) {
+    size = left.Size() + right.Size();
+  }
+  digits_.resize(size + 1);
+
+  for (size_t i = 0; i < left.Size(); i++) {
+    uint64_t carry = 0;
+    size_t j = i;
+    for (size_t k = 0; k < right.Size(); k++, j++) {
+      uint64_t tmp = (uint64_t)digits_[j] +
+                     (uint64_t)left.digits_[i] * right.digits_[k] + carry;
+      digits_[j] = tmp % kBase;
+      carry = tmp / kBase;
+    }
+    for (; carry != 0; j++) {
+      uint64_t tmp = (uint64_t)digits_[j] + carry;
+      digits_[j] = tmp % kBase;
+      carry = tmp / kBase;
+    }
+  }
+
+  Normalize();
+}
+
+void BigInt::AddMul(const BigInt& left, const BigInt& right) {
+  if (left.IsZero() || right.IsZero()) {
+    return;
+  }
+  bool negative = left.is_negative_ != right.is_negative_;
+  if (this == &left || this == &right ||
+      (!IsZero() && is_negative_ != negative)) {
+    // the product buffer is reused by later calls in this thread
+    static thread_local BigInt product;
+    product.digits_.clear();
+    product.AddMulAbs(left, right);
+    product.is_negative_ = negative;
+    *this += product;
+    return;
+  }
+  is_negative_ = negative;
+  AddMulAbs(left, right);
+}
+
 static unsigned DivideBinSearch(const BigInt& dividend, const BigInt& divisor) {
   long long left = 0;
   long long right = BigInt::kBase;
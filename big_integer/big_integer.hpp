@@ -2,6 +2,7 @@
 #include <cstdint>
 #include <iostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 static const int kDecimalBase = 10;
@@ -19,11 +20,15 @@ class BigInt {
   BigInt(const std::string& s);
   BigInt(const char* c_string) : BigInt(std::string(c_string)){};
   BigInt(const BigInt& other) { *this = other; }
+  BigInt(BigInt&& other) noexcept { *this = std::move(other); }
   ~BigInt(){};
 
   // assignment operator
   BigInt& operator=(const BigInt& other);
 
+  // move assignment, other becomes zero
+  BigInt& operator=(BigInt&& other) noexcept;
+
   // unary minus
   BigInt& operator-();
   BigInt operator-() const;
@@ -40,6 +45,13 @@ class BigInt {
   BigInt& operator*=(const BigInt& factor);
   friend BigInt operator*(const BigInt& left, const BigInt& right);
 
+  // Fused multiply-add: this += left * right without a temporary
+  // product when the signs allow adding absolute values
+  void AddMul(const BigInt& left, const BigInt& right);
+  friend void AddMul(BigInt& acc, const BigInt& left, const BigInt& right) {
+    acc.AddMul(left, right);
+  }
+
   // Division operator
   BigInt& operator/=(const BigInt& divisor);
   friend BigInt operator/(const BigInt& left, const BigInt& right);
@@ -126,6 +138,10 @@ class BigInt {
   // remove trailling zeros
   void Normalize();
 
+  // add product of absolute values
+  // |this| := |this| + |left| * |right|
+  void AddMulAbs(const BigInt& left, const BigInt& right);
+
   // add absolute values
   // |this| := |this| + |to_add|
   void AddAbs(const BigInt& to_add);
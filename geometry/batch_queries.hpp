@@ -0,0 +1,39 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// пакеты меньше этого числа запросов выполняются в вызывающем потоке
+static const size_t kMinParallelQueries = 256;
+
+// Ответы answer(queries[i]) на все запросы пакета: запросы делятся на
+// thread_count непрерывных частей (0 - по числу аппаратных потоков),
+// каждую часть обрабатывает свой поток; ответ i - для запроса i
+template <typename Answer, typename Query, typename AnswerQuery>
+std::vector<Answer> AnswerQueries(const std::vector<Query>& queries,
+                                  size_t thread_count,
+                                  const AnswerQuery& answer) {
+  std::vector<Answer> answers(queries.size());
+  if (thread_count == 0) {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+  thread_count = std::min(
+      thread_count, std::max<size_t>(queries.size() / kMinParallelQueries, 1));
+  auto run = [&](size_t part) {
+    size_t begin = queries.size() * part / thread_count;
+    size_t end = queries.size() * (part + 1) / thread_count;
+    for (size_t i = begin; i < end; i++) {
+      answers[i] = answer(queries[i]);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t part = 1; part < thread_count; part++) {
+    threads.emplace_back(run, part);
+  }
+  run(0);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  return answers;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <cstdint>
+
+// Точные знаки выражений из произведений целых чисел, которые не
+// помещаются в int64_t. Проверки адаптивные: если множители малы, знак
+// считается в int64_t, иначе в __int128, а произведения, не
+// помещающиеся и в 128 бит, сравниваются по 64-битным частям.
+namespace exact {
+
+// Множители меньше этого числа по модулю перемножаются в int64_t:
+// произведения меньше 2^60, и их сумма или разность тоже помещается
+static const int64_t kSmallFactor = int64_t(1) << 30;
+
+inline int Sign(int64_t value) { return (value > 0) - (value < 0); }
+
+inline int Sign(__int128 value) { return (value > 0) - (value < 0); }
+
+inline bool IsSmall(int64_t value) {
+  return static_cast<uint64_t>(value) + kSmallFactor <
+         static_cast<uint64_t>(2 * kSmallFactor);
+}
+
+inline bool IsSmall(__int128 value) {
+  return static_cast<unsigned __int128>(value + kSmallFactor) <
+         static_cast<unsigned __int128>(2 * kSmallFactor);
+}
+
+// Старшие и младшие 128 бит произведения left * right
+inline void MultiplyWide(unsigned __int128 left, unsigned __int128 right,
+                         unsigned __int128& high, unsigned __int128& low) {
+  using Wide = unsigned __int128;
+  Wide left_low = static_cast<uint64_t>(left);
+  Wide left_high = left >> 64;
+  Wide right_low = static_cast<uint64_t>(right);
+  Wide right_high = right >> 64;
+  Wide low_low = left_low * right_low;
+  Wide low_high = left_low * right_high;
+  Wide high_low = left_high * right_low;
+  // the carry into bits 128 and above is at most 2
+  Wide middle = (low_low >> 64) + static_cast<uint64_t>(low_high) +
+                static_cast<uint64_t>(high_low);
+  low = (middle << 64) | static_cast<uint64_t>(low_low);
+  high = left_high * right_high + (low_high >> 64) + (high_low >> 64) +
+         (middle >> 64);
+}
+
+// Знак left_a * left_b - right_a * right_b для неотрицательных множителей
+inline int CompareWideProducts(unsigned __int128 left_a,
+                               unsigned __int128 left_b,
+                               unsigned __int128 right_a,
+                               unsigned __int128 right_b) {
+  unsigned __int128 left_high = 0;
+  unsigned __int128 left_low = 0;
+  unsigned __int128 right_high = 0;
+  unsigned __int128 right_low = 0;
+  MultiplyWide(left_a, left_b, left_high, left_low);
+  MultiplyWide(right_a, right_b, right_high, right_low);
+  if (left_high != right_high) {
+    return left_high > right_high ? 1 : -1;
+  }
+  return (left_low > right_low) - (left_low < right_low);
+}
+
+// Знак left_a * left_b - right_a * right_b; сами произведения могут не
+// поместиться в __int128. Множители - любые, кроме минимального __int128
+inline int CompareProducts(__int128 left_a, __int128 left_b, __int128 right_a,
+                           __int128 right_b) {
+  if (IsSmall(left_a) && IsSmall(left_b) && IsSmall(right_a) &&
+      IsSmall(right_b)) {
+    auto left = static_cast<int64_t>(left_a) * static_cast<int64_t>(left_b);
+    auto right = static_cast<int64_t>(right_a) * static_cast<int64_t>(right_b);
+    return (left > right) - (left < right);
+  }
+  int left_sign = Sign(left_a) * Sign(left_b);
+  int right_sign = Sign(right_a) * Sign(right_b);
+  if (left_sign != right_sign) {
+    return left_sign > right_sign ? 1 : -1;
+  }
+  if (left_sign == 0) {
+    return 0;
+  }
+  auto magnitude = [](__int128 value) {
+    return static_cast<unsigned __int128>(value < 0 ? -value : value);
+  };
+  unsigned __int128 left_a_abs = magnitude(left_a);
+  unsigned __int128 left_b_abs = magnitude(left_b);
+  unsigned __int128 right_a_abs = magnitude(right_a);
+  unsigned __int128 right_b_abs = magnitude(right_b);
+  int order = 0;
+  if (((left_a_abs | left_b_abs | right_a_abs | right_b_abs) >> 64) == 0) {
+    unsigned __int128 left = left_a_abs * left_b_abs;
+    unsigned __int128 right = right_a_abs * right_b_abs;
+    order = (left > right) - (left < right);
+  } else {
+    order = CompareWideProducts(left_a_abs, left_b_abs, right_a_abs,
+                                right_b_abs);
+  }
+  return left_sign > 0 ? order : -order;
+}
+
+}  // namespace exact
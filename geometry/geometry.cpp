@@ -1,6 +1,50 @@
 #include "geometry.hpp"
 
+#include <algorithm>
 #include <cstdint>
+#include <limits>
+
+#include "exact.hpp"
+
+static const int64_t kMinCoord = std::numeric_limits<int64_t>::min();
+static const int64_t kMaxCoord = std::numeric_limits<int64_t>::max();
+
+bool Box::IsBounded() const {
+  return min_x != kMinCoord && min_y != kMinCoord && max_x != kMaxCoord &&
+         max_y != kMaxCoord;
+}
+
+// The predicates are exact for all coordinates whose differences fit into
+// int64_t, as everywhere in Vector arithmetic. Signs of cross and dot
+// products of such differences are computed in int64_t when both vectors
+// are small, which is almost always the case, and in __int128 otherwise.
+
+static bool IsSmall(const Vector& vector) {
+  return exact::IsSmall(vector.GetX()) && exact::IsSmall(vector.GetY());
+}
+
+// sign of first ^ second
+static int CrossSign(const Vector& first, const Vector& second) {
+  if (IsSmall(first) && IsSmall(second)) {
+    return exact::Sign(first ^ second);
+  }
+  return exact::Sign(static_cast<__int128>(first.GetX()) * second.GetY() -
+                     static_cast<__int128>(first.GetY()) * second.GetX());
+}
+
+// sign of first * second
+static int DotSign(const Vector& first, const Vector& second) {
+  if (IsSmall(first) && IsSmall(second)) {
+    return exact::Sign(first * second);
+  }
+  return exact::Sign(static_cast<__int128>(first.GetX()) * second.GetX() +
+                     static_cast<__int128>(first.GetY()) * second.GetY());
+}
+
+// point X lies on the segment AB, to_a = A - X and to_b = B - X
+static bool OnSegment(const Vector& to_a, const Vector& to_b) {
+  return CrossSign(to_a, to_b) == 0 && DotSign(to_a, to_b) <= 0;
+}
 
 Point::Point() {}
 Point::Point(const Vector& vector) { base_ = vector; }
@@ -14,13 +58,13 @@ bool Point::ContainsPoint(const Point& point) const {
 }
 
 bool Point::CrossSegment(const Segment& segment) const {
-  Vector vector_a = segment.GetA() - *this;
-  Vector vector_b = segment.GetB() - *this;
-  return (vector_a ^ vector_b) == 0 && (vector_a * vector_b) <= 0;
+  return OnSegment(segment.GetA() - *this, segment.GetB() - *this);
 }
 
 Point* Point::Clone() const { return new Point(base_); }
 
+Box Point::BoundingBox() const { return Box::Around(base_, base_); }
+
 int64_t Point::GetX() const { return base_.GetX(); }
 int64_t Point::GetY() const { return base_.GetY(); }
 
@@ -39,32 +83,36 @@ bool Segment::ContainsPoint(const Point& point) const {
   return point.CrossSegment(*this);
 }
 
+// The crossing tests of segments, rays and circles first compare
+// bounding boxes: most pairs of shapes in a scene are far apart, and the
+// box test rejects them before the products and divisions below. Tests of
+// a single point are a couple of products already and an extra
+// unpredictable branch only slows them down. Qualified BoundingBox()
+// calls skip the virtual dispatch.
 bool Segment::CrossSegment(const Segment& segment) const {
+  if (!Segment::BoundingBox().Intersects(segment.Segment::BoundingBox())) {
+    return false;
+  }
+  // with the boxes overlapping, segments cross if the ends of each one
+  // are not strictly on one side of the other; collinear segments with
+  // overlapping boxes overlap
   const Vector& dir1 = direction_vector_;
   const Vector& dir2 = segment.direction_vector_;
-
-  if ((dir1 ^ dir2) == 0) {
-    // segments are collinear;
-    bool cross = ContainsPoint(segment.GetA()) ||
-                 ContainsPoint(segment.GetB()) ||
-                 segment.ContainsPoint(GetA()) || segment.ContainsPoint(GetB());
-    return cross;
-  }
-
   const Vector& base1 = base_;
   const Vector& base2 = segment.base_;
-  // base1 + dir1 * scale1 = base2 + dir2 * scale2;
-  // if segments intersect,
-  // then 0 <= scale1 <= 1 and 0 <= scale2 <= 1
-
-  double scale1 = (double)((base2 - base1) ^ dir2) / (double)(dir1 ^ dir2);
-  double scale2 = (double)((base1 - base2) ^ dir1) / (double)(dir2 ^ dir1);
-
-  return 0 <= scale1 && scale1 <= 1 && 0 <= scale2 && scale2 <= 1;
+  int side_start2 = CrossSign(dir1, base2 - base1);
+  int side_end2 = CrossSign(dir1, base2 + dir2 - base1);
+  int side_start1 = CrossSign(dir2, base1 - base2);
+  int side_end1 = CrossSign(dir2, base1 + dir1 - base2);
+  return side_start2 * side_end2 <= 0 && side_start1 * side_end1 <= 0;
 }
 
 Segment* Segment::Clone() const { return new Segment(GetA(), GetB()); }
 
+Box Segment::BoundingBox() const {
+  return Box::Around(base_, base_ + direction_vector_);
+}
+
 // get start of segment
 Point Segment::GetA() const { return base_; }
 
@@ -79,30 +127,32 @@ Line::Line(const Point& start, const Point& end) {
 Line::~Line() {}
 
 bool Line::ContainsPoint(const Point& point) const {
-  Vector vector = point - base_;
-  return (vector ^ direction_vector_) == 0;
+  return CrossSign(point - base_, direction_vector_) == 0;
 }
 
 bool Line::CrossSegment(const Segment& segment) const {
-  Point point_a = segment.GetA();
-  Point point_b = segment.GetB();
-  if (ContainsPoint(point_a) || ContainsPoint(point_b)) {
-    return true;
-  }
-
-  const Vector& start = base_;
-  const Vector& end = base_ + direction_vector_;
-
-  int64_t cross_a = (end - point_a) ^ (start - point_a);
-  int64_t cross_b = (end - point_b) ^ (start - point_b);
-
-  // if orientations are different,
-  // then they have opposite signs
-  return cross_a * cross_b < 0;
+  // the ends are on the line or on its different sides
+  int side_a = CrossSign(direction_vector_, segment.GetA() - base_);
+  int side_b = CrossSign(direction_vector_, segment.GetB() - base_);
+  return side_a * side_b <= 0;
 }
 
 Line* Line::Clone() const { return new Line(base_, base_ + direction_vector_); }
 
+// a line is unbounded along every axis it is not parallel to
+Box Line::BoundingBox() const {
+  Box box = Box::Around(base_, base_);
+  if (direction_vector_.GetX() != 0) {
+    box.min_x = kMinCoord;
+    box.max_x = kMaxCoord;
+  }
+  if (direction_vector_.GetY() != 0) {
+    box.min_y = kMinCoord;
+    box.max_y = kMaxCoord;
+  }
+  return box;
+}
+
 int64_t Line::GetA() const {
   Point end = base_ + direction_vector_;
   return base_.GetY() - end.GetY();
@@ -118,6 +168,10 @@ int64_t Line::GetC() const {
   return base_.GetX() * end.GetY() - end.GetX() * base_.GetY();
 }
 
+Point Line::GetBase() const { return base_; }
+
+Vector Line::GetVector() const { return direction_vector_; }
+
 Ray::Ray() {}
 Ray::Ray(const Point& start, const Point& end) {
   base_ = Vector(start.GetX(), start.GetY());
@@ -127,32 +181,61 @@ Ray::~Ray() {}
 
 bool Ray::ContainsPoint(const Point& point) const {
   Vector vector = point - base_;
-  return (vector ^ direction_vector_) == 0 && (vector * direction_vector_) >= 0;
+  return CrossSign(vector, direction_vector_) == 0 &&
+         DotSign(vector, direction_vector_) >= 0;
 }
 
 bool Ray::CrossSegment(const Segment& segment) const {
+  if (!Ray::BoundingBox().Intersects(segment.Segment::BoundingBox())) {
+    return false;
+  }
   const Vector& dir1 = direction_vector_;
   const Vector& dir2 = segment.GetB() - segment.GetA();
-
-  if ((dir1 ^ dir2) == 0) {
+  int orientation = CrossSign(dir1, dir2);
+  if (orientation == 0) {
     // segments are collinear;
     return ContainsPoint(segment.GetA()) || ContainsPoint(segment.GetB());
   }
 
-  const Vector& base1 = base_;
-  const Vector& base2 = segment.GetA() - Point(0, 0);
   // base1 + dir1 * scale1 = base2 + dir2 * scale2;
   // if ray can be continued to intersect the segment,
-  // then 0 <= scale1 and 0 <= scale2 <= 1
-
-  double scale1 = (double)((base2 - base1) ^ dir2) / (double)(dir1 ^ dir2);
-  double scale2 = (double)((base1 - base2) ^ dir1) / (double)(dir2 ^ dir1);
-
-  return 0 <= scale1 && 0 <= scale2 && scale2 <= 1;
+  // then 0 <= scale1 and 0 <= scale2 <= 1, where
+  // scale1 = ((base2 - base1) ^ dir2) / (dir1 ^ dir2) and
+  // scale2 in [0, 1] means the segment ends are not strictly
+  // on one side of the ray line
+  Vector to_start = segment.GetA() - GetA();
+  Vector to_end = segment.GetB() - GetA();
+  return CrossSign(to_start, dir2) * orientation >= 0 &&
+         CrossSign(dir1, to_start) * CrossSign(dir1, to_end) <= 0;
 }
 
 Ray* Ray::Clone() const { return new Ray(base_, base_ + direction_vector_); }
 
+// a ray is unbounded in the directions its vector points to; a ray with a
+// zero vector contains every point, see ContainsPoint, so its box is the
+// whole plane
+Box Ray::BoundingBox() const {
+  Box box = Box::Around(base_, base_);
+  if (direction_vector_ == Vector(0, 0)) {
+    box.min_x = kMinCoord;
+    box.min_y = kMinCoord;
+    box.max_x = kMaxCoord;
+    box.max_y = kMaxCoord;
+    return box;
+  }
+  if (direction_vector_.GetX() > 0) {
+    box.max_x = kMaxCoord;
+  } else if (direction_vector_.GetX() < 0) {
+    box.min_x = kMinCoord;
+  }
+  if (direction_vector_.GetY() > 0) {
+    box.max_y = kMaxCoord;
+  } else if (direction_vector_.GetY() < 0) {
+    box.min_y = kMinCoord;
+  }
+  return box;
+}
+
 Point Ray::GetA() const { return base_; }
 
 Vector Ray::GetVector() const { return direction_vector_; }
@@ -163,24 +246,46 @@ Circle::Circle(const Point& center, int64_t radius) : radius_(radius) {
 }
 Circle::~Circle() {}
 
-static int64_t DistSquared(const Point& start, const Point& end) {
-  Vector vector = end - start;
-  return vector * vector;
+static unsigned __int128 Square(int64_t value) {
+  auto magnitude = static_cast<unsigned __int128>(
+      value < 0 ? -static_cast<__int128>(value) : value);
+  return magnitude * magnitude;
 }
 
-bool Circle::ContainsPoint(const Point& point) const {
-  int64_t dist_squared = DistSquared(GetCentre(), point);
-  return dist_squared <= radius_ * radius_;
+// sign of |vector|^2 - radius^2
+static int DistanceSign(const Vector& vector, int64_t radius) {
+  if (IsSmall(vector) && exact::IsSmall(radius)) {
+    return exact::Sign(vector * vector - radius * radius);
+  }
+  unsigned __int128 dist_squared =
+      Square(vector.GetX()) + Square(vector.GetY());
+  unsigned __int128 r_sqr = Square(radius);
+  return (dist_squared > r_sqr) - (dist_squared < r_sqr);
 }
 
-static bool IsOnCircle(const Circle& circle, const Point& point) {
-  int64_t radius = circle.GetRadius();
-  return DistSquared(circle.GetCentre(), point) == radius * radius;
+bool Circle::ContainsPoint(const Point& point) const {
+  return DistanceSign(point - GetCentre(), radius_) <= 0;
 }
 
-static bool IsInsideCircle(const Circle& circle, const Point& point) {
-  int64_t radius = circle.GetRadius();
-  return DistSquared(circle.GetCentre(), point) < radius * radius;
+// (vector_a ^ vector_b)^2 <= radius^2 * |vector_b - vector_a|^2; the
+// products take up to 254 bits when the vectors are not small
+static bool IsLineNear(const Vector& vector_a, const Vector& vector_b,
+                       int64_t radius) {
+  Vector ab = vector_b - vector_a;
+  if (IsSmall(vector_a) && IsSmall(vector_b) && IsSmall(ab) &&
+      exact::IsSmall(radius)) {
+    __int128 double_area = vector_a ^ vector_b;
+    return double_area * double_area <=
+           static_cast<__int128>(radius * radius) * (ab * ab);
+  }
+  __int128 double_area =
+      static_cast<__int128>(vector_a.GetX()) * vector_b.GetY() -
+      static_cast<__int128>(vector_a.GetY()) * vector_b.GetX();
+  auto area_abs = static_cast<unsigned __int128>(
+      double_area < 0 ? -double_area : double_area);
+  return exact::CompareWideProducts(area_abs, area_abs, Square(radius),
+                                    Square(ab.GetX()) + Square(ab.GetY())) <=
+         0;
 }
 
 // Circle crosses segment if
@@ -197,17 +302,21 @@ static bool IsInsideCircle(const Circle& circle, const Point& point) {
 // (2S)^2 <= R^2 * AB^2
 // if the distance is less or equal to radius,
 // then we check whether AB crosses the line
-// that is perpendicular to AB and contains the center of the circle
+// that is perpendicular to AB and contains the center of the circle,
+// that is, whether the projection of O onto AB lies between A and B
 bool Circle::CrossSegment(const Segment& segment) const {
-  Point point_a = segment.GetA();
-  Point point_b = segment.GetB();
-  Point centre = GetCentre();
-  int64_t r_sqr = GetRadius() * GetRadius();
-  if (IsOnCircle(*this, point_a) || IsOnCircle(*this, point_b)) {
+  if (!Circle::BoundingBox().Intersects(segment.Segment::BoundingBox())) {
+    return false;
+  }
+  Vector vector_a = segment.GetA() - GetCentre();
+  Vector vector_b = segment.GetB() - GetCentre();
+  int side_a = DistanceSign(vector_a, radius_);
+  int side_b = DistanceSign(vector_b, radius_);
+  if (side_a == 0 || side_b == 0) {
     return true;
   }
-  bool is_a_inside = IsInsideCircle(*this, point_a);
-  bool is_b_inside = IsInsideCircle(*this, point_b);
+  bool is_a_inside = side_a < 0;
+  bool is_b_inside = side_b < 0;
   if (is_a_inside && is_b_inside) {
     return false;
   }
@@ -215,22 +324,36 @@ bool Circle::CrossSegment(const Segment& segment) const {
     return true;
   }
 
-  Vector vector_a = point_a - centre;
-  Vector vector_b = point_b - centre;
-  int64_t double_area_squared = (vector_a ^ vector_b) * (vector_a ^ vector_b);
-  int64_t ab_sqr = DistSquared(point_a, point_b);
-  if (double_area_squared > r_sqr * ab_sqr) {
+  // a zero-length segment with both ends outside is a point outside; the
+  // tests below would pass for it since every product with ab is zero
+  if (vector_a == vector_b || !IsLineNear(vector_a, vector_b, radius_)) {
     return false;
   }
 
-  Line line_ab(point_a, point_b);
-  Vector ab_normal_vector(line_ab.GetA(), line_ab.GetB());
-  Line normal_line(base_, base_ + ab_normal_vector);
-  return normal_line.CrossSegment(segment);
+  Vector ab = vector_b - vector_a;
+  return DotSign(ab, vector_a) <= 0 && DotSign(ab, vector_b) >= 0;
 }
 
 Circle* Circle::Clone() const { return new Circle(base_, radius_); }
 
+// coord + shift clamped to the int64_t range
+static int64_t SaturatingAdd(int64_t coord, int64_t shift) {
+  int64_t result = 0;
+  if (__builtin_add_overflow(coord, shift, &result)) {
+    return shift > 0 ? kMaxCoord : kMinCoord;
+  }
+  return result;
+}
+
+Box Circle::BoundingBox() const {
+  Box box;
+  box.min_x = SaturatingAdd(base_.GetX(), -radius_);
+  box.min_y = SaturatingAdd(base_.GetY(), -radius_);
+  box.max_x = SaturatingAdd(base_.GetX(), radius_);
+  box.max_y = SaturatingAdd(base_.GetY(), radius_);
+  return box;
+}
+
 Point Circle::GetCentre() const { return base_; }
 
 int64_t Circle::GetRadius() const { return radius_; }
@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include <cstdint>
 
 // Класс Vector для вектора на плоскости
@@ -97,6 +98,50 @@ class Point;
 
 class Segment;
 
+// Ограничивающий прямоугольник [min_x, max_x] x [min_y, max_y], границы
+// включаются. Неограниченные стороны (у прямых и лучей) - пределы int64_t
+struct Box {
+  int64_t min_x = 0;
+  int64_t min_y = 0;
+  int64_t max_x = 0;
+  int64_t max_y = 0;
+
+  // наименьший прямоугольник с двумя данными углами
+  static Box Around(const Vector& first, const Vector& second) {
+    Box box;
+    box.min_x = std::min(first.GetX(), second.GetX());
+    box.min_y = std::min(first.GetY(), second.GetY());
+    box.max_x = std::max(first.GetX(), second.GetX());
+    box.max_y = std::max(first.GetY(), second.GetY());
+    return box;
+  }
+
+  // наименьший прямоугольник, содержащий оба
+  static Box Union(const Box& first, const Box& second) {
+    Box box;
+    box.min_x = std::min(first.min_x, second.min_x);
+    box.min_y = std::min(first.min_y, second.min_y);
+    box.max_x = std::max(first.max_x, second.max_x);
+    box.max_y = std::max(first.max_y, second.max_y);
+    return box;
+  }
+
+  // Сравнения объединены через & без ветвлений: на случайных данных
+  // ветвь за каждым && предсказывается плохо
+  bool Contains(const Vector& point) const {
+    return (min_x <= point.GetX()) & (point.GetX() <= max_x) &
+           (min_y <= point.GetY()) & (point.GetY() <= max_y);
+  }
+
+  bool Intersects(const Box& other) const {
+    return (min_x <= other.max_x) & (other.min_x <= max_x) &
+           (min_y <= other.max_y) & (other.min_y <= max_y);
+  }
+
+  // все стороны конечны
+  bool IsBounded() const;
+};
+
 class IShape {
  public:
   IShape() {}
@@ -114,6 +159,9 @@ class IShape {
   // вернуть указатель на копию фигуры
   virtual IShape* Clone() const = 0;
 
+  // ограничивающий прямоугольник фигуры
+  virtual Box BoundingBox() const = 0;
+
  protected:
   Vector base_;
 };
@@ -134,6 +182,9 @@ class Point : public IShape {
   // вернуть указатель на копию фигуры
   Point* Clone() const override;
 
+  // ограничивающий прямоугольник фигуры
+  Box BoundingBox() const override;
+
   int64_t GetX() const;
   int64_t GetY() const;
 
@@ -155,6 +206,9 @@ class Segment : public IShape {
   // вернуть указатель на копию фигуры
   Segment* Clone() const override;
 
+  // ограничивающий прямоугольник фигуры
+  Box BoundingBox() const override;
+
   // get start of segment
   Point GetA() const;
 
@@ -180,6 +234,9 @@ class Line : public IShape {
   // вернуть указатель на копию фигуры
   Line* Clone() const override;
 
+  // ограничивающий прямоугольник фигуры
+  Box BoundingBox() const override;
+
   // коэффициент A уравнения прямой Ax + By + C
   int64_t GetA() const;
 
@@ -189,6 +246,12 @@ class Line : public IShape {
   // коэффициент C уравнения прямой Ax + By + C
   int64_t GetC() const;
 
+  // точка прямой, по которой она задана
+  Point GetBase() const;
+
+  // направляющий вектор
+  Vector GetVector() const;
+
  private:
   Vector direction_vector_;
 };
@@ -208,6 +271,9 @@ class Ray : public IShape {
   // вернуть указатель на копию фигуры
   Ray* Clone() const override;
 
+  // ограничивающий прямоугольник фигуры
+  Box BoundingBox() const override;
+
   // get endpoint
   Point GetA() const;
 
@@ -233,6 +299,9 @@ class Circle : public IShape {
   // вернуть указатель на копию фигуры
   Circle* Clone() const override;
 
+  // ограничивающий прямоугольник фигуры
+  Box BoundingBox() const override;
+
   Point GetCentre() const;
   int64_t GetRadius() const;
 
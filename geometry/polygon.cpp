@@ -0,0 +1,407 @@
+#include "polygon.hpp"
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+#include "batch_queries.hpp"
+#include "exact.hpp"
+
+// signs of u ^ v and u * v without overflow
+static int CrossSign(const Vector& u, const Vector& v) {
+  return exact::CompareProducts(u.GetX(), v.GetY(), u.GetY(), v.GetX());
+}
+
+static int DotSign(const Vector& u, const Vector& v) {
+  return exact::CompareProducts(u.GetX(), v.GetX(),
+                                -static_cast<__int128>(u.GetY()), v.GetY());
+}
+
+// by x, then by y
+static bool LexLess(const Vector& left, const Vector& right) {
+  return left.GetX() < right.GetX() ||
+         (left.GetX() == right.GetX() && left.GetY() < right.GetY());
+}
+
+// Andrew's monotone chain: the lower chain left to right, then the upper
+// one back, each popping vertices that do not turn left
+static std::vector<Vector> MonotoneChain(std::vector<Vector>& points) {
+  std::sort(points.begin(), points.end(), LexLess);
+  points.erase(std::unique(points.begin(), points.end()), points.end());
+  if (points.size() <= 2) {
+    return points;
+  }
+  std::vector<Vector> hull(2 * points.size());
+  size_t size = 0;
+  for (size_t i = 0; i < points.size(); i++) {
+    while (size >= 2 && CrossSign(hull[size - 1] - hull[size - 2],
+                                  points[i] - hull[size - 2]) <= 0) {
+      size--;
+    }
+    hull[size++] = points[i];
+  }
+  size_t lower_size = size;
+  for (size_t i = points.size() - 1; i-- > 0;) {
+    while (size > lower_size &&
+           CrossSign(hull[size - 1] - hull[size - 2],
+                     points[i] - hull[size - 2]) <= 0) {
+      size--;
+    }
+    hull[size++] = points[i];
+  }
+  // the upper chain ends at the first vertex again
+  hull.resize(size - 1);
+  return hull;
+}
+
+std::vector<Point> ConvexHull(const std::vector<Point>& points,
+                              size_t thread_count) {
+  if (thread_count == 0) {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+  size_t part_count = std::min(
+      thread_count,
+      std::max<size_t>(points.size() / kMinParallelHullPoints, 1));
+  // the hull of all points is the hull of the parts' hull vertices
+  std::vector<std::vector<Vector>> hulls(part_count);
+  auto run = [&](size_t part) {
+    size_t begin = points.size() * part / part_count;
+    size_t end = points.size() * (part + 1) / part_count;
+    std::vector<Vector> chunk;
+    chunk.reserve(end - begin);
+    for (size_t i = begin; i < end; i++) {
+      chunk.emplace_back(points[i].GetX(), points[i].GetY());
+    }
+    hulls[part] = MonotoneChain(chunk);
+  };
+  std::vector<std::thread> threads;
+  for (size_t part = 1; part < part_count; part++) {
+    threads.emplace_back(run, part);
+  }
+  run(0);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<Vector> vertices = std::move(hulls[0]);
+  if (part_count > 1) {
+    for (size_t part = 1; part < part_count; part++) {
+      vertices.insert(vertices.end(), hulls[part].begin(), hulls[part].end());
+    }
+    vertices = MonotoneChain(vertices);
+  }
+  return std::vector<Point>(vertices.begin(), vertices.end());
+}
+
+// y of the non-vertical side from left to right at x, as numerator /
+// denominator with a positive denominator
+static void YAt(const Vector& left, const Vector& right, int64_t x,
+                __int128& numerator, __int128& denominator) {
+  denominator = static_cast<__int128>(right.GetX()) - left.GetX();
+  numerator = denominator * left.GetY() +
+              (static_cast<__int128>(right.GetY()) - left.GetY()) *
+                  (static_cast<__int128>(x) - left.GetX());
+}
+
+Polygon::Polygon() {}
+
+Polygon::Polygon(const std::vector<Point>& vertices) {
+  if (vertices.empty()) {
+    return;
+  }
+  base_ = Vector(vertices[0].GetX(), vertices[0].GetY());
+  vertices_.reserve(vertices.size());
+  for (const Point& vertex : vertices) {
+    vertices_.push_back(Vector(vertex.GetX(), vertex.GetY()) - base_);
+  }
+  box_ = Box::Around(vertices_[0], vertices_[0]);
+  for (const Vector& vertex : vertices_) {
+    box_ = Box::Union(box_, Box::Around(vertex, vertex));
+  }
+  BuildFan();
+  if (fan_.empty()) {
+    BuildSlabs();
+  }
+}
+
+Polygon::~Polygon() {}
+
+void Polygon::BuildFan() {
+  std::vector<Vector> ring;
+  for (const Vector& vertex : vertices_) {
+    if (ring.empty() || !(ring.back() == vertex)) {
+      ring.push_back(vertex);
+    }
+  }
+  while (ring.size() > 1 && ring.back() == ring.front()) {
+    ring.pop_back();
+  }
+  // every vertex turns the same way; vertices in the middle of a side
+  // are dropped, and a side that turns straight back is not convex
+  std::vector<Vector> fan;
+  int turn = 0;
+  for (size_t i = 0; i < ring.size(); i++) {
+    const Vector& previous = ring[(i + ring.size() - 1) % ring.size()];
+    const Vector& next = ring[(i + 1) % ring.size()];
+    int side = CrossSign(ring[i] - previous, next - ring[i]);
+    if (side == 0) {
+      if (DotSign(ring[i] - previous, next - ring[i]) < 0) {
+        return;
+      }
+      continue;
+    }
+    if (turn != 0 && side != turn) {
+      return;
+    }
+    turn = side;
+    fan.push_back(ring[i]);
+  }
+  if (fan.size() < 3) {
+    return;
+  }
+  // a star polygon also turns one way but winds around more than once,
+  // so its sides change x direction more than twice
+  std::vector<int> directions;
+  for (size_t i = 0; i < fan.size(); i++) {
+    int64_t dx = fan[(i + 1) % fan.size()].GetX() - fan[i].GetX();
+    if (dx != 0) {
+      directions.push_back(dx > 0 ? 1 : -1);
+    }
+  }
+  size_t changes = 0;
+  for (size_t i = 0; i < directions.size(); i++) {
+    changes += directions[i] != directions[(i + 1) % directions.size()];
+  }
+  if (changes != 2) {
+    return;
+  }
+  if (turn < 0) {
+    std::reverse(fan.begin(), fan.end());
+  }
+  fan_ = std::move(fan);
+}
+
+void Polygon::BuildSlabs() {
+  for (size_t i = 0; i < vertices_.size(); i++) {
+    size_t next = (i + 1) % vertices_.size();
+    bool forward = !LexLess(vertices_[next], vertices_[i]);
+    edges_.push_back({forward ? i : next, forward ? next : i});
+  }
+  for (const Vector& vertex : vertices_) {
+    slab_x_.push_back(vertex.GetX());
+  }
+  std::sort(slab_x_.begin(), slab_x_.end());
+  slab_x_.erase(std::unique(slab_x_.begin(), slab_x_.end()), slab_x_.end());
+  auto x_index = [this](int64_t x) {
+    return static_cast<size_t>(
+        std::lower_bound(slab_x_.begin(), slab_x_.end(), x) - slab_x_.begin());
+  };
+
+  // sides by the lines through their ends, counted first, then placed
+  touching_begin_.assign(slab_x_.size() + 1, 0);
+  std::vector<size_t> left_index(edges_.size());
+  std::vector<size_t> right_index(edges_.size());
+  for (size_t i = 0; i < edges_.size(); i++) {
+    left_index[i] = x_index(vertices_[edges_[i].left].GetX());
+    right_index[i] = x_index(vertices_[edges_[i].right].GetX());
+    touching_begin_[left_index[i] + 1]++;
+    if (right_index[i] != left_index[i]) {
+      touching_begin_[right_index[i] + 1]++;
+    }
+  }
+  for (size_t i = 0; i < slab_x_.size(); i++) {
+    touching_begin_[i + 1] += touching_begin_[i];
+  }
+  touching_edges_.resize(touching_begin_.back());
+  std::vector<size_t> filled(touching_begin_.begin(),
+                             touching_begin_.end() - 1);
+  for (size_t i = 0; i < edges_.size(); i++) {
+    touching_edges_[filled[left_index[i]]++] = i;
+    if (right_index[i] != left_index[i]) {
+      touching_edges_[filled[right_index[i]]++] = i;
+    }
+  }
+
+  // Segment tree over the slabs: a side is stored in the O(log n) nodes
+  // that together cover exactly its slabs. Sides of a simple polygon do
+  // not cross inside the x range of a node they span, so their order there
+  // is the order of y on its left line, or on its right one if they meet.
+  size_t slab_count = slab_x_.size() - 1;
+  leaf_count_ = 1;
+  while (leaf_count_ < slab_count) {
+    leaf_count_ *= 2;
+  }
+  std::vector<size_t> first_slab(2 * leaf_count_, slab_count);
+  std::vector<size_t> end_slab(2 * leaf_count_, slab_count);
+  for (size_t slab = 0; slab < slab_count; slab++) {
+    first_slab[leaf_count_ + slab] = slab;
+    end_slab[leaf_count_ + slab] = slab + 1;
+  }
+  for (size_t node = leaf_count_ - 1; node >= 1; node--) {
+    first_slab[node] = first_slab[2 * node];
+    end_slab[node] = end_slab[2 * node + 1];
+  }
+  std::vector<std::pair<size_t, size_t>> placed;
+  for (size_t i = 0; i < edges_.size(); i++) {
+    size_t low = left_index[i] + leaf_count_;
+    size_t high = right_index[i] + leaf_count_;
+    for (; low < high; low /= 2, high /= 2) {
+      if (low % 2 == 1) {
+        placed.emplace_back(low++, i);
+      }
+      if (high % 2 == 1) {
+        placed.emplace_back(--high, i);
+      }
+    }
+  }
+  std::sort(placed.begin(), placed.end());
+  node_begin_.assign(2 * leaf_count_ + 1, 0);
+  for (const auto& entry : placed) {
+    node_begin_[entry.first + 1]++;
+    node_edges_.push_back(entry.second);
+  }
+  for (size_t node = 0; node < 2 * leaf_count_; node++) {
+    node_begin_[node + 1] += node_begin_[node];
+  }
+  for (size_t node = 1; node < 2 * leaf_count_; node++) {
+    int64_t xs[] = {slab_x_[first_slab[node]], slab_x_[end_slab[node]]};
+    auto below = [&](size_t first, size_t second) {
+      for (int64_t x : xs) {
+        __int128 first_numerator = 0;
+        __int128 first_denominator = 0;
+        __int128 second_numerator = 0;
+        __int128 second_denominator = 0;
+        YAt(vertices_[edges_[first].left], vertices_[edges_[first].right], x,
+            first_numerator, first_denominator);
+        YAt(vertices_[edges_[second].left], vertices_[edges_[second].right],
+            x, second_numerator, second_denominator);
+        int order = exact::CompareProducts(first_numerator, second_denominator,
+                                           second_numerator, first_denominator);
+        if (order != 0) {
+          return order < 0;
+        }
+      }
+      return false;
+    };
+    std::sort(node_edges_.begin() + node_begin_[node],
+              node_edges_.begin() + node_begin_[node + 1], below);
+  }
+}
+
+bool Polygon::OnEdge(const Edge& edge, const Vector& point) const {
+  const Vector& left = vertices_[edge.left];
+  const Vector& right = vertices_[edge.right];
+  return CrossSign(right - left, point - left) == 0 &&
+         DotSign(left - point, right - point) <= 0;
+}
+
+bool Polygon::FanContains(const Vector& point) const {
+  const Vector& origin = fan_[0];
+  Vector to_point = point - origin;
+  if (CrossSign(fan_[1] - origin, to_point) < 0 ||
+      CrossSign(fan_.back() - origin, to_point) > 0) {
+    return false;
+  }
+  // the last triangle (origin, fan_[low], fan_[low + 1]) whose first side
+  // has the point on the left
+  size_t low = 1;
+  size_t high = fan_.size() - 1;
+  while (high - low > 1) {
+    size_t middle = low + (high - low) / 2;
+    if (CrossSign(fan_[middle] - origin, to_point) >= 0) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+  return CrossSign(fan_[low + 1] - fan_[low], point - fan_[low]) >= 0;
+}
+
+bool Polygon::SlabsContain(const Vector& point) const {
+  auto after = std::upper_bound(slab_x_.begin(), slab_x_.end(), point.GetX());
+  if (after == slab_x_.begin()) {
+    return false;
+  }
+  size_t slab = after - slab_x_.begin() - 1;
+  // on a line through vertices the point may lie on a vertical side or on
+  // a vertex that no slab to the right covers
+  if (slab_x_[slab] == point.GetX()) {
+    for (size_t i = touching_begin_[slab]; i < touching_begin_[slab + 1]; i++) {
+      if (OnEdge(edges_[touching_edges_[i]], point)) {
+        return true;
+      }
+    }
+  }
+  if (slab + 1 == slab_x_.size()) {
+    return false;
+  }
+  auto above = [&](size_t edge) {
+    const Vector& left = vertices_[edges_[edge].left];
+    return CrossSign(vertices_[edges_[edge].right] - left, point - left);
+  };
+  // the sides over the slab are split between the nodes on the path from
+  // its leaf to the root, each node's sorted bottom to top
+  bool inside = false;
+  for (size_t node = slab + leaf_count_; node >= 1; node /= 2) {
+    auto begin = node_edges_.begin() + node_begin_[node];
+    auto end = node_edges_.begin() + node_begin_[node + 1];
+    auto first = std::partition_point(
+        begin, end, [&](size_t edge) { return above(edge) > 0; });
+    if (first != end && above(*first) == 0) {
+      return true;
+    }
+    inside = inside != ((end - first) % 2 == 1);
+  }
+  return inside;
+}
+
+bool Polygon::ContainsPoint(const Point& point) const {
+  Vector position = Vector(point.GetX(), point.GetY()) - base_;
+  if (vertices_.empty() || !box_.Contains(position)) {
+    return false;
+  }
+  return IsConvex() ? FanContains(position) : SlabsContain(position);
+}
+
+bool Polygon::CrossSegment(const Segment& segment) const {
+  if (vertices_.empty() ||
+      !BoundingBox().Intersects(segment.Segment::BoundingBox())) {
+    return false;
+  }
+  if (ContainsPoint(segment.GetA()) || ContainsPoint(segment.GetB())) {
+    return true;
+  }
+  for (size_t i = 0; i < vertices_.size(); i++) {
+    Segment side(GetVertex(i), GetVertex((i + 1) % vertices_.size()));
+    if (side.CrossSegment(segment)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Polygon* Polygon::Clone() const { return new Polygon(*this); }
+
+Box Polygon::BoundingBox() const {
+  Vector min_corner(box_.min_x, box_.min_y);
+  Vector max_corner(box_.max_x, box_.max_y);
+  return Box::Around(base_ + min_corner, base_ + max_corner);
+}
+
+std::vector<size_t> Polygon::ContainedPoints(const std::vector<Point>& points,
+                                             size_t thread_count) const {
+  std::vector<char> contained = AnswerQueries<char>(
+      points, thread_count,
+      [this](const Point& point) -> char { return ContainsPoint(point); });
+  std::vector<size_t> result;
+  for (size_t i = 0; i < points.size(); i++) {
+    if (contained[i]) {
+      result.push_back(i);
+    }
+  }
+  return result;
+}
+
+Point Polygon::GetVertex(size_t index) const {
+  return Point(base_ + vertices_[index]);
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "geometry.hpp"
+
+// Выпуклая оболочка строится в нескольких потоках, только если на поток
+// приходится не меньше стольких точек
+static const size_t kMinParallelHullPoints = size_t(1) << 16;
+
+// Вершины выпуклой оболочки точек против часовой стрелки, начиная с
+// наименьшей (по x, затем по y), без точек на сторонах. Алгоритм Эндрю
+// (monotone chain): точки сортируются, и нижняя и верхняя цепочки
+// собираются за один проход каждая. В thread_count потоках (0 - по числу
+// аппаратных потоков) точки делятся на части, оболочки частей строятся
+// параллельно, а затем строится оболочка их вершин.
+std::vector<Point> ConvexHull(const std::vector<Point>& points,
+                              size_t thread_count = 0);
+
+// Многоугольник, заданный вершинами в порядке обхода (в любую сторону);
+// стороны не должны пересекаться, кроме соседних в общей вершине.
+// Содержит точки внутри и на границе.
+//
+// При построении выбирается индекс для ContainsPoint. Выпуклый
+// многоугольник делится на треугольники веером из первой вершины, и
+// нужный треугольник ищется двоичным поиском по знаку векторного
+// произведения за O(log n). Для невыпуклого плоскость делится
+// вертикальными прямыми через вершины на полосы, и точка внутри, если над
+// ней нечетное число сторон ее полосы. Списки сторон всех полос заняли бы
+// O(n^2) памяти, поэтому стороны хранятся в дереве отрезков над полосами:
+// каждая - в O(log n) узлах, покрывающих ровно ее полосы, внутри узла
+// снизу вверх. Память O(n log n), проверка - двоичный поиск в узлах на
+// пути от полосы к корню, O(log^2 n).
+class Polygon : public IShape {
+ public:
+  Polygon();
+  explicit Polygon(const std::vector<Point>& vertices);
+  ~Polygon();
+
+  // проверка, содержит ли фигура точку
+  bool ContainsPoint(const Point& point) const override;
+
+  // проверка, пересекает ли отрезок фигуру (за O(n): со всеми сторонами)
+  bool CrossSegment(const Segment& segment) const override;
+
+  // вернуть указатель на копию фигуры
+  Polygon* Clone() const override;
+
+  // ограничивающий прямоугольник фигуры
+  Box BoundingBox() const override;
+
+  // номера точек, лежащих в многоугольнике, по возрастанию; проверки
+  // идут в thread_count потоках (0 - по числу аппаратных потоков)
+  std::vector<size_t> ContainedPoints(const std::vector<Point>& points,
+                                      size_t thread_count = 0) const;
+
+  // число вершин
+  size_t Size() const { return vertices_.size(); }
+
+  // вершина с номером index в порядке обхода
+  Point GetVertex(size_t index) const;
+
+  // выпуклый ли многоугольник (тогда проверки идут веером)
+  bool IsConvex() const { return !fan_.empty(); }
+
+ private:
+  // Сторона невыпуклого многоугольника: вершины с номерами left и right,
+  // left - с меньшим x (для вертикальных - с меньшим y)
+  struct Edge {
+    size_t left = 0;
+    size_t right = 0;
+  };
+
+  void BuildFan();
+  void BuildSlabs();
+
+  // проверки для точки в координатах относительно base_
+  bool FanContains(const Vector& point) const;
+  bool SlabsContain(const Vector& point) const;
+  bool OnEdge(const Edge& edge, const Vector& point) const;
+
+  // вершины относительно base_ (base_ - первая вершина)
+  std::vector<Vector> vertices_;
+  Box box_;
+  // вершины выпуклого многоугольника против часовой стрелки без
+  // повторов и вершин на сторонах; пусто для невыпуклого
+  std::vector<Vector> fan_;
+  std::vector<Edge> edges_;
+  // различные x вершин по возрастанию
+  std::vector<int64_t> slab_x_;
+  // Дерево отрезков над полосами slab_x_[i] <= x < slab_x_[i + 1]:
+  // узел 1 - корень, у узла k дети 2k и 2k + 1, полоса i - лист
+  // leaf_count_ + i. Стороны узла k снизу вверх - node_edges_ с
+  // node_begin_[k] по node_begin_[k + 1]
+  size_t leaf_count_ = 0;
+  std::vector<size_t> node_begin_;
+  std::vector<size_t> node_edges_;
+  // стороны с концом на прямой x = slab_x_[i] - touching_edges_ с
+  // touching_begin_[i] по touching_begin_[i + 1]
+  std::vector<size_t> touching_begin_;
+  std::vector<size_t> touching_edges_;
+};
@@ -0,0 +1,391 @@
+#include "segment_sweep.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+#include "exact.hpp"
+
+// Event point (x / w, y / w) with w > 0: an endpoint has w = 1, a crossing
+// of two segments has the cross product of their directions as w
+struct SweepPoint {
+  __int128 x = 0;
+  __int128 y = 0;
+  __int128 w = 1;
+};
+
+// Segment directed from its lexicographically smaller end, so that the
+// direction points right or straight up
+struct SweepSegment {
+  Vector start;
+  Vector direction;
+  size_t id = 0;
+};
+
+static SweepPoint ToSweepPoint(const Vector& point) {
+  SweepPoint result;
+  result.x = point.GetX();
+  result.y = point.GetY();
+  return result;
+}
+
+// lexicographic order of event points: by x, then by y
+static int Compare(const SweepPoint& left, const SweepPoint& right) {
+  int by_x = exact::CompareProducts(left.x, right.w, right.x, left.w);
+  if (by_x != 0) {
+    return by_x;
+  }
+  return exact::CompareProducts(left.y, right.w, right.y, left.w);
+}
+
+struct SweepPointLess {
+  bool operator()(const SweepPoint& left, const SweepPoint& right) const {
+    return Compare(left, right) < 0;
+  }
+};
+
+// 1 if the point lies above the line of the segment (to the left of its
+// direction), -1 if below, 0 if on it
+static int Side(const SweepSegment& segment, const SweepPoint& point) {
+  __int128 to_x = point.x - point.w * segment.start.GetX();
+  __int128 to_y = point.y - point.w * segment.start.GetY();
+  return exact::CompareProducts(segment.direction.GetX(), to_y,
+                                segment.direction.GetY(), to_x);
+}
+
+static int Sign(int64_t value) { return (value > 0) - (value < 0); }
+
+static bool InSweepRange(int64_t coordinate) {
+  return coordinate > -kMaxSweepCoordinate && coordinate < kMaxSweepCoordinate;
+}
+
+static std::vector<SweepSegment> ToSweepSegments(
+    const std::vector<Segment>& segments) {
+  std::vector<SweepSegment> result(segments.size());
+  for (size_t i = 0; i < segments.size(); i++) {
+    Vector first(segments[i].GetA().GetX(), segments[i].GetA().GetY());
+    Vector second(segments[i].GetB().GetX(), segments[i].GetB().GetY());
+    if (!InSweepRange(first.GetX()) || !InSweepRange(first.GetY()) ||
+        !InSweepRange(second.GetX()) || !InSweepRange(second.GetY())) {
+      throw std::invalid_argument(
+          "segment coordinates must be less than 2^30 by absolute value");
+    }
+    bool in_order = first.GetX() < second.GetX() ||
+                    (first.GetX() == second.GetX() &&
+                     first.GetY() <= second.GetY());
+    result[i].start = in_order ? first : second;
+    result[i].direction = in_order ? second - first : first - second;
+    result[i].id = i;
+  }
+  return result;
+}
+
+// Bentley-Ottmann sweep over the vertical strip begin_x <= x < end_x.
+// Segments that start left of the strip are put into the status in their
+// order at x = begin_x; a pair is reported at its leftmost common point,
+// and only if that point lies in the strip.
+class StripSweep {
+ public:
+  StripSweep(const std::vector<SweepSegment>& segments, int64_t begin_x,
+             int64_t end_x)
+      : segments_(segments),
+        status_(StatusLess{this}),
+        begin_x_(begin_x),
+        end_x_(end_x) {}
+
+  StripSweep(const StripSweep&) = delete;
+  StripSweep& operator=(const StripSweep&) = delete;
+
+  // pairs with the leftmost common point in the strip, in no order
+  std::vector<SegmentPair> Run(const std::vector<size_t>& members);
+
+ private:
+  // Order of the status: segments below the current event point, then
+  // those through it by slope (their order right of the point), then those
+  // above it. Insertions and lookups always compare against a segment
+  // through the current point or the point itself, which is all this order
+  // has to decide; the segments already in the status keep their order.
+  struct StatusLess {
+    using is_transparent = void;
+
+    bool operator()(size_t left, size_t right) const {
+      int left_band = -Side(sweep->segments_[left], sweep->current_);
+      int right_band = -Side(sweep->segments_[right], sweep->current_);
+      if (left_band != right_band) {
+        return left_band < right_band;
+      }
+      if (left_band == 0) {
+        int turn = Sign(sweep->segments_[left].direction ^
+                        sweep->segments_[right].direction);
+        if (turn != 0) {
+          return turn > 0;
+        }
+      }
+      return left < right;
+    }
+
+    bool operator()(size_t segment, const SweepPoint& point) const {
+      return Side(sweep->segments_[segment], point) > 0;
+    }
+
+    bool operator()(const SweepPoint& point, size_t segment) const {
+      return Side(sweep->segments_[segment], point) < 0;
+    }
+
+    const StripSweep* sweep;
+  };
+
+  void HandleEvent(const SweepPoint& point, const std::vector<size_t>& upper);
+
+  // queues the crossing of two neighbours if it lies after the current
+  // point and before the end of the strip
+  void FindEvent(size_t first, size_t second);
+
+  void Report(size_t first, size_t second) {
+    size_t first_id = segments_[first].id;
+    size_t second_id = segments_[second].id;
+    pairs_.emplace_back(std::min(first_id, second_id),
+                        std::max(first_id, second_id));
+  }
+
+  SweepPoint EndOf(size_t segment) const {
+    const SweepSegment& item = segments_[segment];
+    return ToSweepPoint(item.start + item.direction);
+  }
+
+  const std::vector<SweepSegment>& segments_;
+  std::set<size_t, StatusLess> status_;
+  // ends of segments and crossings ahead of the sweep line
+  std::set<SweepPoint, SweepPointLess> queue_;
+  SweepPoint current_;
+  int64_t begin_x_;
+  int64_t end_x_;
+  // segments through the current point that were already in the status
+  std::vector<size_t> through_;
+  std::vector<SegmentPair> pairs_;
+};
+
+std::vector<SegmentPair> StripSweep::Run(const std::vector<size_t>& members) {
+  std::vector<size_t> starts;
+  for (size_t segment : members) {
+    const SweepSegment& item = segments_[segment];
+    if (item.start.GetX() >= begin_x_) {
+      starts.push_back(segment);
+      continue;
+    }
+    // crosses the left border: inserted as if the sweep stood at its
+    // point on the border, the other segments are ordered around it
+    current_.w = item.direction.GetX();
+    current_.x = current_.w * begin_x_;
+    current_.y = current_.w * item.start.GetY() +
+                 static_cast<__int128>(item.direction.GetY()) *
+                     (begin_x_ - item.start.GetX());
+    status_.insert(segment);
+  }
+  // below every point of the left border
+  current_.x = begin_x_;
+  current_.y = -(static_cast<__int128>(1) << 100);
+  current_.w = 1;
+  for (auto it = status_.begin(); it != status_.end(); ++it) {
+    if (std::next(it) != status_.end()) {
+      FindEvent(*it, *std::next(it));
+    }
+  }
+  for (size_t segment : members) {
+    const SweepSegment& item = segments_[segment];
+    bool degenerate = item.direction == Vector();
+    if (!degenerate && item.start.GetX() + item.direction.GetX() < end_x_) {
+      queue_.insert(EndOf(segment));
+    }
+  }
+  std::sort(starts.begin(), starts.end(), [this](size_t left, size_t right) {
+    const Vector& left_start = segments_[left].start;
+    const Vector& right_start = segments_[right].start;
+    if (left_start.GetX() != right_start.GetX()) {
+      return left_start.GetX() < right_start.GetX();
+    }
+    return left_start.GetY() < right_start.GetY();
+  });
+
+  std::vector<size_t> upper;
+  size_t next_start = 0;
+  while (next_start < starts.size() || !queue_.empty()) {
+    SweepPoint point;
+    if (next_start < starts.size()) {
+      point = ToSweepPoint(segments_[starts[next_start]].start);
+    }
+    if (!queue_.empty() &&
+        (next_start == starts.size() || Compare(*queue_.begin(), point) < 0)) {
+      point = *queue_.begin();
+    }
+    if (!queue_.empty() && Compare(*queue_.begin(), point) == 0) {
+      queue_.erase(queue_.begin());
+    }
+    upper.clear();
+    while (next_start < starts.size() &&
+           Compare(ToSweepPoint(segments_[starts[next_start]].start), point) ==
+               0) {
+      upper.push_back(starts[next_start++]);
+    }
+    HandleEvent(point, upper);
+  }
+  return std::move(pairs_);
+}
+
+void StripSweep::HandleEvent(const SweepPoint& point,
+                             const std::vector<size_t>& upper) {
+  current_ = point;
+  auto range = status_.equal_range(point);
+  through_.assign(range.first, range.second);
+
+  // Every reported pair has the current point as its leftmost common
+  // point: one of the two starts here, or neither does and they are not
+  // collinear, so this point is the only one they share. Collinear pairs
+  // that both started earlier were reported where the later one started.
+  for (size_t i = 0; i < upper.size(); i++) {
+    for (size_t j = i + 1; j < upper.size(); j++) {
+      Report(upper[i], upper[j]);
+    }
+    for (size_t other : through_) {
+      Report(upper[i], other);
+    }
+  }
+  for (size_t i = 0; i < through_.size(); i++) {
+    for (size_t j = i + 1; j < through_.size(); j++) {
+      if ((segments_[through_[i]].direction ^
+           segments_[through_[j]].direction) != 0) {
+        Report(through_[i], through_[j]);
+      }
+    }
+  }
+
+  // segments that go on past the point are reinserted in their order
+  // right of it, which reverses the ones crossing here
+  auto next = status_.erase(range.first, range.second);
+  bool inserted = false;
+  for (size_t segment : upper) {
+    if (!(segments_[segment].direction == Vector())) {
+      status_.insert(segment);
+      inserted = true;
+    }
+  }
+  for (size_t segment : through_) {
+    if (Compare(EndOf(segment), point) != 0) {
+      status_.insert(segment);
+      inserted = true;
+    }
+  }
+
+  if (!inserted) {
+    if (next != status_.begin() && next != status_.end()) {
+      FindEvent(*std::prev(next), *next);
+    }
+    return;
+  }
+  range = status_.equal_range(point);
+  if (range.first != status_.begin()) {
+    FindEvent(*std::prev(range.first), *range.first);
+  }
+  if (range.second != status_.end()) {
+    FindEvent(*std::prev(range.second), *range.second);
+  }
+}
+
+void StripSweep::FindEvent(size_t first, size_t second) {
+  const SweepSegment& first_item = segments_[first];
+  const SweepSegment& second_item = segments_[second];
+  // parallel segments share no crossing point, and an overlap of collinear
+  // ones begins at an endpoint, which is an event anyway
+  int64_t denominator = first_item.direction ^ second_item.direction;
+  if (denominator == 0) {
+    return;
+  }
+  // the crossing is start + direction * along / denominator on each segment
+  Vector to_second = second_item.start - first_item.start;
+  int64_t along_first = to_second ^ second_item.direction;
+  int64_t along_second = to_second ^ first_item.direction;
+  if (denominator < 0) {
+    denominator = -denominator;
+    along_first = -along_first;
+    along_second = -along_second;
+  }
+  if (along_first < 0 || along_first > denominator || along_second < 0 ||
+      along_second > denominator) {
+    return;
+  }
+  SweepPoint crossing;
+  crossing.w = denominator;
+  crossing.x = crossing.w * first_item.start.GetX() +
+               static_cast<__int128>(first_item.direction.GetX()) * along_first;
+  crossing.y = crossing.w * first_item.start.GetY() +
+               static_cast<__int128>(first_item.direction.GetY()) * along_first;
+  if (Compare(crossing, current_) > 0 && crossing.x < crossing.w * end_x_) {
+    queue_.insert(crossing);
+  }
+}
+
+std::vector<SegmentPair> IntersectingPairs(
+    const std::vector<Segment>& segments) {
+  return IntersectingPairsParallel(segments, 1);
+}
+
+std::vector<SegmentPair> IntersectingPairsParallel(
+    const std::vector<Segment>& segments, size_t thread_count) {
+  std::vector<SweepSegment> items = ToSweepSegments(segments);
+  if (thread_count == 0) {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+  size_t strip_count = std::min(
+      thread_count, std::max<size_t>(items.size() / kMinSweepStripSegments, 1));
+
+  // strip borders split the sorted x of all endpoints evenly; the first
+  // and the last strips are unbounded
+  std::vector<int64_t> xs;
+  xs.reserve(2 * items.size());
+  for (const SweepSegment& item : items) {
+    xs.push_back(item.start.GetX());
+    xs.push_back(item.start.GetX() + item.direction.GetX());
+  }
+  std::sort(xs.begin(), xs.end());
+  std::vector<int64_t> borders = {std::numeric_limits<int64_t>::min()};
+  for (size_t strip = 1; strip < strip_count; strip++) {
+    int64_t border = xs[xs.size() * strip / strip_count];
+    if (border > borders.back()) {
+      borders.push_back(border);
+    }
+  }
+  borders.push_back(std::numeric_limits<int64_t>::max());
+
+  size_t strips = borders.size() - 1;
+  std::vector<std::vector<SegmentPair>> found(strips);
+  auto run = [&](size_t strip) {
+    std::vector<size_t> members;
+    for (size_t i = 0; i < items.size(); i++) {
+      int64_t begin = items[i].start.GetX();
+      int64_t end = begin + items[i].direction.GetX();
+      if (begin < borders[strip + 1] && end >= borders[strip]) {
+        members.push_back(i);
+      }
+    }
+    StripSweep sweep(items, borders[strip], borders[strip + 1]);
+    found[strip] = sweep.Run(members);
+  };
+  std::vector<std::thread> threads;
+  for (size_t strip = 1; strip < strips; strip++) {
+    threads.emplace_back(run, strip);
+  }
+  run(0);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<SegmentPair> pairs;
+  for (const std::vector<SegmentPair>& part : found) {
+    pairs.insert(pairs.end(), part.begin(), part.end());
+  }
+  std::sort(pairs.begin(), pairs.end());
+  return pairs;
+}
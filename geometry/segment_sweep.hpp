@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "geometry.hpp"
+
+// Координаты концов отрезков для поиска пересечений должны быть меньше
+// этого числа по модулю: тогда векторные произведения разностей
+// координат помещаются в int64_t, а точки пересечения точно
+// представляются дробями с числителями в __int128
+static const int64_t kMaxSweepCoordinate = int64_t(1) << 30;
+
+// В параллельном поиске на полосу приходится не меньше стольких отрезков
+static const size_t kMinSweepStripSegments = 4096;
+
+// пара номеров отрезков, first < second
+using SegmentPair = std::pair<size_t, size_t>;
+
+// Все пары пересекающихся отрезков (имеющих общую точку, как в
+// Segment::CrossSegment) по возрастанию, за O((n + k) log n) для n
+// отрезков и k пар. Алгоритм Бентли - Оттмана: вертикальная прямая
+// проходит события (концы отрезков и найденные точки пересечения) слева
+// направо, отрезки под прямой упорядочены снизу вверх, и проверяются на
+// пересечение только соседние в этом порядке. Все проверки - знаки
+// точных целочисленных произведений, без плавающей точки.
+// Бросает std::invalid_argument, если координата не меньше
+// kMaxSweepCoordinate по модулю.
+std::vector<SegmentPair> IntersectingPairs(
+    const std::vector<Segment>& segments);
+
+// То же в thread_count потоках (0 - по числу аппаратных потоков):
+// плоскость делится на вертикальные полосы с равным числом концов
+// отрезков, и каждый поток проходит свою полосу, начиная с отрезков,
+// которые ее пересекают. Пара находится в полосе, где лежит ее самая
+// левая общая точка, поэтому ответ совпадает с последовательным.
+std::vector<SegmentPair> IntersectingPairsParallel(
+    const std::vector<Segment>& segments, size_t thread_count = 0);
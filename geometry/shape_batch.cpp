@@ -0,0 +1,459 @@
+#include "shape_batch.hpp"
+
+#include <cstring>
+#include <typeinfo>
+
+#include "batch_queries.hpp"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define GEOMETRY_X86 1
+#include <immintrin.h>
+#endif
+
+// The kernels below are templates over the lane type L: int64_t tests one
+// shape, Int64x4 tests four. Int64x4 is a GCC vector, so the same formula
+// compiles to AVX2 inside target("avx2") functions and to scalar code
+// elsewhere. The kernels are always inlined, and passing vectors between
+// them by value never crosses an ABI boundary: silence the ABI notes.
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+typedef int64_t Int64x4 __attribute__((vector_size(32)));
+
+// The query segment with its end and box precomputed
+struct SegmentQuery {
+  Vector start;
+  Vector end;
+  Vector direction;
+  Box box;
+};
+
+static void SetBit(ShapeMask& mask, size_t id) {
+  mask[id / 64] |= uint64_t(1) << (id % 64);
+}
+
+template <typename L>
+static __attribute__((always_inline)) inline L Load(
+    const std::vector<int64_t>& column, size_t i) {
+  L lanes;
+  std::memcpy(&lanes, column.data() + i, sizeof(lanes));
+  return lanes;
+}
+
+// Conditions as masks of all ones or all zeros in every lane, so that
+// ~, & and | combine them the same way for one lane and for four
+static __attribute__((always_inline)) inline int64_t Mask(bool condition) {
+  return -static_cast<int64_t>(condition);
+}
+
+static __attribute__((always_inline)) inline Int64x4 Mask(
+    const Int64x4& condition) {
+  return condition;
+}
+
+// the point X lies on the segment AB, u = A - X and v = B - X
+template <typename L>
+static __attribute__((always_inline)) inline L OnSegment(
+    const L& ux, const L& uy, const L& vx, const L& vy) {
+  return Mask(ux * vy - uy * vx == 0) & Mask(ux * vx + uy * vy <= 0);
+}
+
+// value with the sign of sign_mask applied: -value if sign_mask is all ones
+template <typename L>
+static __attribute__((always_inline)) inline L ApplySign(
+    const L& value, const L& sign_mask) {
+  return (value ^ sign_mask) - sign_mask;
+}
+
+template <typename L>
+static __attribute__((always_inline)) inline L Min(const L& a, const L& b) {
+  return a < b ? a : b;
+}
+
+template <typename L>
+static __attribute__((always_inline)) inline L Max(const L& a, const L& b) {
+  return a < b ? b : a;
+}
+
+// Some lane of the mask is set. The kernels return early when no lane
+// passes the box test: it needs no products, and AVX2 has no 64-bit
+// multiplication, so each product costs three 32-bit ones
+static __attribute__((always_inline)) inline bool Any(int64_t mask) {
+  return mask != 0;
+}
+
+static __attribute__((always_inline)) inline bool Any(const Int64x4& mask) {
+  return (mask[0] | mask[1] | mask[2] | mask[3]) != 0;
+}
+
+// lanes := the shapes i, i + 1, ... contain the point / are crossed by
+// the segment, by the formulas of the corresponding IShape methods
+
+template <typename L>
+static __attribute__((always_inline)) inline void Hits(
+    const PointSoA& points, size_t i, const Vector& point, L& lanes) {
+  lanes = Mask(Load<L>(points.x, i) == point.GetX()) &
+          Mask(Load<L>(points.y, i) == point.GetY());
+}
+
+template <typename L>
+static __attribute__((always_inline)) inline void Hits(
+    const PointSoA& points, size_t i, const SegmentQuery& segment, L& lanes) {
+  L x = Load<L>(points.x, i);
+  L y = Load<L>(points.y, i);
+  lanes = OnSegment<L>(segment.start.GetX() - x, segment.start.GetY() - y,
+                       segment.end.GetX() - x, segment.end.GetY() - y);
+}
+
+template <typename L>
+static __attribute__((always_inline)) inline void Hits(
+    const SegmentSoA& segments, size_t i, const Vector& point, L& lanes) {
+  L ux = Load<L>(segments.x, i) - point.GetX();
+  L uy = Load<L>(segments.y, i) - point.GetY();
+  lanes = OnSegment<L>(ux, uy, ux + Load<L>(segments.dx, i),
+                       uy + Load<L>(segments.dy, i));
+}
+
+// parallel segments cross if an end of one lies on the other, otherwise
+// if P + e * t = A + d * s for t and s in [0, 1]:
+// s = ((P - A) ^ e) / (d ^ e), t = ((P - A) ^ d) / (d ^ e)
+template <typename L>
+static __attribute__((always_inline)) inline void Hits(
+    const SegmentSoA& segments, size_t i, const SegmentQuery& segment,
+    L& lanes) {
+  L ax = Load<L>(segments.x, i);
+  L ay = Load<L>(segments.y, i);
+  L dx = Load<L>(segments.dx, i);
+  L dy = Load<L>(segments.dy, i);
+  L bx = ax + dx;
+  L by = ay + dy;
+  const Box& box = segment.box;
+  const Vector& p = segment.start;
+  const Vector& q = segment.end;
+  const Vector& e = segment.direction;
+
+  L in_box = Mask(Min<L>(ax, bx) <= box.max_x) &
+             Mask(Max<L>(ax, bx) >= box.min_x) &
+             Mask(Min<L>(ay, by) <= box.max_y) &
+             Mask(Max<L>(ay, by) >= box.min_y);
+  if (!Any(in_box)) {
+    lanes = in_box;
+    return;
+  }
+
+  L wx = p.GetX() - ax;
+  L wy = p.GetY() - ay;
+  L denominator = dx * e.GetY() - dy * e.GetX();
+  L sign = denominator >> 63;
+  L bound = ApplySign<L>(denominator, sign);
+  L s = ApplySign<L>(wx * e.GetY() - wy * e.GetX(), sign);
+  L t = ApplySign<L>(wx * dy - wy * dx, sign);
+  L inside =
+      Mask(s >= 0) & Mask(s <= bound) & Mask(t >= 0) & Mask(t <= bound);
+
+  L parallel = Mask(denominator == 0);
+  L ends_on{};
+  if (Any(parallel)) {
+    ends_on = OnSegment<L>(ax - p.GetX(), ay - p.GetY(), bx - p.GetX(),
+                           by - p.GetY()) |
+              OnSegment<L>(ax - q.GetX(), ay - q.GetY(), bx - q.GetX(),
+                           by - q.GetY()) |
+              OnSegment<L>(p.GetX() - ax, p.GetY() - ay, q.GetX() - ax,
+                           q.GetY() - ay) |
+              OnSegment<L>(p.GetX() - bx, p.GetY() - by, q.GetX() - bx,
+                           q.GetY() - by);
+  }
+  lanes = in_box & ((parallel & ends_on) | (~parallel & inside));
+}
+
+template <typename L>
+static __attribute__((always_inline)) inline void Hits(
+    const LineSoA& lines, size_t i, const Vector& point, L& lanes) {
+  L vx = point.GetX() - Load<L>(lines.x, i);
+  L vy = point.GetY() - Load<L>(lines.y, i);
+  lanes = Mask(vx * Load<L>(lines.dy, i) - vy * Load<L>(lines.dx, i) == 0);
+}
+
+// the ends of the segment are not strictly on one side of the line
+template <typename L>
+static __attribute__((always_inline)) inline void Hits(
+    const LineSoA& lines, size_t i, const SegmentQuery& segment, L& lanes) {
+  L x = Load<L>(lines.x, i);
+  L y = Load<L>(lines.y, i);
+  L dx = Load<L>(lines.dx, i);
+  L dy = Load<L>(lines.dy, i);
+  L side_p = (segment.start.GetX() - x) * dy - (segment.start.GetY() - y) * dx;
+  L side_q = (segment.end.GetX() - x) * dy - (segment.end.GetY() - y) * dx;
+  lanes = ~(Mask(side_p > 0) & Mask(side_q > 0)) &
+          ~(Mask(side_p < 0) & Mask(side_q < 0));
+}
+
+template <typename L>
+static __attribute__((always_inline)) inline L OnRay(
+    const L& ax, const L& ay, const L& dx, const L& dy, const Vector& point) {
+  L vx = point.GetX() - ax;
+  L vy = point.GetY() - ay;
+  return Mask(vx * dy - vy * dx == 0) & Mask(vx * dx + vy * dy >= 0);
+}
+
+template <typename L>
+static __attribute__((always_inline)) inline void Hits(
+    const RaySoA& rays, size_t i, const Vector& point, L& lanes) {
+  lanes = OnRay<L>(Load<L>(rays.x, i), Load<L>(rays.y, i),
+                   Load<L>(rays.dx, i), Load<L>(rays.dy, i), point);
+}
+
+// as for segments, with s unbounded above; a ray with a zero vector
+// passes the box test and contains every point, as in Ray::BoundingBox
+template <typename L>
+static __attribute__((always_inline)) inline void Hits(
+    const RaySoA& rays, size_t i, const SegmentQuery& segment, L& lanes) {
+  L ax = Load<L>(rays.x, i);
+  L ay = Load<L>(rays.y, i);
+  L dx = Load<L>(rays.dx, i);
+  L dy = Load<L>(rays.dy, i);
+  const Box& box = segment.box;
+  const Vector& e = segment.direction;
+
+  L in_box = (Mask(dx < 0) | Mask(ax <= box.max_x)) &
+             (Mask(dx > 0) | Mask(ax >= box.min_x)) &
+             (Mask(dy < 0) | Mask(ay <= box.max_y)) &
+             (Mask(dy > 0) | Mask(ay >= box.min_y));
+  in_box |= Mask(dx == 0) & Mask(dy == 0);
+  if (!Any(in_box)) {
+    lanes = in_box;
+    return;
+  }
+
+  L wx = segment.start.GetX() - ax;
+  L wy = segment.start.GetY() - ay;
+  L denominator = dx * e.GetY() - dy * e.GetX();
+  L sign = denominator >> 63;
+  L bound = ApplySign<L>(denominator, sign);
+  L s = ApplySign<L>(wx * e.GetY() - wy * e.GetX(), sign);
+  L t = ApplySign<L>(wx * dy - wy * dx, sign);
+  L inside = Mask(s >= 0) & Mask(t >= 0) & Mask(t <= bound);
+
+  L parallel = Mask(denominator == 0);
+  L ends_on{};
+  if (Any(parallel)) {
+    ends_on = OnRay<L>(ax, ay, dx, dy, segment.start) |
+              OnRay<L>(ax, ay, dx, dy, segment.end);
+  }
+  lanes = in_box & ((parallel & ends_on) | (~parallel & inside));
+}
+
+template <typename L>
+static __attribute__((always_inline)) inline void Hits(
+    const CircleSoA& circles, size_t i, const Vector& point, L& lanes) {
+  L dx = point.GetX() - Load<L>(circles.x, i);
+  L dy = point.GetY() - Load<L>(circles.y, i);
+  L r = Load<L>(circles.r, i);
+  lanes = Mask(dx * dx + dy * dy <= r * r);
+}
+
+// a * b <= c * d for the lanes: the products of products of differences
+// do not fit in int64_t, so they are compared in __int128 one lane at a time
+static __attribute__((always_inline)) inline int64_t ProductNotAbove(
+    int64_t a, int64_t b, int64_t c, int64_t d) {
+  return Mask(static_cast<__int128>(a) * b <= static_cast<__int128>(c) * d);
+}
+
+static __attribute__((always_inline)) inline Int64x4 ProductNotAbove(
+    const Int64x4& a, const Int64x4& b, const Int64x4& c, const Int64x4& d) {
+  Int64x4 result;
+  for (int k = 0; k < 4; k++) {
+    result[k] = ProductNotAbove(a[k], b[k], c[k], d[k]);
+  }
+  return result;
+}
+
+// see Circle::CrossSegment
+template <typename L>
+static __attribute__((always_inline)) inline void Hits(
+    const CircleSoA& circles, size_t i, const SegmentQuery& segment, L& lanes) {
+  L x = Load<L>(circles.x, i);
+  L y = Load<L>(circles.y, i);
+  L r = Load<L>(circles.r, i);
+  const Box& box = segment.box;
+  const Vector& e = segment.direction;
+
+  L in_box = Mask(x - r <= box.max_x) & Mask(x + r >= box.min_x) &
+             Mask(y - r <= box.max_y) & Mask(y + r >= box.min_y);
+  if (!Any(in_box)) {
+    lanes = in_box;
+    return;
+  }
+  L r_sqr = r * r;
+  L ax = segment.start.GetX() - x;
+  L ay = segment.start.GetY() - y;
+  L bx = segment.end.GetX() - x;
+  L by = segment.end.GetY() - y;
+  L dist_a = ax * ax + ay * ay;
+  L dist_b = bx * bx + by * by;
+
+  L on_circle = Mask(dist_a == r_sqr) | Mask(dist_b == r_sqr);
+  L a_inside = Mask(dist_a < r_sqr);
+  L b_inside = Mask(dist_b < r_sqr);
+  lanes = in_box & (on_circle | (a_inside ^ b_inside));
+
+  // a zero-length segment passes every test with ab, so it never counts as
+  // near the line, as in Circle::CrossSegment
+  int64_t ab_sqr = e * e;
+  L candidates = in_box & ~lanes & ~a_inside & ~b_inside &
+                 Mask(e.GetX() * ax + e.GetY() * ay <= 0) &
+                 Mask(e.GetX() * bx + e.GetY() * by >= 0);
+  if (ab_sqr == 0 || !Any(candidates)) {
+    return;
+  }
+  L cross = ax * by - ay * bx;
+  L ab_lanes = L{} + ab_sqr;
+  lanes |= candidates & ProductNotAbove(cross, cross, r_sqr, ab_lanes);
+}
+
+// sets the bits of the shapes [begin, ids.size()) of the kind that hit
+template <typename SoA, typename Query>
+static void MarkHits(const SoA& shapes, const std::vector<size_t>& ids,
+                     size_t begin, const Query& query, ShapeMask& mask) {
+  for (size_t i = begin; i < ids.size(); i++) {
+    int64_t lane = 0;
+    Hits(shapes, i, query, lane);
+    if (lane != 0) {
+      SetBit(mask, ids[i]);
+    }
+  }
+}
+
+#ifdef GEOMETRY_X86
+
+static bool HasAvx2() {
+  static const bool kHasAvx2 = __builtin_cpu_supports("avx2");
+  return kHasAvx2;
+}
+
+// the same four shapes at a time; the tail goes to MarkHits
+template <typename SoA, typename Query>
+__attribute__((target("avx2"))) static void MarkHitsAvx2(
+    const SoA& shapes, const std::vector<size_t>& ids, const Query& query,
+    ShapeMask& mask) {
+  size_t i = 0;
+  for (; i + 4 <= ids.size(); i += 4) {
+    Int64x4 lanes;
+    Hits(shapes, i, query, lanes);
+    auto bits = static_cast<unsigned>(
+        _mm256_movemask_pd(_mm256_castsi256_pd((__m256i)lanes)));
+    while (bits != 0) {
+      SetBit(mask, ids[i + __builtin_ctz(bits)]);
+      bits &= bits - 1;
+    }
+  }
+  MarkHits(shapes, ids, i, query, mask);
+}
+
+#endif
+
+template <typename SoA, typename Query>
+static void Mark(const SoA& shapes, const Query& query, ShapeMask& mask) {
+#ifdef GEOMETRY_X86
+  if (HasAvx2()) {
+    MarkHitsAvx2(shapes, shapes.ids, query, mask);
+    return;
+  }
+#endif
+  MarkHits(shapes, shapes.ids, 0, query, mask);
+}
+
+// Shapes are sorted by their exact type: a subclass of Point or Circle may
+// override the predicates and goes to others_
+ShapeBatch::ShapeBatch(const std::vector<const IShape*>& shapes)
+    : size_(shapes.size()) {
+  for (size_t id = 0; id < shapes.size(); id++) {
+    const IShape* shape = shapes[id];
+    if (typeid(*shape) == typeid(Point)) {
+      auto point = static_cast<const Point*>(shape);
+      points_.x.push_back(point->GetX());
+      points_.y.push_back(point->GetY());
+      points_.ids.push_back(id);
+    } else if (typeid(*shape) == typeid(Segment)) {
+      auto segment = static_cast<const Segment*>(shape);
+      Vector direction = segment->GetB() - segment->GetA();
+      segments_.x.push_back(segment->GetA().GetX());
+      segments_.y.push_back(segment->GetA().GetY());
+      segments_.dx.push_back(direction.GetX());
+      segments_.dy.push_back(direction.GetY());
+      segments_.ids.push_back(id);
+    } else if (typeid(*shape) == typeid(Line)) {
+      auto line = static_cast<const Line*>(shape);
+      lines_.x.push_back(line->GetBase().GetX());
+      lines_.y.push_back(line->GetBase().GetY());
+      lines_.dx.push_back(line->GetVector().GetX());
+      lines_.dy.push_back(line->GetVector().GetY());
+      lines_.ids.push_back(id);
+    } else if (typeid(*shape) == typeid(Ray)) {
+      auto ray = static_cast<const Ray*>(shape);
+      rays_.x.push_back(ray->GetA().GetX());
+      rays_.y.push_back(ray->GetA().GetY());
+      rays_.dx.push_back(ray->GetVector().GetX());
+      rays_.dy.push_back(ray->GetVector().GetY());
+      rays_.ids.push_back(id);
+    } else if (typeid(*shape) == typeid(Circle)) {
+      auto circle = static_cast<const Circle*>(shape);
+      circles_.x.push_back(circle->GetCentre().GetX());
+      circles_.y.push_back(circle->GetCentre().GetY());
+      circles_.r.push_back(circle->GetRadius());
+      circles_.ids.push_back(id);
+    } else {
+      others_.emplace_back(shape->Clone());
+      other_ids_.push_back(id);
+    }
+  }
+}
+
+ShapeMask ShapeBatch::ContainingShapes(const Point& point) const {
+  ShapeMask mask((size_ + 63) / 64);
+  Vector position(point.GetX(), point.GetY());
+  Mark(points_, position, mask);
+  Mark(segments_, position, mask);
+  Mark(lines_, position, mask);
+  Mark(rays_, position, mask);
+  Mark(circles_, position, mask);
+  for (size_t k = 0; k < others_.size(); k++) {
+    if (others_[k]->ContainsPoint(point)) {
+      SetBit(mask, other_ids_[k]);
+    }
+  }
+  return mask;
+}
+
+ShapeMask ShapeBatch::CrossedShapes(const Segment& segment) const {
+  ShapeMask mask((size_ + 63) / 64);
+  SegmentQuery query;
+  query.start = segment.GetA() - Point(0, 0);
+  query.end = segment.GetB() - Point(0, 0);
+  query.direction = query.end - query.start;
+  query.box = Box::Around(query.start, query.end);
+  Mark(points_, query, mask);
+  Mark(segments_, query, mask);
+  Mark(lines_, query, mask);
+  Mark(rays_, query, mask);
+  Mark(circles_, query, mask);
+  for (size_t k = 0; k < others_.size(); k++) {
+    if (others_[k]->CrossSegment(segment)) {
+      SetBit(mask, other_ids_[k]);
+    }
+  }
+  return mask;
+}
+
+std::vector<ShapeMask> ShapeBatch::ContainingShapes(
+    const std::vector<Point>& points, size_t thread_count) const {
+  return AnswerQueries<ShapeMask>(
+      points, thread_count,
+      [this](const Point& point) { return ContainingShapes(point); });
+}
+
+std::vector<ShapeMask> ShapeBatch::CrossedShapes(
+    const std::vector<Segment>& segments, size_t thread_count) const {
+  return AnswerQueries<ShapeMask>(
+      segments, thread_count,
+      [this](const Segment& segment) { return CrossedShapes(segment); });
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "geometry.hpp"
+
+// Маска фигур пакета: бит id % 64 слова id / 64 означает ответ "да"
+// для фигуры с номером id
+using ShapeMask = std::vector<uint64_t>;
+
+// ответ маски для фигуры id
+inline bool HasShape(const ShapeMask& mask, size_t id) {
+  return (mask[id / 64] >> (id % 64) & 1) != 0;
+}
+
+// Фигуры одного вида по столбцам (structure of arrays): i-я фигура вида
+// составлена из i-х элементов массивов, ids[i] - ее номер в пакете
+struct PointSoA {
+  std::vector<int64_t> x;
+  std::vector<int64_t> y;
+  std::vector<size_t> ids;
+};
+
+// начало (x, y) и направляющий вектор (dx, dy) отрезков
+struct SegmentSoA {
+  std::vector<int64_t> x;
+  std::vector<int64_t> y;
+  std::vector<int64_t> dx;
+  std::vector<int64_t> dy;
+  std::vector<size_t> ids;
+};
+
+// точка (x, y) и направляющий вектор (dx, dy) прямых: в отличие от
+// коэффициента C уравнения прямой, они не зависят от произведений
+// абсолютных координат
+struct LineSoA {
+  std::vector<int64_t> x;
+  std::vector<int64_t> y;
+  std::vector<int64_t> dx;
+  std::vector<int64_t> dy;
+  std::vector<size_t> ids;
+};
+
+// начало (x, y) и направляющий вектор (dx, dy) лучей
+struct RaySoA {
+  std::vector<int64_t> x;
+  std::vector<int64_t> y;
+  std::vector<int64_t> dx;
+  std::vector<int64_t> dy;
+  std::vector<size_t> ids;
+};
+
+// центры (x, y) и радиусы r окружностей
+struct CircleSoA {
+  std::vector<int64_t> x;
+  std::vector<int64_t> y;
+  std::vector<int64_t> r;
+  std::vector<size_t> ids;
+};
+
+// Пакет фигур для массовых проверок ContainsPoint и CrossSegment без
+// виртуальных вызовов: фигуры разложены по видам в SoA-массивы, и запрос
+// проверяется сразу против четырех фигур вида одной AVX2-инструкцией над
+// int64_t (без AVX2 - по одной). Ответы совпадают с методами IShape, если
+// произведения разностей координат помещаются в int64_t: ядра считают их
+// без расширения до __int128.
+// Фигуры других наследников IShape хранятся копиями и проверяются их
+// виртуальными методами.
+class ShapeBatch {
+ public:
+  ShapeBatch() = default;
+
+  // Пакет из фигур shapes; номер фигуры - ее позиция в shapes
+  explicit ShapeBatch(const std::vector<const IShape*>& shapes);
+
+  ShapeBatch(ShapeBatch&& other) = default;
+  ShapeBatch& operator=(ShapeBatch&& other) = default;
+
+  // число фигур
+  size_t Size() const { return size_; }
+
+  // маска фигур, содержащих точку
+  ShapeMask ContainingShapes(const Point& point) const;
+
+  // маска фигур, которые пересекает отрезок
+  ShapeMask CrossedShapes(const Segment& segment) const;
+
+  // Те же запросы для многих точек или отрезков сразу, в thread_count
+  // потоках (0 - по числу аппаратных потоков); ответ i - для запроса i
+  std::vector<ShapeMask> ContainingShapes(const std::vector<Point>& points,
+                                          size_t thread_count = 0) const;
+  std::vector<ShapeMask> CrossedShapes(const std::vector<Segment>& segments,
+                                       size_t thread_count = 0) const;
+
+ private:
+  size_t size_ = 0;
+  PointSoA points_;
+  SegmentSoA segments_;
+  LineSoA lines_;
+  RaySoA rays_;
+  CircleSoA circles_;
+  // фигуры остальных видов
+  std::vector<std::unique_ptr<IShape>> others_;
+  std::vector<size_t> other_ids_;
+};
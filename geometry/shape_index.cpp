@@ -0,0 +1,190 @@
+#include "shape_index.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "batch_queries.hpp"
+#include "exact.hpp"
+
+static int64_t CenterX(const Box& box) {
+  return box.min_x / 2 + box.max_x / 2;
+}
+
+static int64_t CenterY(const Box& box) {
+  return box.min_y / 2 + box.max_y / 2;
+}
+
+template <typename Item>
+static const Box& BoxOf(const Item& item) {
+  return item.box;
+}
+
+// side of the point (x, y) relative to the directed line from a to b
+static int Side(const Vector& a, const Vector& b, int64_t x, int64_t y) {
+  __int128 dx = static_cast<__int128>(b.GetX()) - a.GetX();
+  __int128 dy = static_cast<__int128>(b.GetY()) - a.GetY();
+  return exact::CompareProducts(dx, static_cast<__int128>(y) - a.GetY(), dy,
+                                static_cast<__int128>(x) - a.GetX());
+}
+
+// the segment ab may cross the box: the boxes overlap and the line through
+// a and b does not leave all four corners strictly on one side
+static bool SegmentMayCross(const Vector& a, const Vector& b,
+                            const Box& segment_box, const Box& box) {
+  if (!segment_box.Intersects(box)) {
+    return false;
+  }
+  int sides[] = {Side(a, b, box.min_x, box.min_y),
+                 Side(a, b, box.min_x, box.max_y),
+                 Side(a, b, box.max_x, box.min_y),
+                 Side(a, b, box.max_x, box.max_y)};
+  bool positive = false;
+  bool negative = false;
+  for (int side : sides) {
+    positive = positive || side >= 0;
+    negative = negative || side <= 0;
+  }
+  return positive && negative;
+}
+
+// Orders items for packing: sorted by x of the center into vertical
+// slices of whole nodes, each slice sorted by y of the center
+template <typename Item>
+void ShapeIndex::SortTileRecursive(std::vector<Item>& items) {
+  auto by_x = [](const Item& left, const Item& right) {
+    return CenterX(BoxOf(left)) < CenterX(BoxOf(right));
+  };
+  auto by_y = [](const Item& left, const Item& right) {
+    return CenterY(BoxOf(left)) < CenterY(BoxOf(right));
+  };
+  const size_t kCapacity = kShapeIndexNodeCapacity;
+  size_t node_count = (items.size() + kCapacity - 1) / kCapacity;
+  auto slice_count = static_cast<size_t>(
+      std::ceil(std::sqrt(static_cast<double>(node_count))));
+  size_t slice_size = std::max<size_t>(
+      (node_count + slice_count - 1) / std::max<size_t>(slice_count, 1) *
+          kCapacity,
+      kCapacity);
+  std::sort(items.begin(), items.end(), by_x);
+  for (size_t begin = 0; begin < items.size(); begin += slice_size) {
+    size_t end = std::min(items.size(), begin + slice_size);
+    std::sort(items.begin() + begin, items.begin() + end, by_y);
+  }
+}
+
+ShapeIndex::ShapeIndex(const std::vector<const IShape*>& shapes) {
+  const size_t kCapacity = kShapeIndexNodeCapacity;
+  shapes_.reserve(shapes.size());
+  for (size_t id = 0; id < shapes.size(); id++) {
+    shapes_.emplace_back(shapes[id]->Clone());
+    Box box = shapes_.back()->BoundingBox();
+    if (box.IsBounded()) {
+      entries_.push_back({box, id});
+    } else {
+      unbounded_.push_back(id);
+    }
+  }
+  if (entries_.empty()) {
+    return;
+  }
+
+  // leaves over consecutive entries, then levels over consecutive nodes
+  SortTileRecursive(entries_);
+  std::vector<Node> level;
+  for (size_t first = 0; first < entries_.size(); first += kCapacity) {
+    Node node;
+    node.first = first;
+    node.count = std::min(kCapacity, entries_.size() - first);
+    node.box = entries_[first].box;
+    for (size_t i = first + 1; i < first + node.count; i++) {
+      node.box = Box::Union(node.box, entries_[i].box);
+    }
+    level.push_back(node);
+  }
+  leaf_count_ = level.size();
+  while (true) {
+    SortTileRecursive(level);
+    size_t level_begin = nodes_.size();
+    nodes_.insert(nodes_.end(), level.begin(), level.end());
+    if (level.size() == 1) {
+      break;
+    }
+    std::vector<Node> parents;
+    for (size_t first = 0; first < level.size(); first += kCapacity) {
+      Node node;
+      node.first = level_begin + first;
+      node.count = std::min(kCapacity, level.size() - first);
+      node.box = level[first].box;
+      for (size_t i = first + 1; i < first + node.count; i++) {
+        node.box = Box::Union(node.box, level[i].box);
+      }
+      parents.push_back(node);
+    }
+    level.swap(parents);
+  }
+}
+
+template <typename MayContain, typename Matches>
+void ShapeIndex::Search(const MayContain& may_contain, const Matches& matches,
+                        std::vector<size_t>& result) const {
+  for (size_t id : unbounded_) {
+    if (may_contain(shapes_[id]->BoundingBox()) && matches(*shapes_[id])) {
+      result.push_back(id);
+    }
+  }
+  std::vector<size_t> stack;
+  if (!nodes_.empty() && may_contain(nodes_.back().box)) {
+    stack.push_back(nodes_.size() - 1);
+  }
+  while (!stack.empty()) {
+    const Node& node = nodes_[stack.back()];
+    bool is_leaf = stack.back() < leaf_count_;
+    stack.pop_back();
+    for (size_t i = node.first; i < node.first + node.count; i++) {
+      if (is_leaf) {
+        const Entry& entry = entries_[i];
+        if (may_contain(entry.box) && matches(*shapes_[entry.id])) {
+          result.push_back(entry.id);
+        }
+      } else if (may_contain(nodes_[i].box)) {
+        stack.push_back(i);
+      }
+    }
+  }
+  std::sort(result.begin(), result.end());
+}
+
+std::vector<size_t> ShapeIndex::ContainingShapes(const Point& point) const {
+  std::vector<size_t> result;
+  Vector position(point.GetX(), point.GetY());
+  Search([&position](const Box& box) { return box.Contains(position); },
+         [&point](const IShape& shape) { return shape.ContainsPoint(point); },
+         result);
+  return result;
+}
+
+std::vector<size_t> ShapeIndex::CrossedShapes(const Segment& segment) const {
+  std::vector<size_t> result;
+  Vector a = segment.GetA() - Point(0, 0);
+  Vector b = segment.GetB() - Point(0, 0);
+  Box segment_box = Box::Around(a, b);
+  Search(
+      [&](const Box& box) { return SegmentMayCross(a, b, segment_box, box); },
+      [&segment](const IShape& shape) { return shape.CrossSegment(segment); },
+      result);
+  return result;
+}
+
+std::vector<std::vector<size_t>> ShapeIndex::ContainingShapes(
+    const std::vector<Point>& points, size_t thread_count) const {
+  return AnswerQueries<std::vector<size_t>>(
+      points, thread_count,
+      [this](const Point& point) { return ContainingShapes(point); });
+}
+
+std::vector<std::vector<size_t>> ShapeIndex::CrossedShapes(
+    const std::vector<Segment>& segments, size_t thread_count) const {
+  return AnswerQueries<std::vector<size_t>>(
+      segments, thread_count,
+      [this](const Segment& segment) { return CrossedShapes(segment); });
+}
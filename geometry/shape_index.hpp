@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "geometry.hpp"
+
+// Пространственный индекс набора фигур: R-дерево по ограничивающим
+// прямоугольникам, упакованное при построении по схеме STR
+// (Sort-Tile-Recursive): фигуры сортируются по x центра, делятся на
+// вертикальные полосы, внутри полосы сортируются по y и режутся на узлы
+// по kShapeIndexNodeCapacity. Так же строится каждый следующий уровень.
+//
+// Запрос спускается только в узлы, чей прямоугольник может содержать
+// ответ, и точно проверяет фигуры в найденных листьях, так что для
+// точки это O(log n + ответ) проверок вместо n. Прямые и лучи
+// неограниченны и проверяются при каждом запросе.
+static const size_t kShapeIndexNodeCapacity = 16;
+
+class ShapeIndex {
+ public:
+  ShapeIndex() = default;
+
+  // Индекс копий (Clone) фигур; номер фигуры - ее позиция в shapes
+  explicit ShapeIndex(const std::vector<const IShape*>& shapes);
+
+  ShapeIndex(ShapeIndex&& other) = default;
+  ShapeIndex& operator=(ShapeIndex&& other) = default;
+
+  // число фигур
+  size_t Size() const { return shapes_.size(); }
+
+  // фигура с номером id
+  const IShape& Shape(size_t id) const { return *shapes_[id]; }
+
+  // номера фигур, содержащих точку, по возрастанию
+  std::vector<size_t> ContainingShapes(const Point& point) const;
+
+  // номера фигур, которые пересекает отрезок, по возрастанию
+  std::vector<size_t> CrossedShapes(const Segment& segment) const;
+
+  // Те же запросы для многих точек или отрезков сразу, в thread_count
+  // потоках (0 - по числу аппаратных потоков); ответ i - для запроса i
+  std::vector<std::vector<size_t>> ContainingShapes(
+      const std::vector<Point>& points, size_t thread_count = 0) const;
+  std::vector<std::vector<size_t>> CrossedShapes(
+      const std::vector<Segment>& segments, size_t thread_count = 0) const;
+
+ private:
+  // Узел дерева: дети - count элементов начиная с first, для листьев
+  // в entries_, для остальных узлов в nodes_
+  struct Node {
+    Box box;
+    size_t first = 0;
+    size_t count = 0;
+  };
+
+  struct Entry {
+    Box box;
+    size_t id = 0;
+  };
+
+  template <typename Item>
+  static void SortTileRecursive(std::vector<Item>& items);
+
+  // обходит поддеревья, чьи прямоугольники проходят фильтр may_contain,
+  // и добавляет в result номера фигур, прошедших точную проверку matches
+  template <typename MayContain, typename Matches>
+  void Search(const MayContain& may_contain, const Matches& matches,
+              std::vector<size_t>& result) const;
+
+  std::vector<std::unique_ptr<IShape>> shapes_;
+  // ограниченные фигуры в порядке листьев
+  std::vector<Entry> entries_;
+  // неограниченные фигуры, проверяются все
+  std::vector<size_t> unbounded_;
+  // уровни дерева от листьев к корню, корень - последний узел
+  std::vector<Node> nodes_;
+  // первые leaf_count_ узлов - листья
+  size_t leaf_count_ = 0;
+};
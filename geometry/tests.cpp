@@ -0,0 +1,475 @@
+#include "geometry.hpp"
+#include "shape_batch.hpp"
+#include "polygon.hpp"
+#include "segment_sweep.hpp"
+#include "shape_index.hpp"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+TEST(Circle, CrossPointSegment) {
+  Circle circle(Point(0, -3), 4);
+  // inside the bounding box of the circle, but outside the circle
+  ASSERT_FALSE(circle.CrossSegment(Segment(Point(-4, -1), Point(-4, -1))));
+  ASSERT_FALSE(circle.CrossSegment(Segment(Point(3, 0), Point(3, 0))));
+  ASSERT_TRUE(circle.CrossSegment(Segment(Point(0, 1), Point(0, 1))));
+  ASSERT_FALSE(circle.CrossSegment(Segment(Point(1, -2), Point(1, -2))));
+}
+
+TEST(Circle, CrossSegment) {
+  Circle circle(Point(0, -3), 4);
+  ASSERT_TRUE(circle.CrossSegment(Segment(Point(-5, -3), Point(5, -3))));
+  ASSERT_TRUE(circle.CrossSegment(Segment(Point(-4, 1), Point(4, 1))));
+  ASSERT_TRUE(circle.CrossSegment(Segment(Point(0, -3), Point(10, -3))));
+  ASSERT_FALSE(circle.CrossSegment(Segment(Point(-1, -3), Point(1, -3))));
+  ASSERT_FALSE(circle.CrossSegment(Segment(Point(-4, 2), Point(4, 2))));
+  ASSERT_FALSE(circle.CrossSegment(Segment(Point(3, 0), Point(5, 2))));
+}
+
+TEST(Ray, ZeroVector) {
+  // as in ContainsPoint, every point lies on such a ray
+  Ray ray(Point(1, 1), Point(1, 1));
+  ASSERT_FALSE(ray.BoundingBox().IsBounded());
+  ASSERT_TRUE(ray.ContainsPoint(Point(5, -7)));
+  ASSERT_TRUE(ray.CrossSegment(Segment(Point(5, -7), Point(6, -7))));
+  ASSERT_TRUE(ray.CrossSegment(Segment(Point(-3, 4), Point(-3, 4))));
+
+  ShapeBatch batch({&ray});
+  ASSERT_TRUE(HasShape(batch.ContainingShapes(Point(5, -7)), 0));
+  ASSERT_TRUE(
+      HasShape(batch.CrossedShapes(Segment(Point(5, -7), Point(6, -7))), 0));
+  ShapeIndex index({&ray});
+  ASSERT_EQ(index.ContainingShapes(Point(5, -7)), std::vector<size_t>{0});
+  ASSERT_EQ(index.CrossedShapes(Segment(Point(5, -7), Point(6, -7))),
+            std::vector<size_t>{0});
+}
+
+TEST(ShapeBatch, CirclesCrossPointSegment) {
+  Circle near(Point(0, -3), 4);
+  Circle through(Point(-4, 2), 3);
+  ShapeBatch batch({&near, &through});
+  std::vector<Segment> segments = {Segment(Point(-4, -1), Point(-4, -1)),
+                                   Segment(Point(0, 1), Point(0, 1))};
+  std::vector<ShapeMask> crossed = batch.CrossedShapes(segments);
+  ASSERT_FALSE(HasShape(crossed[0], 0));
+  ASSERT_TRUE(HasShape(crossed[0], 1));
+  ASSERT_TRUE(HasShape(crossed[1], 0));
+  ASSERT_FALSE(HasShape(crossed[1], 1));
+}
+
+TEST(ShapeBatch, LinesFarFromOrigin) {
+  // x1 * y2 - x2 * y1 of these ends does not fit in int64_t
+  const int64_t far = int64_t(1) << 40;
+  Line line(Point(far, far), Point(far + 1, far + 2));
+  Line vertical(Point(-far, far), Point(-far, far + 1));
+  ShapeBatch batch({&line, &vertical});
+  std::vector<Point> points = {Point(far + 3, far + 6),
+                               Point(far + 3, far + 5),
+                               Point(-far, -far)};
+  std::vector<ShapeMask> contained = batch.ContainingShapes(points);
+  std::vector<Segment> segments = {
+      Segment(Point(far, far + 1), Point(far + 1, far)),
+      Segment(Point(far, far + 1), Point(far + 1, far + 3)),
+      Segment(Point(-far - 1, 0), Point(-far + 1, 0))};
+  std::vector<ShapeMask> crossed = batch.CrossedShapes(segments);
+  for (size_t i = 0; i < points.size(); ++i) {
+    ASSERT_EQ(HasShape(contained[i], 0), line.ContainsPoint(points[i]));
+    ASSERT_EQ(HasShape(contained[i], 1), vertical.ContainsPoint(points[i]));
+    ASSERT_EQ(HasShape(crossed[i], 0), line.CrossSegment(segments[i]));
+    ASSERT_EQ(HasShape(crossed[i], 1), vertical.CrossSegment(segments[i]));
+  }
+  ASSERT_TRUE(HasShape(contained[0], 0));
+  ASSERT_TRUE(HasShape(contained[2], 1));
+  ASSERT_TRUE(HasShape(crossed[0], 0));
+  ASSERT_FALSE(HasShape(crossed[1], 0));
+  ASSERT_TRUE(HasShape(crossed[2], 1));
+}
+
+TEST(ShapeBatch, LargeCircles) {
+  // (a ^ b)^2 and r^2 * |ab|^2 of these circles do not fit in int64_t
+  const int64_t far = int64_t(1) << 40;
+  Circle small(Point(0, 0), 30000);
+  Circle large(Point(0, 0), 1000000);
+  Circle shifted(Point(far, -far), 1000000);
+  std::vector<const Circle*> circles = {&small, &large, &small, &large,
+                                        &large};
+  std::vector<Segment> segments = {
+      Segment(Point(-60000, 15000), Point(60000, 15000)),
+      Segment(Point(-60000, 30001), Point(60000, 30001)),
+      Segment(Point(-3000000, 999999), Point(3000000, 999999)),
+      Segment(Point(-3000000, 1000001), Point(3000000, 1000001))};
+  std::vector<ShapeMask> crossed =
+      ShapeBatch({circles.begin(), circles.end()}).CrossedShapes(segments);
+  for (size_t i = 0; i < segments.size(); ++i) {
+    for (size_t id = 0; id < circles.size(); ++id) {
+      ASSERT_EQ(HasShape(crossed[i], id),
+                circles[id]->CrossSegment(segments[i]));
+    }
+  }
+  ASSERT_TRUE(HasShape(crossed[0], 0));
+  ASSERT_FALSE(HasShape(crossed[1], 0));
+  ASSERT_TRUE(HasShape(crossed[2], 1));
+  ASSERT_FALSE(HasShape(crossed[3], 1));
+
+  std::vector<Segment> far_segments = {
+      Segment(Point(far - 3000000, -far + 999999),
+              Point(far + 3000000, -far + 999999)),
+      Segment(Point(far - 3000000, -far - 1000001),
+              Point(far + 3000000, -far - 1000001))};
+  crossed = ShapeBatch({&shifted}).CrossedShapes(far_segments);
+  ASSERT_TRUE(HasShape(crossed[0], 0));
+  ASSERT_FALSE(HasShape(crossed[1], 0));
+}
+
+// shapes of every kind with ends in [-range, range]^2
+static std::vector<std::unique_ptr<IShape>> RandomShapes(
+    size_t count, int64_t range, std::mt19937_64& random) {
+  std::uniform_int_distribution<int64_t> coord(-range, range);
+  std::uniform_int_distribution<int64_t> shift(-20, 20);
+  std::vector<std::unique_ptr<IShape>> shapes;
+  for (size_t i = 0; i < count; ++i) {
+    Point a(coord(random), coord(random));
+    Point b(a.GetX() + shift(random), a.GetY() + shift(random));
+    switch (random() % 5) {
+      case 0:
+        shapes.emplace_back(new Point(a));
+        break;
+      case 1:
+        shapes.emplace_back(new Segment(a, b));
+        break;
+      case 2:
+        shapes.emplace_back(new Line(a, b));
+        break;
+      case 3:
+        shapes.emplace_back(new Ray(a, b));
+        break;
+      default:
+        shapes.emplace_back(new Circle(a, random() % 20));
+    }
+  }
+  return shapes;
+}
+
+TEST(ShapeIndex, MatchesShapes) {
+  std::mt19937_64 random(45);
+  const int64_t range = 200;
+  std::vector<std::unique_ptr<IShape>> owned =
+      RandomShapes(1000, range, random);
+  std::vector<const IShape*> shapes;
+  for (const auto& shape : owned) {
+    shapes.push_back(shape.get());
+  }
+  // a zero vector, a line and rays along the axes through the whole range
+  Ray still(Point(3, 3), Point(3, 3));
+  Line diagonal(Point(0, 0), Point(1, 1));
+  Ray right(Point(-range, 7), Point(0, 7));
+  Ray down(Point(11, range), Point(11, -range));
+  shapes.insert(shapes.end(), {&still, &diagonal, &right, &down});
+  ShapeIndex index(shapes);
+  ASSERT_EQ(index.Size(), shapes.size());
+
+  std::uniform_int_distribution<int64_t> coord(-range, range);
+  std::uniform_int_distribution<int64_t> shift(-30, 30);
+  std::vector<Point> points;
+  std::vector<Segment> segments;
+  for (int i = 0; i < 300; ++i) {
+    Point a(coord(random), coord(random));
+    Point b(a.GetX() + shift(random), a.GetY() + shift(random));
+    points.push_back(a);
+    segments.emplace_back(a, b);
+  }
+  // corners of the boxes touch the shapes and lie on their borders
+  for (size_t id = 0; id < 100; ++id) {
+    Box box = shapes[id]->BoundingBox();
+    if (!box.IsBounded()) {
+      continue;
+    }
+    points.emplace_back(box.min_x, box.min_y);
+    segments.emplace_back(Point(box.min_x, box.max_y),
+                          Point(box.max_x, box.max_y));
+  }
+  points.emplace_back(-range - 1, -range - 1);
+  segments.emplace_back(Point(5, -range - 1), Point(5, -range - 1));
+
+  std::vector<std::vector<size_t>> contained = index.ContainingShapes(points);
+  std::vector<std::vector<size_t>> crossed = index.CrossedShapes(segments, 2);
+  ASSERT_EQ(contained.size(), points.size());
+  ASSERT_EQ(crossed.size(), segments.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    std::vector<size_t> expected_contained;
+    std::vector<size_t> expected_crossed;
+    for (size_t id = 0; id < shapes.size(); ++id) {
+      if (shapes[id]->ContainsPoint(points[i])) {
+        expected_contained.push_back(id);
+      }
+      if (shapes[id]->CrossSegment(segments[i])) {
+        expected_crossed.push_back(id);
+      }
+    }
+    ASSERT_EQ(index.ContainingShapes(points[i]), expected_contained);
+    ASSERT_EQ(contained[i], expected_contained);
+    ASSERT_EQ(index.CrossedShapes(segments[i]), expected_crossed);
+    ASSERT_EQ(crossed[i], expected_crossed);
+  }
+}
+
+TEST(ShapeIndex, Empty) {
+  ShapeIndex index(std::vector<const IShape*>{});
+  ASSERT_EQ(index.Size(), 0u);
+  ASSERT_TRUE(index.ContainingShapes(Point(0, 0)).empty());
+  ASSERT_TRUE(index.CrossedShapes(Segment(Point(0, 0), Point(1, 1))).empty());
+}
+
+// pairs by Segment::CrossSegment; only segments whose x ranges overlap
+// are compared, in the order of the left ends
+static std::vector<SegmentPair> CrossingPairs(
+    const std::vector<Segment>& segments) {
+  std::vector<size_t> order(segments.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&segments](size_t a, size_t b) {
+    return segments[a].BoundingBox().min_x < segments[b].BoundingBox().min_x;
+  });
+  std::vector<SegmentPair> pairs;
+  for (size_t i = 0; i < order.size(); ++i) {
+    int64_t max_x = segments[order[i]].BoundingBox().max_x;
+    for (size_t j = i + 1; j < order.size() &&
+                           segments[order[j]].BoundingBox().min_x <= max_x;
+         ++j) {
+      if (segments[order[i]].CrossSegment(segments[order[j]])) {
+        pairs.emplace_back(std::min(order[i], order[j]),
+                           std::max(order[i], order[j]));
+      }
+    }
+  }
+  std::sort(pairs.begin(), pairs.end());
+  return pairs;
+}
+
+// ends in [-range, range]^2 at most length apart along each axis; every
+// sixth segment is vertical, horizontal or a point
+static std::vector<Segment> RandomSegments(size_t count, int64_t range,
+                                           int64_t length,
+                                           std::mt19937_64& random) {
+  std::uniform_int_distribution<int64_t> coord(-range, range);
+  std::uniform_int_distribution<int64_t> shift(-length, length);
+  std::vector<Segment> segments;
+  for (size_t i = 0; i < count; ++i) {
+    Point a(coord(random), coord(random));
+    int64_t dx = shift(random);
+    int64_t dy = shift(random);
+    switch (random() % 6) {
+      case 0:
+        dx = 0;
+        break;
+      case 1:
+        dy = 0;
+        break;
+      case 2:
+        dx = 0;
+        dy = 0;
+        break;
+    }
+    segments.emplace_back(a, Point(a.GetX() + dx, a.GetY() + dy));
+  }
+  return segments;
+}
+
+TEST(SegmentSweep, SpecialCases) {
+  std::vector<Segment> segments = {
+      // collinear, overlapping and touching at an end
+      Segment(Point(0, 0), Point(4, 4)), Segment(Point(2, 2), Point(6, 6)),
+      Segment(Point(6, 6), Point(8, 8)), Segment(Point(9, 9), Point(10, 10)),
+      // vertical through a shared end and a point on it
+      Segment(Point(4, 4), Point(4, -3)), Segment(Point(4, 0), Point(4, 0)),
+      // the same point twice and a point far from the rest
+      Segment(Point(4, 0), Point(4, 0)), Segment(Point(-5, 7), Point(-5, 7)),
+      // vertical overlapping a vertical
+      Segment(Point(4, -1), Point(4, -8))};
+  std::vector<SegmentPair> expected = CrossingPairs(segments);
+  ASSERT_EQ(IntersectingPairs(segments), expected);
+  ASSERT_EQ(IntersectingPairsParallel(segments, 3), expected);
+  ASSERT_TRUE(IntersectingPairs({}).empty());
+}
+
+TEST(SegmentSweep, MatchesCrossSegment) {
+  std::mt19937_64 random(49);
+  for (int64_t range : {3, 10, 100}) {
+    for (int repeat = 0; repeat < 20; ++repeat) {
+      std::vector<Segment> segments = RandomSegments(60, range, 5, random);
+      std::vector<SegmentPair> expected = CrossingPairs(segments);
+      ASSERT_EQ(IntersectingPairs(segments), expected);
+      ASSERT_EQ(IntersectingPairsParallel(segments, 4), expected);
+    }
+  }
+}
+
+TEST(SegmentSweep, ManyStrips) {
+  std::mt19937_64 random(4096);
+  std::vector<Segment> segments =
+      RandomSegments(2 * kMinSweepStripSegments + 500, 3000, 40, random);
+  std::vector<SegmentPair> expected = CrossingPairs(segments);
+  ASSERT_FALSE(expected.empty());
+  ASSERT_EQ(IntersectingPairs(segments), expected);
+  ASSERT_EQ(IntersectingPairsParallel(segments, 3), expected);
+}
+
+TEST(SegmentSweep, CoordinateRange) {
+  const int64_t limit = kMaxSweepCoordinate;
+  std::vector<Segment> inside = {
+      Segment(Point(-limit + 1, 0), Point(limit - 1, 0)),
+      Segment(Point(0, -limit + 1), Point(0, limit - 1))};
+  std::vector<SegmentPair> crossing = {SegmentPair(0, 1)};
+  ASSERT_EQ(IntersectingPairs(inside), crossing);
+  std::vector<Segment> outside = {Segment(Point(0, 0), Point(1, 1)),
+                                  Segment(Point(0, 0), Point(limit, 1))};
+  ASSERT_THROW(IntersectingPairs(outside), std::invalid_argument);
+  ASSERT_THROW(IntersectingPairsParallel(outside, 2), std::invalid_argument);
+  outside[1] = Segment(Point(-limit, 0), Point(0, 0));
+  ASSERT_THROW(IntersectingPairs(outside), std::invalid_argument);
+}
+
+// the polygon by Segment::ContainsPoint on the sides and by counting the
+// sides crossed by the vertical ray down from the point
+static bool PolygonContains(const std::vector<Point>& vertices,
+                            const Point& point) {
+  bool inside = false;
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    const Point& a = vertices[i];
+    const Point& b = vertices[(i + 1) % vertices.size()];
+    if (Segment(a, b).ContainsPoint(point)) {
+      return true;
+    }
+    if ((a.GetX() <= point.GetX()) != (b.GetX() <= point.GetX())) {
+      const Point& left = a.GetX() < b.GetX() ? a : b;
+      const Point& right = a.GetX() < b.GetX() ? b : a;
+      if (((right - left) ^ (point - left)) < 0) {
+        inside = !inside;
+      }
+    }
+  }
+  return inside;
+}
+
+static void ExpectPolygon(const std::vector<Point>& vertices,
+                          const Polygon& polygon, int64_t shift_x,
+                          int64_t shift_y) {
+  Box box = vertices[0].BoundingBox();
+  for (const Point& vertex : vertices) {
+    box = Box::Union(box, vertex.BoundingBox());
+  }
+  for (int64_t x = box.min_x - 1; x <= box.max_x + 1; ++x) {
+    for (int64_t y = box.min_y - 1; y <= box.max_y + 1; ++y) {
+      ASSERT_EQ(polygon.ContainsPoint(Point(x + shift_x, y + shift_y)),
+                PolygonContains(vertices, Point(x, y)))
+          << x << " " << y;
+    }
+  }
+}
+
+TEST(Polygon, Convex) {
+  // (4, 2) lies on the vertical side
+  std::vector<Point> vertices = {Point(0, 0), Point(4, 0), Point(4, 2),
+                                 Point(4, 4), Point(1, 5), Point(0, 3)};
+  Polygon polygon(vertices);
+  ASSERT_TRUE(polygon.IsConvex());
+  for (const Point& vertex : vertices) {
+    ASSERT_TRUE(polygon.ContainsPoint(vertex));
+  }
+  ASSERT_TRUE(polygon.ContainsPoint(Point(4, 3)));
+  ASSERT_TRUE(polygon.ContainsPoint(Point(2, 2)));
+  ASSERT_FALSE(polygon.ContainsPoint(Point(5, 2)));
+  ASSERT_FALSE(polygon.ContainsPoint(Point(4, 5)));
+  ExpectPolygon(vertices, polygon, 0, 0);
+
+  std::reverse(vertices.begin(), vertices.end());
+  Polygon clockwise(vertices);
+  ASSERT_TRUE(clockwise.IsConvex());
+  ExpectPolygon(vertices, clockwise, 0, 0);
+}
+
+TEST(Polygon, NonConvex) {
+  // a comb with vertical sides, teeth of one width and collinear vertices
+  // at (2, 0) and (6, 5)
+  std::vector<Point> vertices = {
+      Point(0, 0), Point(2, 0), Point(7, 0), Point(7, 5), Point(6, 5),
+      Point(5, 5), Point(5, 2), Point(4, 2), Point(4, 5), Point(3, 5),
+      Point(3, 1), Point(1, 1), Point(1, 5), Point(0, 5)};
+  Polygon polygon(vertices);
+  ASSERT_FALSE(polygon.IsConvex());
+  for (const Point& vertex : vertices) {
+    ASSERT_TRUE(polygon.ContainsPoint(vertex));
+  }
+  ASSERT_TRUE(polygon.ContainsPoint(Point(4, 4)));
+  ASSERT_TRUE(polygon.ContainsPoint(Point(6, 3)));
+  ASSERT_FALSE(polygon.ContainsPoint(Point(2, 3)));
+  ASSERT_FALSE(polygon.ContainsPoint(Point(4, 6)));
+  ExpectPolygon(vertices, polygon, 0, 0);
+
+  std::reverse(vertices.begin(), vertices.end());
+  ExpectPolygon(vertices, Polygon(vertices), 0, 0);
+}
+
+TEST(Polygon, Move) {
+  std::vector<Point> comb = {Point(0, 0), Point(6, 0), Point(6, 4),
+                             Point(4, 4), Point(4, 2), Point(2, 2),
+                             Point(2, 4), Point(0, 4)};
+  std::vector<Point> triangle = {Point(0, 0), Point(5, 1), Point(2, 4)};
+  for (const std::vector<Point>& vertices : {comb, triangle}) {
+    Polygon polygon(vertices);
+    polygon.Move(Vector(10, -3));
+    ASSERT_EQ(polygon.GetVertex(1).GetX(), vertices[1].GetX() + 10);
+    ExpectPolygon(vertices, polygon, 10, -3);
+    std::unique_ptr<IShape> copy(polygon.Clone());
+    ASSERT_TRUE(copy->ContainsPoint(Point(11, -2)));
+    ASSERT_FALSE(copy->ContainsPoint(Point(1, 1)));
+  }
+}
+
+TEST(Polygon, CrossSegment) {
+  Polygon polygon({Point(0, 0), Point(6, 0), Point(6, 4), Point(4, 4),
+                   Point(4, 2), Point(2, 2), Point(2, 4), Point(0, 4)});
+  // inside, without touching the sides
+  ASSERT_TRUE(polygon.CrossSegment(Segment(Point(1, 1), Point(5, 1))));
+  ASSERT_TRUE(polygon.CrossSegment(Segment(Point(1, 1), Point(1, 1))));
+  // in the notch: through a side, along a side, outside
+  ASSERT_TRUE(polygon.CrossSegment(Segment(Point(3, 3), Point(5, 3))));
+  ASSERT_TRUE(polygon.CrossSegment(Segment(Point(2, 3), Point(2, 5))));
+  ASSERT_FALSE(polygon.CrossSegment(Segment(Point(3, 3), Point(3, 5))));
+  ASSERT_FALSE(polygon.CrossSegment(Segment(Point(-1, -1), Point(7, -1))));
+  ASSERT_TRUE(polygon.CrossSegment(Segment(Point(-1, 5), Point(7, -1))));
+}
+
+TEST(ConvexHull, Parts) {
+  std::mt19937_64 random(50);
+  std::uniform_int_distribution<int64_t> coord(-1000, 1000);
+  std::vector<Point> points;
+  for (size_t i = 0; i < 2 * kMinParallelHullPoints + 100; ++i) {
+    points.emplace_back(coord(random), coord(random));
+  }
+  // the corners and a point on a side of the square
+  points.emplace_back(-1001, -1001);
+  points.emplace_back(1001, -1001);
+  points.emplace_back(1001, 1001);
+  points.emplace_back(-1001, 1001);
+  points.emplace_back(0, 1001);
+  std::vector<Point> hull = ConvexHull(points, 1);
+  ASSERT_EQ(hull.size(), 4u);
+  ASSERT_EQ(hull[0].GetX(), -1001);
+  ASSERT_EQ(hull[0].GetY(), -1001);
+  ASSERT_EQ(hull[1].GetX(), 1001);
+  ASSERT_EQ(hull[1].GetY(), -1001);
+  for (size_t thread_count : {2, 3}) {
+    std::vector<Point> parts = ConvexHull(points, thread_count);
+    ASSERT_EQ(parts.size(), hull.size());
+    for (size_t i = 0; i < hull.size(); ++i) {
+      ASSERT_TRUE(parts[i].ContainsPoint(hull[i]));
+    }
+  }
+  ASSERT_TRUE(ConvexHull({}).empty());
+  ASSERT_EQ(ConvexHull({Point(1, 2), Point(1, 2)}).size(), 1u);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+// Выравнивание блока в куче (кэш-линия)
+static const size_t kMatrixAlignment = 64;
+
+// Аллокатор для std::vector, выравнивающий блок по kMatrixAlignment
+template <typename T>
+class AlignedAllocator {
+ public:
+  using value_type = T;
+
+  AlignedAllocator() = default;
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U>& /*other*/) {}
+
+  T* allocate(size_t count) {
+    return static_cast<T*>(::operator new(
+        count * sizeof(T), std::align_val_t(kMatrixAlignment)));
+  }
+
+  void deallocate(T* pointer, size_t /*count*/) {
+    ::operator delete(pointer, std::align_val_t(kMatrixAlignment));
+  }
+
+  template <typename U>
+  bool operator==(const AlignedAllocator<U>& /*other*/) const {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const AlignedAllocator<U>& /*other*/) const {
+    return false;
+  }
+};
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "aligned_allocator.hpp"
+#include "gemm.hpp"
+#include "matrix.hpp"
+#include "transpose.hpp"
+
+// Матрица с размерами, известными только во время выполнения.
+// Хранение и ядра те же, что у Matrix<N, M, T>: один выровненный блок
+// построчно, умножение через gemm::ParallelMultiply, поэлементные
+// операции через ForEachMatrixBlock. Несовпадение размеров
+// приводит к исключению std::invalid_argument.
+template <typename T = int64_t>
+class DynMatrix {
+ public:
+  // Пустая матрица 0 x 0
+  DynMatrix() = default;
+
+  // Матрица rows x cols, заполненная elem
+  DynMatrix(size_t rows, size_t cols, const T& elem = T())
+      : rows_(rows), cols_(cols), data_(rows * cols, elem) {}
+
+  // Матрица из std::vector<std::vector<T>>; все строки должны быть одной длины
+  DynMatrix(const std::vector<std::vector<T>>& init_vector)
+      : rows_(init_vector.size()),
+        cols_(init_vector.empty() ? 0 : init_vector[0].size()) {
+    data_.reserve(rows_ * cols_);
+    for (const std::vector<T>& row : init_vector) {
+      if (row.size() != cols_) {
+        throw std::invalid_argument("DynMatrix: rows have different lengths");
+      }
+      data_.insert(data_.end(), row.begin(), row.end());
+    }
+  }
+
+  // Копия статической матрицы
+  template <size_t N, size_t M>
+  DynMatrix(const Matrix<N, M, T>& matrix)
+      : rows_(N), cols_(M), data_(matrix.Data(), matrix.Data() + N * M) {}
+
+  // Забирает блок статической матрицы без копирования, если он в куче;
+  // маленькие матрицы, хранящиеся внутри объекта, копируются.
+  // matrix после этого можно только уничтожить или присвоить
+  template <size_t N, size_t M>
+  DynMatrix(Matrix<N, M, T>&& matrix) : rows_(N), cols_(M) {
+    Adopt(static_cast<MatrixBase<N, M, T>&>(matrix).data_);
+  }
+
+  // Копия в статическую матрицу; размеры должны совпадать
+  template <size_t N, size_t M>
+  Matrix<N, M, T> ToMatrix() const& {
+    CheckShape(N, M, "ToMatrix");
+    Matrix<N, M, T> result;
+    std::copy(data_.begin(), data_.end(), result.Data());
+    return result;
+  }
+
+  // Перенос в статическую матрицу без копирования (для матриц в куче);
+  // после этого *this - пустая матрица 0 x 0
+  template <size_t N, size_t M>
+  Matrix<N, M, T> ToMatrix() && {
+    CheckShape(N, M, "ToMatrix");
+    Matrix<N, M, T> result{EmptyStorageTag()};
+    Release(static_cast<MatrixBase<N, M, T>&>(result).data_);
+    rows_ = 0;
+    cols_ = 0;
+    Buffer().swap(data_);
+    return result;
+  }
+
+  size_t Rows() const { return rows_; }
+  size_t Cols() const { return cols_; }
+
+  // Указатель на первый элемент; элемент (i, j) лежит по смещению i * Cols() + j
+  T* Data() { return data_.data(); }
+  const T* Data() const { return data_.data(); }
+
+  // Оператор (i, j), возвращающий элемент матрицы в i-й строке и в j-м столбце.
+  T& operator()(size_t row, size_t col) { return data_[row * cols_ + col]; }
+  const T& operator()(size_t row, size_t col) const {
+    return data_[row * cols_ + col];
+  }
+
+  // Операторы +=
+  DynMatrix& operator+=(const DynMatrix& to_add) {
+    CheckShape(to_add.rows_, to_add.cols_, "operator+=");
+    T* data = Data();
+    const T* other = to_add.Data();
+    ForEachMatrixBlock(data_.size(), [data, other](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        data[i] += other[i];
+      }
+    });
+    return *this;
+  }
+
+  // Операторы -=
+  DynMatrix& operator-=(const DynMatrix& to_sub) {
+    CheckShape(to_sub.rows_, to_sub.cols_, "operator-=");
+    T* data = Data();
+    const T* other = to_sub.Data();
+    ForEachMatrixBlock(data_.size(), [data, other](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        data[i] -= other[i];
+      }
+    });
+    return *this;
+  }
+
+  // Умножение на элемент типа T
+  DynMatrix& operator*=(const T& factor) {
+    T* data = Data();
+    ForEachMatrixBlock(data_.size(), [data, &factor](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        data[i] *= factor;
+      }
+    });
+    return *this;
+  }
+
+  friend DynMatrix operator+(const DynMatrix& left, const DynMatrix& right) {
+    DynMatrix result(left);
+    result += right;
+    return result;
+  }
+
+  friend DynMatrix operator-(const DynMatrix& left, const DynMatrix& right) {
+    DynMatrix result(left);
+    result -= right;
+    return result;
+  }
+
+  friend DynMatrix operator*(const DynMatrix& matrix, const T& factor) {
+    DynMatrix result(matrix);
+    result *= factor;
+    return result;
+  }
+
+  friend DynMatrix operator*(const T& factor, const DynMatrix& matrix) {
+    DynMatrix result(matrix);
+    result *= factor;
+    return result;
+  }
+
+  // Умножение двух матриц; число столбцов левой должно совпадать
+  // с числом строк правой
+  DynMatrix operator*(const DynMatrix& factor) const {
+    return Multiply(factor, MatrixExecutor());
+  }
+
+  DynMatrix Multiply(const DynMatrix& factor, ThreadPool& pool) const {
+    if (cols_ != factor.rows_) {
+      throw std::invalid_argument("DynMatrix: cannot multiply " + Shape() +
+                                  " by " + factor.Shape());
+    }
+    DynMatrix result(rows_, factor.cols_);
+    gemm::ParallelMultiply(rows_, cols_, factor.cols_, Data(), cols_,
+                           factor.Data(), factor.cols_, result.Data(),
+                           factor.cols_, pool);
+    return result;
+  }
+
+  // Умножение на матрицу справа
+  DynMatrix& operator*=(const DynMatrix& factor) {
+    *this = *this * factor;
+    return *this;
+  }
+
+  // Транспонированная матрица
+  DynMatrix Transposed() const {
+    DynMatrix transposed(cols_, rows_);
+    if (data_.empty()) {
+      return transposed;
+    }
+    const T* data = Data();
+    T* result = transposed.Data();
+    size_t rows = rows_;
+    size_t cols = cols_;
+    // bands of whole source rows, each band is transposed by tiles
+    ForEachMatrixBlock(data_.size(), [=](size_t begin, size_t end) {
+      transpose::Transpose(end / cols - begin / cols, cols, data + begin, cols,
+                           result + begin / cols, rows);
+    }, cols);
+    return transposed;
+  }
+
+  // След; матрица должна быть квадратной
+  T Trace() const {
+    if (rows_ != cols_) {
+      throw std::invalid_argument("DynMatrix: trace of non-square " + Shape());
+    }
+    T result = T();
+    for (size_t i = 0; i < rows_; i++) {
+      result += (*this)(i, i);
+    }
+    return result;
+  }
+
+  // Оператор проверки на равенство (матрицы разных размеров не равны)
+  bool operator==(const DynMatrix& to_cmp) const {
+    return rows_ == to_cmp.rows_ && cols_ == to_cmp.cols_ &&
+           data_ == to_cmp.data_;
+  }
+
+  bool operator!=(const DynMatrix& to_cmp) const { return !(*this == to_cmp); }
+
+ private:
+  using Buffer = std::vector<T, AlignedAllocator<T>>;
+
+  std::string Shape() const {
+    return std::to_string(rows_) + "x" + std::to_string(cols_);
+  }
+
+  void CheckShape(size_t rows, size_t cols, const char* operation) const {
+    if (rows != rows_ || cols != cols_) {
+      throw std::invalid_argument(std::string("DynMatrix::") + operation +
+                                  ": shape " + Shape() + " does not match " +
+                                  std::to_string(rows) + "x" +
+                                  std::to_string(cols));
+    }
+  }
+
+  template <typename Storage>
+  void Adopt(Storage& storage) {
+    Adopt(storage, typename Storage::OnHeap());
+  }
+
+  template <typename Storage>
+  void Adopt(Storage& storage, std::true_type /*on_heap*/) {
+    data_.swap(storage.Buffer());
+  }
+
+  template <typename Storage>
+  void Adopt(Storage& storage, std::false_type /*on_heap*/) {
+    data_.assign(storage.Data(), storage.Data() + rows_ * cols_);
+  }
+
+  template <typename Storage>
+  void Release(Storage& storage) {
+    Release(storage, typename Storage::OnHeap());
+  }
+
+  template <typename Storage>
+  void Release(Storage& storage, std::true_type /*on_heap*/) {
+    storage.Buffer().swap(data_);
+  }
+
+  template <typename Storage>
+  void Release(Storage& storage, std::false_type /*on_heap*/) {
+    std::copy(data_.begin(), data_.end(), storage.Data());
+  }
+
+  size_t rows_ = 0;
+  size_t cols_ = 0;
+  Buffer data_;
+};
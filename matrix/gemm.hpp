@@ -0,0 +1,482 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "aligned_allocator.hpp"
+#include "thread_pool.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MATRIX_GEMM_X86 1
+#include <immintrin.h>
+#endif
+
+// Умножение матриц C += A * B, где A - rows x inner, B - inner x cols,
+// все матрицы хранятся построчно с шагами строк lda, ldb, ldc.
+//
+// Для арифметических типов используется схема BLIS: блок B размера
+// kInnerBlock x kColBlock и блок A размера kRowBlock x kInnerBlock
+// упаковываются в панели шириной kNr и kMr, после чего микроядро
+// считает плитку kMr x kNr целиком в регистрах. Для float, double и
+// int64_t на процессорах с AVX2/FMA микроядро векторное.
+//
+// Остальные (тяжелые) типы, например BigInt, умножаются без временных
+// произведений: каждое слагаемое добавляется хуком AddMul, а скалярные
+// произведения строк на столбцы считаются по Винограду за inner / 2
+// умножений вместо inner.
+//
+// Операнды A и B можно передать как Strided - тогда они читаются
+// с произвольными шагами, например транспонированными без копирования.
+namespace gemm {
+
+// размеры блоков в элементах: панель B держится в L3, панель A - в L2
+static const size_t kInnerBlock = 256;
+static const size_t kRowBlock = 96;
+static const size_t kColBlock = 1024;
+
+// меньше этого числа умножений упаковка не окупается
+static const size_t kPackedThreshold = 32 * 32 * 32;
+
+// с этого числа умножений результат считается плитками в нескольких потоках
+static const size_t kParallelThreshold = 128 * 128 * 128;
+static const size_t kParallelTileRows = kRowBlock;
+static const size_t kParallelTileCols = 256;
+
+// Размер плитки микроядра
+template <typename T>
+struct TileSize {
+  static const size_t kMr = 4;
+  static const size_t kNr = 4;
+};
+
+template <>
+struct TileSize<double> {
+  static const size_t kMr = 6;
+  static const size_t kNr = 8;
+};
+
+template <>
+struct TileSize<float> {
+  static const size_t kMr = 6;
+  static const size_t kNr = 16;
+};
+
+template <>
+struct TileSize<int64_t> {
+  static const size_t kMr = 4;
+  static const size_t kNr = 8;
+};
+
+// Операнд умножения: элемент (i, j) лежит по смещению
+// i * row_stride + j * col_stride. Построчный блок с шагом строки ld -
+// это {data, ld, 1}, он же транспонированный - {data, 1, ld}
+template <typename T>
+struct Strided {
+  const T* data;
+  size_t row_stride;
+  size_t col_stride;
+
+  const T& operator()(size_t row, size_t col) const {
+    return data[row * row_stride + col * col_stride];
+  }
+
+  // подблок, начинающийся с элемента (row, col)
+  Strided Block(size_t row, size_t col) const {
+    return {&(*this)(row, col), row_stride, col_stride};
+  }
+};
+
+// tile := сумма по p < inner внешних произведений столбцов панелей
+template <typename T>
+inline void ScalarKernel(size_t inner, const T* a_panel, const T* b_panel,
+                         T* tile) {
+  const size_t kMr = TileSize<T>::kMr;
+  const size_t kNr = TileSize<T>::kNr;
+  T acc[kMr * kNr] = {};
+  for (size_t p = 0; p < inner; p++) {
+    for (size_t r = 0; r < kMr; r++) {
+      T a_value = a_panel[p * kMr + r];
+      for (size_t c = 0; c < kNr; c++) {
+        acc[r * kNr + c] += a_value * b_panel[p * kNr + c];
+      }
+    }
+  }
+  std::copy(acc, acc + kMr * kNr, tile);
+}
+
+#ifdef MATRIX_GEMM_X86
+
+inline bool HasAvx2() {
+  static const bool kHasAvx2 =
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return kHasAvx2;
+}
+
+__attribute__((target("avx2,fma"))) inline void Avx2Kernel(
+    size_t inner, const double* a_panel, const double* b_panel,
+    double* tile) {
+  __m256d acc[6][2];
+#pragma GCC unroll 6
+  for (size_t r = 0; r < 6; r++) {
+    acc[r][0] = _mm256_setzero_pd();
+    acc[r][1] = _mm256_setzero_pd();
+  }
+  for (size_t p = 0; p < inner; p++) {
+    __m256d b_low = _mm256_loadu_pd(b_panel + p * 8);
+    __m256d b_high = _mm256_loadu_pd(b_panel + p * 8 + 4);
+#pragma GCC unroll 6
+    for (size_t r = 0; r < 6; r++) {
+      __m256d a_value = _mm256_broadcast_sd(a_panel + p * 6 + r);
+      acc[r][0] = _mm256_fmadd_pd(a_value, b_low, acc[r][0]);
+      acc[r][1] = _mm256_fmadd_pd(a_value, b_high, acc[r][1]);
+    }
+  }
+#pragma GCC unroll 6
+  for (size_t r = 0; r < 6; r++) {
+    _mm256_storeu_pd(tile + r * 8, acc[r][0]);
+    _mm256_storeu_pd(tile + r * 8 + 4, acc[r][1]);
+  }
+}
+
+__attribute__((target("avx2,fma"))) inline void Avx2Kernel(
+    size_t inner, const float* a_panel, const float* b_panel, float* tile) {
+  __m256 acc[6][2];
+#pragma GCC unroll 6
+  for (size_t r = 0; r < 6; r++) {
+    acc[r][0] = _mm256_setzero_ps();
+    acc[r][1] = _mm256_setzero_ps();
+  }
+  for (size_t p = 0; p < inner; p++) {
+    __m256 b_low = _mm256_loadu_ps(b_panel + p * 16);
+    __m256 b_high = _mm256_loadu_ps(b_panel + p * 16 + 8);
+#pragma GCC unroll 6
+    for (size_t r = 0; r < 6; r++) {
+      __m256 a_value = _mm256_broadcast_ss(a_panel + p * 6 + r);
+      acc[r][0] = _mm256_fmadd_ps(a_value, b_low, acc[r][0]);
+      acc[r][1] = _mm256_fmadd_ps(a_value, b_high, acc[r][1]);
+    }
+  }
+#pragma GCC unroll 6
+  for (size_t r = 0; r < 6; r++) {
+    _mm256_storeu_ps(tile + r * 16, acc[r][0]);
+    _mm256_storeu_ps(tile + r * 16 + 8, acc[r][1]);
+  }
+}
+
+// AVX2 has no 64-bit multiply, build it from 32-bit halves:
+// a * b mod 2^64 = lo(a) * lo(b) + ((lo(a) * hi(b) + hi(a) * lo(b)) << 32)
+__attribute__((target("avx2"))) inline __m256i Mul64(__m256i a, __m256i b) {
+  __m256i low_product = _mm256_mul_epu32(a, b);
+  __m256i cross = _mm256_mullo_epi32(a, _mm256_shuffle_epi32(b, 0xB1));
+  __m256i cross_sum = _mm256_add_epi32(cross, _mm256_srli_epi64(cross, 32));
+  return _mm256_add_epi64(low_product, _mm256_slli_epi64(cross_sum, 32));
+}
+
+__attribute__((target("avx2"))) inline void Avx2Kernel(size_t inner,
+                                                        const int64_t* a_panel,
+                                                        const int64_t* b_panel,
+                                                        int64_t* tile) {
+  __m256i acc[4][2];
+#pragma GCC unroll 6
+  for (size_t r = 0; r < 4; r++) {
+    acc[r][0] = _mm256_setzero_si256();
+    acc[r][1] = _mm256_setzero_si256();
+  }
+  for (size_t p = 0; p < inner; p++) {
+    __m256i b_low = _mm256_loadu_si256((const __m256i*)(b_panel + p * 8));
+    __m256i b_high = _mm256_loadu_si256((const __m256i*)(b_panel + p * 8 + 4));
+#pragma GCC unroll 6
+    for (size_t r = 0; r < 4; r++) {
+      __m256i a_value = _mm256_set1_epi64x(a_panel[p * 4 + r]);
+      acc[r][0] = _mm256_add_epi64(acc[r][0], Mul64(a_value, b_low));
+      acc[r][1] = _mm256_add_epi64(acc[r][1], Mul64(a_value, b_high));
+    }
+  }
+#pragma GCC unroll 6
+  for (size_t r = 0; r < 4; r++) {
+    _mm256_storeu_si256((__m256i*)(tile + r * 8), acc[r][0]);
+    _mm256_storeu_si256((__m256i*)(tile + r * 8 + 4), acc[r][1]);
+  }
+}
+
+inline void Kernel(size_t inner, const double* a_panel, const double* b_panel,
+                   double* tile) {
+  if (HasAvx2()) {
+    Avx2Kernel(inner, a_panel, b_panel, tile);
+  } else {
+    ScalarKernel(inner, a_panel, b_panel, tile);
+  }
+}
+
+inline void Kernel(size_t inner, const float* a_panel, const float* b_panel,
+                   float* tile) {
+  if (HasAvx2()) {
+    Avx2Kernel(inner, a_panel, b_panel, tile);
+  } else {
+    ScalarKernel(inner, a_panel, b_panel, tile);
+  }
+}
+
+inline void Kernel(size_t inner, const int64_t* a_panel,
+                   const int64_t* b_panel, int64_t* tile) {
+  if (HasAvx2()) {
+    Avx2Kernel(inner, a_panel, b_panel, tile);
+  } else {
+    ScalarKernel(inner, a_panel, b_panel, tile);
+  }
+}
+
+#endif
+
+template <typename T>
+inline void Kernel(size_t inner, const T* a_panel, const T* b_panel, T* tile) {
+  ScalarKernel(inner, a_panel, b_panel, tile);
+}
+
+// Копирует блок rows x inner матрицы A в панели по kMr строк:
+// в панели элементы одного столбца лежат подряд, недостающие строки - нули
+template <typename T>
+void PackA(size_t rows, size_t inner, Strided<T> a, T* packed) {
+  const size_t kMr = TileSize<T>::kMr;
+  for (size_t i = 0; i < rows; i += kMr) {
+    size_t panel_rows = std::min(kMr, rows - i);
+    for (size_t p = 0; p < inner; p++) {
+      for (size_t r = 0; r < kMr; r++) {
+        *packed++ = r < panel_rows ? a(i + r, p) : T();
+      }
+    }
+  }
+}
+
+// Копирует блок inner x cols матрицы B в панели по kNr столбцов
+template <typename T>
+void PackB(size_t inner, size_t cols, Strided<T> b, T* packed) {
+  const size_t kNr = TileSize<T>::kNr;
+  for (size_t j = 0; j < cols; j += kNr) {
+    size_t panel_cols = std::min(kNr, cols - j);
+    for (size_t p = 0; p < inner; p++) {
+      for (size_t c = 0; c < kNr; c++) {
+        *packed++ = c < panel_cols ? b(p, j + c) : T();
+      }
+    }
+  }
+}
+
+// Блок C[row_begin, row_end) x [0, cols) для обычного цикла i-k-j
+template <typename T>
+void RowLoop(size_t row_begin, size_t row_end, size_t inner, size_t cols,
+             Strided<T> a, Strided<T> b, T* c, size_t ldc) {
+  for (size_t i = row_begin; i < row_end; i++) {
+    T* c_row = c + i * ldc;
+    for (size_t p = 0; p < inner; p++) {
+      const T& a_value = a(i, p);
+      if (b.col_stride == 1) {
+        // contiguous rows of B, keep the inner loop vectorizable
+        const T* b_row = b.data + p * b.row_stride;
+        for (size_t j = 0; j < cols; j++) {
+          c_row[j] += a_value * b_row[j];
+        }
+      } else {
+        for (size_t j = 0; j < cols; j++) {
+          c_row[j] += a_value * b(p, j);
+        }
+      }
+    }
+  }
+}
+
+// acc += left * right. Тип может объявить рядом с собой перегрузку
+// AddMul(T&, const T&, const T&) без временного произведения, она
+// найдется поиском по аргументам
+template <typename T>
+inline void AddMul(T& acc, const T& left, const T& right) {
+  acc += left * right;
+}
+
+// Коммутативно ли умножение T. Произведение Винограда переставляет
+// множители; для некоммутативных T специализируйте как std::false_type
+template <typename T>
+struct CommutativeProduct : std::true_type {};
+
+// Цикл i-k-j для тяжелых T, произведения сразу добавляются в C
+template <typename T>
+void FusedRowLoop(size_t rows, size_t inner, size_t cols, Strided<T> a,
+                  Strided<T> b, T* c, size_t ldc) {
+  for (size_t i = 0; i < rows; i++) {
+    T* c_row = c + i * ldc;
+    for (size_t p = 0; p < inner; p++) {
+      const T& a_value = a(i, p);
+      for (size_t j = 0; j < cols; j++) {
+        AddMul(c_row[j], a_value, b(p, j));
+      }
+    }
+  }
+}
+
+// C += A * B по Винограду: для пар k = 2t, 2t + 1
+//   a(i, k) b(k, j) + a(i, k + 1) b(k + 1, j) =
+//   (a(i, k) + b(k + 1, j)) (a(i, k + 1) + b(k, j))
+//     - a(i, k) a(i, k + 1) - b(k, j) b(k + 1, j),
+// и вычитаемые зависят только от строки или только от столбца. Это
+// rows * cols * inner / 2 умножений плюс (rows + cols) * inner / 2
+// на множители строк и столбцов
+template <typename T>
+void Winograd(size_t rows, size_t inner, size_t cols, Strided<T> a,
+              Strided<T> b, T* c, size_t ldc) {
+  size_t pairs = inner / 2;
+  std::vector<T> row_factors(rows);
+  std::vector<T> col_factors(cols);
+  for (size_t i = 0; i < rows; i++) {
+    for (size_t t = 0; t < pairs; t++) {
+      AddMul(row_factors[i], a(i, 2 * t), a(i, 2 * t + 1));
+    }
+  }
+  for (size_t j = 0; j < cols; j++) {
+    for (size_t t = 0; t < pairs; t++) {
+      AddMul(col_factors[j], b(2 * t, j), b(2 * t + 1, j));
+    }
+  }
+  // sums are built in place, their buffers are reused between steps
+  T left;
+  T right;
+  for (size_t i = 0; i < rows; i++) {
+    T* c_row = c + i * ldc;
+    for (size_t j = 0; j < cols; j++) {
+      T& acc = c_row[j];
+      acc -= row_factors[i];
+      acc -= col_factors[j];
+      for (size_t t = 0; t < pairs; t++) {
+        left = a(i, 2 * t);
+        left += b(2 * t + 1, j);
+        right = a(i, 2 * t + 1);
+        right += b(2 * t, j);
+        AddMul(acc, left, right);
+      }
+      if (inner % 2 == 1) {
+        AddMul(acc, a(i, inner - 1), b(inner - 1, j));
+      }
+    }
+  }
+}
+
+template <typename T>
+void HeavyMultiply(size_t rows, size_t inner, size_t cols, Strided<T> a,
+                   Strided<T> b, T* c, size_t ldc,
+                   std::true_type /*commutative*/) {
+  // a single row or column does not amortize its factors
+  if (rows < 2 || cols < 2 || inner < 2) {
+    FusedRowLoop(rows, inner, cols, a, b, c, ldc);
+  } else {
+    Winograd(rows, inner, cols, a, b, c, ldc);
+  }
+}
+
+template <typename T>
+void HeavyMultiply(size_t rows, size_t inner, size_t cols, Strided<T> a,
+                   Strided<T> b, T* c, size_t ldc,
+                   std::false_type /*commutative*/) {
+  FusedRowLoop(rows, inner, cols, a, b, c, ldc);
+}
+
+template <typename T>
+void Packed(size_t rows, size_t inner, size_t cols, Strided<T> a,
+            Strided<T> b, T* c, size_t ldc) {
+  const size_t kMr = TileSize<T>::kMr;
+  const size_t kNr = TileSize<T>::kNr;
+  size_t max_rows = (std::min(kRowBlock, rows) + kMr - 1) / kMr * kMr;
+  size_t max_inner = std::min(kInnerBlock, inner);
+  size_t max_cols = (std::min(kColBlock, cols) + kNr - 1) / kNr * kNr;
+  std::vector<T, AlignedAllocator<T>> a_packed(max_rows * max_inner);
+  std::vector<T, AlignedAllocator<T>> b_packed(max_inner * max_cols);
+  T tile[kMr * kNr];
+
+  for (size_t jc = 0; jc < cols; jc += kColBlock) {
+    size_t col_count = std::min(kColBlock, cols - jc);
+    for (size_t pc = 0; pc < inner; pc += kInnerBlock) {
+      size_t inner_count = std::min(kInnerBlock, inner - pc);
+      PackB(inner_count, col_count, b.Block(pc, jc), b_packed.data());
+      for (size_t ic = 0; ic < rows; ic += kRowBlock) {
+        size_t row_count = std::min(kRowBlock, rows - ic);
+        PackA(row_count, inner_count, a.Block(ic, pc), a_packed.data());
+        for (size_t jr = 0; jr < col_count; jr += kNr) {
+          size_t tile_cols = std::min(kNr, col_count - jr);
+          for (size_t ir = 0; ir < row_count; ir += kMr) {
+            size_t tile_rows = std::min(kMr, row_count - ir);
+            Kernel(inner_count, a_packed.data() + ir * inner_count,
+                   b_packed.data() + jr * inner_count, tile);
+            T* c_tile = c + (ic + ir) * ldc + jc + jr;
+            for (size_t r = 0; r < tile_rows; r++) {
+              for (size_t col = 0; col < tile_cols; col++) {
+                c_tile[r * ldc + col] += tile[r * kNr + col];
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename T>
+void Multiply(size_t rows, size_t inner, size_t cols, Strided<T> a,
+              Strided<T> b, T* c, size_t ldc, std::true_type /*is_arithmetic*/) {
+  if (rows * inner * cols < kPackedThreshold) {
+    RowLoop(0, rows, inner, cols, a, b, c, ldc);
+  } else {
+    Packed(rows, inner, cols, a, b, c, ldc);
+  }
+}
+
+template <typename T>
+void Multiply(size_t rows, size_t inner, size_t cols, Strided<T> a,
+              Strided<T> b, T* c, size_t ldc,
+              std::false_type /*is_arithmetic*/) {
+  HeavyMultiply(rows, inner, cols, a, b, c, ldc, CommutativeProduct<T>());
+}
+
+// C += A * B
+template <typename T>
+void Multiply(size_t rows, size_t inner, size_t cols, Strided<T> a,
+              Strided<T> b, T* c, size_t ldc) {
+  Multiply(rows, inner, cols, a, b, c, ldc, std::is_arithmetic<T>());
+}
+
+template <typename T>
+void Multiply(size_t rows, size_t inner, size_t cols, const T* a, size_t lda,
+              const T* b, size_t ldb, T* c, size_t ldc) {
+  Multiply(rows, inner, cols, Strided<T>{a, lda, 1}, Strided<T>{b, ldb, 1}, c,
+           ldc);
+}
+
+// C += A * B, плитки C размера kParallelTileRows x kParallelTileCols
+// считаются независимо в потоках pool
+template <typename T>
+void ParallelMultiply(size_t rows, size_t inner, size_t cols, Strided<T> a,
+                      Strided<T> b, T* c, size_t ldc, ThreadPool& pool) {
+  if (pool.ThreadCount() == 1 || rows * inner * cols < kParallelThreshold) {
+    Multiply(rows, inner, cols, a, b, c, ldc);
+    return;
+  }
+  size_t row_tiles = (rows + kParallelTileRows - 1) / kParallelTileRows;
+  size_t col_tiles = (cols + kParallelTileCols - 1) / kParallelTileCols;
+  pool.ParallelFor(row_tiles * col_tiles, [&](size_t tile) {
+    size_t row = tile / col_tiles * kParallelTileRows;
+    size_t col = tile % col_tiles * kParallelTileCols;
+    Multiply(std::min(kParallelTileRows, rows - row), inner,
+             std::min(kParallelTileCols, cols - col), a.Block(row, 0),
+             b.Block(0, col), c + row * ldc + col, ldc);
+  });
+}
+
+template <typename T>
+void ParallelMultiply(size_t rows, size_t inner, size_t cols, const T* a,
+                      size_t lda, const T* b, size_t ldb, T* c, size_t ldc,
+                      ThreadPool& pool) {
+  ParallelMultiply(rows, inner, cols, Strided<T>{a, lda, 1},
+                   Strided<T>{b, ldb, 1}, c, ldc, pool);
+}
+
+}  // namespace gemm
@@ -0,0 +1,347 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include "aligned_allocator.hpp"
+#include "gemm.hpp"
+#include "thread_pool.hpp"
+
+// Разложения квадратных матриц n x n, хранящихся построчно с шагом lda.
+//
+// LU с частичным выбором ведущего элемента считается блоками по
+// kPanelWidth столбцов: панель раскладывается обычным алгоритмом,
+// остаток матрицы обновляется одним умножением через gemm. Матрицы
+// до kMaxUnrolledSize раскладываются тем же ядром, но с размером,
+// известным при компиляции, и его циклы разворачиваются полностью.
+//
+// Для точных типов (целые, BigInt) определитель считается методом
+// Барейса без дробей: все промежуточные значения - миноры исходной
+// матрицы, деления нацело.
+namespace linalg {
+
+static const size_t kPanelWidth = 32;
+static const size_t kMaxUnrolledSize = 8;
+
+// Результат LU: a := L \ U, строка k переставлена со строкой pivots[k]
+struct LuInfo {
+  int sign = 1;          // знак перестановки строк
+  bool singular = false;  // встретился нулевой ведущий элемент
+};
+
+// Шаг k неблочного LU: выбор ведущего элемента в столбце k, перестановка
+// строк целиком (на ширину n) и исключение в столбцах (k, end)
+template <typename T>
+__attribute__((always_inline)) inline void LuStep(size_t n, size_t k,
+                                                  size_t end, T* a,
+                                                  size_t lda, size_t* pivots,
+                                                  LuInfo& info) {
+  size_t pivot = k;
+  for (size_t i = k + 1; i < n; i++) {
+    if (std::abs(a[i * lda + k]) > std::abs(a[pivot * lda + k])) {
+      pivot = i;
+    }
+  }
+  pivots[k] = pivot;
+  if (a[pivot * lda + k] == T()) {
+    info.singular = true;
+    return;
+  }
+  if (pivot != k) {
+    std::swap_ranges(a + k * lda, a + k * lda + n, a + pivot * lda);
+    info.sign = -info.sign;
+  }
+  const T* pivot_row = a + k * lda;
+  for (size_t i = k + 1; i < n; i++) {
+    T* row = a + i * lda;
+    T factor = row[k] / pivot_row[k];
+    row[k] = factor;
+    for (size_t j = k + 1; j < end; j++) {
+      row[j] -= factor * pivot_row[j];
+    }
+  }
+}
+
+// Неблочное LU столбцов [begin, end) блока из n строк
+template <typename T>
+void PanelLU(size_t n, size_t begin, size_t end, T* a, size_t lda,
+             size_t* pivots, LuInfo& info) {
+  for (size_t k = begin; k < end; k++) {
+    LuStep(n, k, end, a, lda, pivots, info);
+  }
+}
+
+// LU матрицы N x N начиная с шага K: шаги разворачиваются рекурсией
+// шаблона, и все границы циклов в них известны при компиляции
+template <size_t N, size_t K>
+struct UnrolledLU {
+  template <typename T>
+  static void Run(T* a, size_t* pivots, LuInfo& info) {
+    LuStep(N, K, N, a, N, pivots, info);
+    UnrolledLU<N, K + 1>::Run(a, pivots, info);
+  }
+};
+
+template <size_t N>
+struct UnrolledLU<N, N> {
+  template <typename T>
+  static void Run(T* /*a*/, size_t* /*pivots*/, LuInfo& /*info*/) {}
+};
+
+// Блочное LU матрицы n x n
+template <typename T>
+LuInfo BlockedLU(size_t n, T* a, size_t lda, size_t* pivots,
+                 ThreadPool& pool) {
+  LuInfo info;
+  std::vector<T, AlignedAllocator<T>> panel;
+  for (size_t begin = 0; begin < n; begin += kPanelWidth) {
+    size_t end = std::min(n, begin + kPanelWidth);
+    size_t width = end - begin;
+    PanelLU(n, begin, end, a, lda, pivots, info);
+    if (end == n) {
+      break;
+    }
+    // U12 := L11^-1 * A12
+    for (size_t i = begin + 1; i < end; i++) {
+      T* row = a + i * lda;
+      for (size_t k = begin; k < i; k++) {
+        const T* u_row = a + k * lda;
+        for (size_t j = end; j < n; j++) {
+          row[j] -= row[k] * u_row[j];
+        }
+      }
+    }
+    // A22 -= L21 * U12, gemm only adds, so L21 is copied negated
+    size_t rest = n - end;
+    panel.resize(rest * width);
+    for (size_t i = 0; i < rest; i++) {
+      const T* l_row = a + (end + i) * lda + begin;
+      for (size_t k = 0; k < width; k++) {
+        panel[i * width + k] = -l_row[k];
+      }
+    }
+    gemm::ParallelMultiply(rest, width, rest, panel.data(), width,
+                           a + begin * lda + end, lda, a + end * lda + end,
+                           lda, pool);
+  }
+  return info;
+}
+
+// LU матрицы N x N с N, известным при компиляции
+template <size_t N, typename T>
+LuInfo LU(T* a, size_t* pivots, ThreadPool& /*pool*/,
+          std::true_type /*unrolled*/) {
+  LuInfo info;
+  UnrolledLU<N, 0>::Run(a, pivots, info);
+  return info;
+}
+
+template <size_t N, typename T>
+LuInfo LU(T* a, size_t* pivots, ThreadPool& pool,
+          std::false_type /*unrolled*/) {
+  return BlockedLU(N, a, N, pivots, pool);
+}
+
+template <size_t N, typename T>
+LuInfo LU(T* a, size_t* pivots, ThreadPool& pool) {
+  return LU<N>(a, pivots, pool,
+               std::integral_constant<bool, N <= kMaxUnrolledSize>());
+}
+
+// Решает A X = B по разложению LU матрицы A; B (n x cols, шаг ldb)
+// заменяется на X
+template <typename T>
+void LuSolve(size_t n, const T* lu, size_t lda, const size_t* pivots,
+             size_t cols, T* b, size_t ldb) {
+  for (size_t k = 0; k < n; k++) {
+    if (pivots[k] != k) {
+      std::swap_ranges(b + k * ldb, b + k * ldb + cols, b + pivots[k] * ldb);
+    }
+  }
+  // L Y = P B, L has a unit diagonal
+  for (size_t i = 1; i < n; i++) {
+    T* row = b + i * ldb;
+    for (size_t k = 0; k < i; k++) {
+      T factor = lu[i * lda + k];
+      const T* y_row = b + k * ldb;
+      for (size_t j = 0; j < cols; j++) {
+        row[j] -= factor * y_row[j];
+      }
+    }
+  }
+  // U X = Y
+  for (size_t i = n; i-- > 0;) {
+    T* row = b + i * ldb;
+    for (size_t k = i + 1; k < n; k++) {
+      T factor = lu[i * lda + k];
+      const T* x_row = b + k * ldb;
+      for (size_t j = 0; j < cols; j++) {
+        row[j] -= factor * x_row[j];
+      }
+    }
+    T diagonal = lu[i * lda + i];
+    for (size_t j = 0; j < cols; j++) {
+      row[j] /= diagonal;
+    }
+  }
+}
+
+// Разложение Холецкого A = L L^T на месте: a := L, выше диагонали нули.
+// false, если матрица не положительно определена
+template <typename T>
+bool Cholesky(size_t n, T* a, size_t lda) {
+  for (size_t i = 0; i < n; i++) {
+    T* row = a + i * lda;
+    for (size_t j = 0; j <= i; j++) {
+      const T* l_row = a + j * lda;
+      T sum = row[j];
+      for (size_t k = 0; k < j; k++) {
+        sum -= row[k] * l_row[k];
+      }
+      if (j < i) {
+        row[j] = sum / l_row[j];
+      } else if (sum > T()) {
+        row[i] = std::sqrt(sum);
+      } else {
+        return false;
+      }
+    }
+    std::fill(row + i + 1, row + n, T());
+  }
+  return true;
+}
+
+// Решает L L^T X = B по разложению Холецкого; B заменяется на X
+template <typename T>
+void CholeskySolve(size_t n, const T* l, size_t lda, size_t cols, T* b,
+                   size_t ldb) {
+  // L Y = B
+  for (size_t i = 0; i < n; i++) {
+    T* row = b + i * ldb;
+    for (size_t k = 0; k < i; k++) {
+      T factor = l[i * lda + k];
+      const T* y_row = b + k * ldb;
+      for (size_t j = 0; j < cols; j++) {
+        row[j] -= factor * y_row[j];
+      }
+    }
+    T diagonal = l[i * lda + i];
+    for (size_t j = 0; j < cols; j++) {
+      row[j] /= diagonal;
+    }
+  }
+  // L^T X = Y, row i of X is final once it is divided by l(i, i)
+  for (size_t i = n; i-- > 0;) {
+    T* row = b + i * ldb;
+    T diagonal = l[i * lda + i];
+    for (size_t j = 0; j < cols; j++) {
+      row[j] /= diagonal;
+    }
+    for (size_t k = 0; k < i; k++) {
+      T factor = l[i * lda + k];
+      T* x_row = b + k * ldb;
+      for (size_t j = 0; j < cols; j++) {
+        x_row[j] -= factor * row[j];
+      }
+    }
+  }
+}
+
+// Состояние метода Барейса после нескольких шагов
+template <typename T>
+struct BareissState {
+  T previous = T(1);     // ведущий элемент предыдущего шага
+  bool negate = false;   // нечетное число перестановок строк
+  bool zero = false;     // определитель заведомо равен нулю
+};
+
+// Шаг k метода Барейса для матрицы n x n: после него a(i, j) для i, j > k -
+// миноры порядка k + 2 исходной матрицы, все деления нацело. Последний
+// шаг только проверяет, что a(n - 1, n - 1) не ноль
+template <typename T>
+__attribute__((always_inline)) inline void BareissStep(size_t n, size_t k,
+                                                       T* a, size_t lda,
+                                                       BareissState<T>& state) {
+  if (state.zero) {
+    return;
+  }
+  if (a[k * lda + k] == T()) {
+    size_t pivot = k + 1;
+    while (pivot < n && a[pivot * lda + k] == T()) {
+      pivot++;
+    }
+    if (pivot == n) {
+      state.zero = true;
+      return;
+    }
+    std::swap_ranges(a + k * lda + k, a + k * lda + n, a + pivot * lda + k);
+    state.negate = !state.negate;
+  }
+  const T* pivot_row = a + k * lda;
+  for (size_t i = k + 1; i < n; i++) {
+    T* row = a + i * lda;
+    for (size_t j = k + 1; j < n; j++) {
+      row[j] = (row[j] * pivot_row[k] - row[k] * pivot_row[j]) / state.previous;
+    }
+  }
+  state.previous = pivot_row[k];
+}
+
+template <typename T>
+T BareissResult(size_t n, const T* a, size_t lda,
+                const BareissState<T>& state) {
+  if (state.zero) {
+    return T();
+  }
+  const T& last = a[(n - 1) * lda + n - 1];
+  return state.negate ? -last : last;
+}
+
+// Определитель методом Барейса; a портится
+template <typename T>
+T Bareiss(size_t n, T* a, size_t lda) {
+  BareissState<T> state;
+  for (size_t k = 0; k < n; k++) {
+    BareissStep(n, k, a, lda, state);
+  }
+  return BareissResult(n, a, lda, state);
+}
+
+// Шаги K, K + 1, ... метода Барейса для матрицы N x N, развернутые
+template <size_t N, size_t K>
+struct UnrolledBareiss {
+  template <typename T>
+  static void Run(T* a, BareissState<T>& state) {
+    BareissStep(N, K, a, N, state);
+    UnrolledBareiss<N, K + 1>::Run(a, state);
+  }
+};
+
+template <size_t N>
+struct UnrolledBareiss<N, N> {
+  template <typename T>
+  static void Run(T* /*a*/, BareissState<T>& /*state*/) {}
+};
+
+template <size_t N, typename T>
+T Bareiss(T* a, std::true_type /*unrolled*/) {
+  BareissState<T> state;
+  UnrolledBareiss<N, 0>::Run(a, state);
+  return BareissResult(N, a, N, state);
+}
+
+template <size_t N, typename T>
+T Bareiss(T* a, std::false_type /*unrolled*/) {
+  return Bareiss(N, a, N);
+}
+
+// Определитель матрицы N x N методом Барейса; a портится
+template <size_t N, typename T>
+T Bareiss(T* a) {
+  return Bareiss<N>(a, std::integral_constant<bool, N <= kMaxUnrolledSize>());
+}
+
+}  // namespace linalg
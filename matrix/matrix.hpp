@@ -1,39 +1,134 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
 #include <vector>
 
+#include "aligned_allocator.hpp"
+#include "gemm.hpp"
+#include "linalg.hpp"
+#include "matrix_expr.hpp"
+#include "strassen.hpp"
+#include "thread_pool.hpp"
+#include "transpose.hpp"
+#include "unrolled.hpp"
+
 template <size_t N, size_t M, typename T = int64_t>
-class Matrix {
+class Matrix;
+
+// Матрицы, занимающие не больше kMaxInlineMatrixBytes, хранятся
+// прямо в объекте, остальные - в одном выровненном блоке в куче.
+static const size_t kMaxInlineMatrixBytes = 1 << 12;
+
+// Поэлементные операции над матрицами от kParallelElementThreshold
+// элементов выполняются в пуле потоков блоками по kParallelElementBlock
+static const size_t kParallelElementThreshold = 1 << 16;
+static const size_t kParallelElementBlock = 1 << 14;
+
+inline std::atomic<ThreadPool*>& MatrixExecutorSlot() {
+  static std::atomic<ThreadPool*> pool(nullptr);
+  return pool;
+}
+
+// Пул потоков, в котором выполняются операции над большими матрицами.
+// По умолчанию - ThreadPool::Default() на все аппаратные потоки
+inline ThreadPool& MatrixExecutor() {
+  ThreadPool* pool = MatrixExecutorSlot().load(std::memory_order_acquire);
+  return pool == nullptr ? ThreadPool::Default() : *pool;
+}
+
+// Задает пул для операций над матрицами (nullptr - пул по умолчанию).
+// Например, ThreadPool(1) делает все операции однопоточными
+inline void SetMatrixExecutor(ThreadPool* pool) {
+  MatrixExecutorSlot().store(pool, std::memory_order_release);
+}
+
+// Вызывает apply(begin, end) на отрезках [0, size), кратных granularity.
+// Для больших матриц отрезки обрабатываются в MatrixExecutor()
+template <typename Apply>
+void ForEachMatrixBlock(size_t size, const Apply& apply,
+                        size_t granularity = 1) {
+  if (size < kParallelElementThreshold) {
+    apply(0, size);
+    return;
+  }
+  size_t block =
+      (kParallelElementBlock + granularity - 1) / granularity * granularity;
+  MatrixExecutor().ParallelFor((size + block - 1) / block,
+                               [&apply, block, size](size_t index) {
+                                 size_t begin = index * block;
+                                 apply(begin, std::min(size, begin + block));
+                               });
+}
+
+// Создает хранилище без блока в куче; блок затем передается из DynMatrix
+struct EmptyStorageTag {};
+
+// Непрерывное хранилище Size элементов.
+// Маленькие матрицы лежат в std::array и не обращаются к аллокатору.
+template <typename T, size_t Size,
+          bool kOnHeap = (Size * sizeof(T) > kMaxInlineMatrixBytes)>
+class MatrixStorage {
+ public:
+  MatrixStorage() : data_() {}
+  explicit MatrixStorage(const T& elem) { data_.fill(elem); }
+  explicit MatrixStorage(EmptyStorageTag /*tag*/) : data_() {}
+
+  T* Data() { return data_.data(); }
+  const T* Data() const { return data_.data(); }
+
+  using OnHeap = std::false_type;
+
+ private:
+  std::array<T, Size> data_;
+};
+
+template <typename T, size_t Size>
+class MatrixStorage<T, Size, true> {
+ public:
+  MatrixStorage() : data_(Size) {}
+  explicit MatrixStorage(const T& elem) : data_(Size, elem) {}
+  explicit MatrixStorage(EmptyStorageTag /*tag*/) {}
+
+  T* Data() { return data_.data(); }
+  const T* Data() const { return data_.data(); }
+
+  using OnHeap = std::true_type;
+
+  // блок в куче, его можно забрать без копирования (см. DynMatrix)
+  std::vector<T, AlignedAllocator<T>>& Buffer() { return data_; }
+
+ private:
+  std::vector<T, AlignedAllocator<T>> data_;
+};
+
+// Общая часть прямоугольных и квадратных матриц.
+// Элементы хранятся построчно (row-major) в одном непрерывном блоке.
+// Сама матрица - лист выражения, см. matrix_expr.hpp
+template <size_t N, size_t M, typename T>
+class MatrixBase : public MatrixExpr<N, M, T, Matrix<N, M, T>> {
  public:
   // Конструктор по умолчанию заполняет матрицу T().
-  Matrix() {
-    this->data_.resize(N);
-    for (std::vector<T>& row : this->data_) {
-      row.resize(M);
-    }
-  }
+  MatrixBase() = default;
 
   // Конструктор от std::vector<std::vector<T>>,
   // заполняющий матрицу элементами вектора.
   // Гарантируется, что размеры вектора будут
   // совпадать с размерами в шаблонах.
-  Matrix(const std::vector<std::vector<T>>& init_vector) {
-    this->data_.resize(N);
+  MatrixBase(const std::vector<std::vector<T>>& init_vector) {
     for (size_t i = 0; i < N; i++) {
-      this->data_[i] = init_vector[i];
+      std::copy(init_vector[i].begin(), init_vector[i].begin() + M,
+                Data() + i * M);
     }
   }
 
   // Конструктор от T elem. Заполняет всю матрицу elem.
-  Matrix(const T& elem) {
-    this->data_.resize(N);
-    for (std::vector<T>& row : this->data_) {
-      row.resize(M, elem);
-    }
-  }
-
-  ~Matrix() {}
+  MatrixBase(const T& elem) : data_(elem) {}
 
   /*
    * Сложение, вычитание, операторы +=, -=.
@@ -43,65 +138,60 @@ class Matrix {
    * будут поддерживать соответствующие операции.
    */
 
-  // Операторы +=
-  Matrix& operator+=(const Matrix& to_add) {
-    for (size_t i = 0; i < N; i++) {
-      for (size_t j = 0; j < M; j++) {
-        this->data_[i][j] += to_add.data_[i][j];
-      }
-    }
-    return *this;
-  }
-
-  // Сложение
-  Matrix operator+(const Matrix& to_add) const {
-    Matrix result(this->data_);
-    result += to_add;
-    return result;
+  // Матрица из поэлементного выражения, элементы считаются за один проход
+  template <typename E>
+  MatrixBase(const MatrixExpr<N, M, T, E>& expr) {
+    *this = expr;
   }
 
-  // Операторы -=
-  Matrix operator-(const Matrix& to_sub) const {
-    Matrix result(this->data_);
-    result -= to_sub;
-    return result;
+  // Присваивание выражения, память не выделяется
+  template <typename E>
+  Matrix<N, M, T>& operator=(const MatrixExpr<N, M, T, E>& expr) {
+    typename ExprReader<E>::Type source(expr.Expression());
+    if (source.Permutes(Data())) {
+      return Self() = Matrix<N, M, T>(expr);
+    }
+    T* data = Data();
+    ForEachElement(
+        [data, &source](size_t i) { data[i] = source.At(i); });
+    return Self();
   }
 
-  // Вычитание
-  Matrix& operator-=(const Matrix& to_sub) {
-    for (size_t i = 0; i < N; i++) {
-      for (size_t j = 0; j < M; j++) {
-        this->data_[i][j] -= to_sub.data_[i][j];
-      }
+  // Операторы +=
+  template <typename E>
+  Matrix<N, M, T>& operator+=(const MatrixExpr<N, M, T, E>& to_add) {
+    typename ExprReader<E>::Type source(to_add.Expression());
+    if (source.Permutes(Data())) {
+      return Self() += Matrix<N, M, T>(to_add);
     }
-    return *this;
+    T* data = Data();
+    ForEachElement(
+        [data, &source](size_t i) { data[i] += source.At(i); });
+    return Self();
   }
 
-  // Умножение на элемент типа T
-  // (гарантируется, что оператор * определен для T)
-  Matrix& operator*=(const T& factor) {
-    for (std::vector<T>& row : this->data_) {
-      for (T& element : row) {
-        element *= factor;
-      }
+  // Операторы -=
+  template <typename E>
+  Matrix<N, M, T>& operator-=(const MatrixExpr<N, M, T, E>& to_sub) {
+    typename ExprReader<E>::Type source(to_sub.Expression());
+    if (source.Permutes(Data())) {
+      return Self() -= Matrix<N, M, T>(to_sub);
     }
-    return *this;
+    T* data = Data();
+    ForEachElement(
+        [data, &source](size_t i) { data[i] -= source.At(i); });
+    return Self();
   }
 
-  // Умножение на элемент типа T
-  // (гарантируется, что оператор * определен для T)
-  friend Matrix operator*(const Matrix& matrix, const T& factor) {
-    Matrix result(matrix.data_);
-    result *= factor;
-    return result;
-  }
+  // Сложение, вычитание и умножение на число
+  // возвращают ленивые выражения, см. matrix_expr.hpp
 
   // Умножение на элемент типа T
   // (гарантируется, что оператор * определен для T)
-  friend Matrix operator*(const T& factor, const Matrix& matrix) {
-    Matrix result(matrix.data_);
-    result *= factor;
-    return result;
+  Matrix<N, M, T>& operator*=(const T& factor) {
+    T* data = Data();
+    ForEachElement([data, &factor](size_t i) { data[i] *= factor; });
+    return Self();
   }
 
   // Умножение двух матриц.
@@ -109,219 +199,281 @@ class Matrix {
   // должна приводить к ошибке компиляции.
   template <size_t K>
   Matrix<N, K, T> operator*(const Matrix<M, K, T>& factor) const {
-    Matrix<N, K, T> result;
-    for (size_t i = 0; i < N; i++) {
-      for (size_t j = 0; j < K; j++) {
-        for (size_t it = 0; it < M; it++) {
-          result(i, j) += this->data_[i][it] * factor(it, j);
-        }
-      }
-    }
-    return result;
+    return Multiply(factor, MatrixExecutor());
   }
 
+  // Умножение двух матриц с явно заданным пулом потоков
   template <size_t K>
-  Matrix operator*=(const Matrix<M, K, T>& factor) {
-    Matrix result = *this * factor;
-
-    this->data_.resize(N);
-    for (size_t i = 0; i < N; i++) {
-      this->data_[i] = result[i];
-    }
+  Matrix<N, K, T> Multiply(const Matrix<M, K, T>& factor,
+                           ThreadPool& pool) const {
+    Matrix<N, K, T> result;
+    MultiplyInto(factor, result, pool, unrolled::Fits<N, M, K>());
+    return result;
+  }
 
-    return *this;
+  // Умножение на матрицу справа, размер при этом не меняется
+  Matrix<N, M, T>& operator*=(const Matrix<M, M, T>& factor) {
+    Self() = *this * factor;
+    return Self();
   }
 
   // Метод Transposed(), возвращающий транспонированную матрицу.
   Matrix<M, N, T> Transposed() const {
     Matrix<M, N, T> transposed;
-    for (size_t i = 0; i < N; i++) {
-      for (size_t j = 0; j < M; j++) {
-        transposed(j, i) = this->data_[i][j];
-      }
-    }
+    TransposeInto(transposed.Data(), unrolled::Fits<N, M>());
     return transposed;
   }
 
+  // Транспонированная матрица без копирования: лист выражения,
+  // который можно умножать и складывать, пока жива эта матрица
+  TransposedRef<M, N, T> TransposedView() const {
+    return TransposedRef<M, N, T>(Self());
+  }
+
   // Оператор (i, j), возвращающий элемент матрицы в i-й строке и в j-м столбце.
   // Необходимо уметь менять значение для неконстантных матриц.
-  T& operator()(size_t row, size_t col) { return this->data_[row][col]; }
+  T& operator()(size_t row, size_t col) { return Data()[row * M + col]; }
   const T& operator()(size_t row, size_t col) const {
-    return this->data_[row][col];
+    return Data()[row * M + col];
   }
 
-  // Оператор проверки на равенство.
-  bool operator==(const Matrix& to_cmp) const {
-    return this->data_ == to_cmp.data_;
-  }
+  // Указатель на первый элемент; элемент (i, j) лежит по смещению i * M + j
+  T* Data() { return data_.Data(); }
+  const T* Data() const { return data_.Data(); }
 
  private:
-  std::vector<std::vector<T>> data_;
-};
+  template <typename U>
+  friend class DynMatrix;
 
-template <size_t N, typename T>
-class Matrix<N, N, T> {
- public:
-  // Конструктор по умолчанию заполняет матрицу T().
-  Matrix() {
-    this->data_.resize(N);
-    for (std::vector<T>& row : this->data_) {
-      row.resize(N);
-    }
-  }
+  explicit MatrixBase(EmptyStorageTag tag) : data_(tag) {}
 
-  // Конструктор от std::vector<std::vector<T>>,
-  // заполняющий матрицу элементами вектора.
-  // Гарантируется, что размеры вектора будут
-  // совпадать с размерами в шаблонах.
-  Matrix(const std::vector<std::vector<T>>& init_vector) {
-    this->data_.resize(N);
-    for (size_t i = 0; i < N; i++) {
-      this->data_[i] = init_vector[i];
-    }
+  template <size_t K>
+  void MultiplyInto(const Matrix<M, K, T>& factor, Matrix<N, K, T>& result,
+                    ThreadPool& /*pool*/, std::true_type /*unrolled*/) const {
+    unrolled::Multiply<N, M, K>(Data(), factor.Data(), result.Data());
   }
 
-  // Конструктор от T elem. Заполняет всю матрицу elem.
-  Matrix(const T& elem) {
-    this->data_.resize(N);
-    for (std::vector<T>& row : this->data_) {
-      row.resize(N, elem);
-    }
+  template <size_t K>
+  void MultiplyInto(const Matrix<M, K, T>& factor, Matrix<N, K, T>& result,
+                    ThreadPool& pool, std::false_type /*unrolled*/) const {
+    // large square products of exact types go through Strassen-Winograd
+    MultiplyLarge(factor, result, pool,
+                  std::integral_constant<bool, N == M && M == K &&
+                                                   gemm::UseStrassen<N, T>::value>());
   }
 
-  ~Matrix() {}
+  template <size_t K>
+  void MultiplyLarge(const Matrix<M, K, T>& factor, Matrix<N, K, T>& result,
+                     ThreadPool& pool, std::false_type /*use_strassen*/) const {
+    gemm::ParallelMultiply(N, M, K, Data(), M, factor.Data(), K, result.Data(),
+                           K, pool);
+  }
 
-  /*
-   * Сложение, вычитание, операторы +=, -=.
-   * Сложение и вычитание матриц несоответствующих
-   * размеров не должно компилироваться.
-   * Гарантируется, что типы в матрицах в тестах
-   * будут поддерживать соответствующие операции.
-   */
+  template <size_t K>
+  void MultiplyLarge(const Matrix<M, K, T>& factor, Matrix<N, K, T>& result,
+                     ThreadPool& pool, std::true_type /*use_strassen*/) const {
+    gemm::Strassen(N, Data(), N, factor.Data(), N, result.Data(), N, pool);
+  }
 
-  // Операторы +=
-  Matrix& operator+=(const Matrix& to_add) {
-    for (size_t i = 0; i < N; i++) {
-      for (size_t j = 0; j < N; j++) {
-        this->data_[i][j] += to_add.data_[i][j];
-      }
-    }
-    return *this;
+  void TransposeInto(T* result, std::true_type /*unrolled*/) const {
+    unrolled::Transpose<N, M>(Data(), result);
   }
 
-  // Сложение
-  Matrix operator+(const Matrix& to_add) const {
-    Matrix result(this->data_);
-    result += to_add;
-    return result;
+  void TransposeInto(T* result, std::false_type /*unrolled*/) const {
+    const T* data = Data();
+    // bands of whole source rows, each band is transposed by tiles
+    ForEachMatrixBlock(N * M, [data, result](size_t begin, size_t end) {
+      transpose::Transpose(end / M - begin / M, M, data + begin, M,
+                           result + begin / M, N);
+    }, M);
   }
 
-  // Операторы -=
-  Matrix operator-(const Matrix& to_sub) const {
-    Matrix result(this->data_);
-    result -= to_sub;
-    return result;
+  // Вызывает apply(i) для каждого индекса элемента. У маленьких матриц
+  // это один цикл с границей, известной при компиляции (его разворачивает
+  // и векторизует компилятор), у больших - блоки в MatrixExecutor()
+  template <typename Apply>
+  static void ForEachElement(const Apply& apply) {
+    ForEachElement(apply, unrolled::Fits<N, M>());
   }
 
-  // Вычитание
-  Matrix& operator-=(const Matrix& to_sub) {
-    for (size_t i = 0; i < N; i++) {
-      for (size_t j = 0; j < N; j++) {
-        this->data_[i][j] -= to_sub.data_[i][j];
-      }
+  template <typename Apply>
+  static void ForEachElement(const Apply& apply, std::true_type /*unrolled*/) {
+#pragma GCC unroll 16
+    for (size_t i = 0; i < N * M; i++) {
+      apply(i);
     }
-    return *this;
   }
 
-  // Умножение на элемент типа T
-  // (гарантируется, что оператор * определен для T)
-  Matrix& operator*=(const T& factor) {
-    for (std::vector<T>& row : this->data_) {
-      for (T& element : row) {
-        element *= factor;
+  template <typename Apply>
+  static void ForEachElement(const Apply& apply, std::false_type /*unrolled*/) {
+    ForEachMatrixBlock(N * M, [&apply](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        apply(i);
       }
-    }
-    return *this;
+    });
   }
 
-  // Умножение на элемент типа T
-  // (гарантируется, что оператор * определен для T)
-  friend Matrix operator*(const Matrix& matrix, const T& factor) {
-    Matrix result(matrix.data_);
-    result *= factor;
-    return result;
+  Matrix<N, M, T>& Self() { return static_cast<Matrix<N, M, T>&>(*this); }
+  const Matrix<N, M, T>& Self() const {
+    return static_cast<const Matrix<N, M, T>&>(*this);
   }
 
-  // Умножение на элемент типа T
-  // (гарантируется, что оператор * определен для T)
-  friend Matrix operator*(const T& factor, const Matrix& matrix) {
-    Matrix result(matrix.data_);
-    result *= factor;
-    return result;
-  }
+  MatrixStorage<T, N * M> data_;
+};
 
-  // Умножение двух матриц.
-  // Попытка перемножить матрицы несоответствующих размеров
-  // должна приводить к ошибке компиляции.
-  template <size_t K>
-  Matrix<N, K, T> operator*(const Matrix<N, K, T>& factor) const {
-    Matrix<N, K, T> result;
+template <size_t N, size_t M, typename T>
+class Matrix : public MatrixBase<N, M, T> {
+ public:
+  using MatrixBase<N, M, T>::MatrixBase;
+  using MatrixBase<N, M, T>::operator=;
+};
+
+template <size_t N, typename T>
+class Matrix<N, N, T> : public MatrixBase<N, N, T> {
+ public:
+  using MatrixBase<N, N, T>::MatrixBase;
+  using MatrixBase<N, N, T>::operator=;
+
+  // Транспонирует матрицу на месте, без выделения памяти
+  void TransposeInPlace() { transpose::TransposeSquare(N, this->Data(), N); }
+
+  // Метод Trace() - вычислить след матрицы.
+  // Вычисление следа от неквадратной
+  // матрицы не должно компилироваться.
+  T Trace() const { return Trace(unrolled::Fits<N, N>()); }
+
+  // Определитель. Для float и double считается через LU, для остальных
+  // типов (целые, BigInt) - точно, методом Барейса
+  T Determinant() const { return Determinant(std::is_floating_point<T>()); }
+
+  // Обратная матрица; для вырожденной - исключение std::invalid_argument
+  template <typename U = T>
+  typename std::enable_if<std::is_floating_point<U>::value, Matrix>::type
+  Inverse() const {
+    Matrix inverse;
     for (size_t i = 0; i < N; i++) {
-      for (size_t j = 0; j < K; j++) {
-        for (size_t it = 0; it < N; it++) {
-          result(i, j) += this->data_[i][it] * factor(it, j);
-        }
-      }
+      inverse(i, i) = T(1);
     }
-    return result;
+    SolveInPlace(inverse.Data(), N);
+    return inverse;
   }
 
-  template <size_t K>
-  Matrix operator*=(const Matrix<N, K, T>& factor) {
-    Matrix result = *this * factor;
+  // Решение системы A X = B, B - столбец Matrix<N, 1, T> или несколько
+  // столбцов; для вырожденной A - исключение std::invalid_argument
+  template <size_t K, typename U = T>
+  typename std::enable_if<std::is_floating_point<U>::value,
+                          Matrix<N, K, T>>::type
+  Solve(const Matrix<N, K, T>& b) const {
+    Matrix<N, K, T> x(b);
+    SolveInPlace(x.Data(), K);
+    return x;
+  }
 
-    this->data_.resize(N);
-    for (size_t i = 0; i < N; i++) {
-      this->data_[i] = result[i];
+  // Нижнетреугольная L, для которой A = L * L^T (разложение Холецкого).
+  // Матрица должна быть симметричной и положительно определенной,
+  // иначе - исключение std::invalid_argument
+  template <typename U = T>
+  typename std::enable_if<std::is_floating_point<U>::value, Matrix>::type
+  Cholesky() const {
+    Matrix lower(*this);
+    if (!linalg::Cholesky(N, lower.Data(), N)) {
+      throw std::invalid_argument("Matrix::Cholesky: not positive definite");
     }
+    return lower;
+  }
 
-    return *this;
+  // Решение A X = B для симметричной положительно определенной A
+  // через разложение Холецкого: вдвое меньше операций, чем у Solve
+  template <size_t K, typename U = T>
+  typename std::enable_if<std::is_floating_point<U>::value,
+                          Matrix<N, K, T>>::type
+  SolvePositiveDefinite(const Matrix<N, K, T>& b) const {
+    Matrix lower = Cholesky();
+    Matrix<N, K, T> x(b);
+    linalg::CholeskySolve(N, lower.Data(), N, K, x.Data(), K);
+    return x;
   }
 
-  // Метод Transposed(), возвращающий транспонированную матрицу.
-  Matrix<N, N, T> Transposed() const {
-    Matrix<N, N, T> transposed;
+ private:
+  T Trace(std::true_type /*unrolled*/) const {
+    return unrolled::Trace<N>(this->Data());
+  }
+
+  T Trace(std::false_type /*unrolled*/) const {
+    T result = T();
     for (size_t i = 0; i < N; i++) {
-      for (size_t j = 0; j < N; j++) {
-        transposed(j, i) = this->data_[i][j];
-      }
+      result += (*this)(i, i);
     }
-    return transposed;
+    return result;
   }
 
-  // Метод Trace() - вычислить след матрицы.
-  // Вычисление следа от неквадратной
-  // матрицы не должно компилироваться.
-  T Trace() const {
-    T result;
+  T Determinant(std::true_type /*is_floating_point*/) const {
+    Matrix lu(*this);
+    std::array<size_t, N> pivots;
+    linalg::LuInfo info =
+        linalg::LU<N>(lu.Data(), pivots.data(), MatrixExecutor());
+    if (info.singular) {
+      return T();
+    }
+    T result = T(info.sign);
     for (size_t i = 0; i < N; i++) {
-      result += this->data_[i][i];
+      result *= lu(i, i);
     }
     return result;
   }
 
-  // Оператор (i, j), возвращающий элемент матрицы в i-й строке и в j-м столбце.
-  // Необходимо уметь менять значение для неконстантных матриц.
-  T& operator()(size_t row, size_t col) { return this->data_[row][col]; }
-  const T& operator()(size_t row, size_t col) const {
-    return this->data_[row][col];
+  T Determinant(std::false_type /*is_floating_point*/) const {
+    Matrix copy(*this);
+    return linalg::Bareiss<N>(copy.Data());
   }
 
-  // Оператор проверки на равенство.
-  bool operator==(const Matrix& to_cmp) const {
-    return this->data_ == to_cmp.data_;
+  // b (N x cols) := A^-1 * b
+  void SolveInPlace(T* b, size_t cols) const {
+    Matrix lu(*this);
+    std::array<size_t, N> pivots;
+    linalg::LuInfo info =
+        linalg::LU<N>(lu.Data(), pivots.data(), MatrixExecutor());
+    if (info.singular) {
+      throw std::invalid_argument("Matrix: system matrix is singular");
+    }
+    linalg::LuSolve(N, lu.Data(), N, pivots.data(), cols, b, cols);
   }
+};
 
- private:
-  std::vector<std::vector<T>> data_;
-};
\ No newline at end of file
+// Операнды умножения без копирования: матрица и транспонированная матрица
+template <size_t N, size_t M, typename T>
+gemm::Strided<T> GemmOperand(const Matrix<N, M, T>& matrix) {
+  return {matrix.Data(), M, 1};
+}
+
+template <size_t N, size_t M, typename T>
+gemm::Strided<T> GemmOperand(const TransposedRef<N, M, T>& matrix) {
+  return {matrix.Source(), 1, N};
+}
+
+template <size_t N, size_t M, size_t K, typename T, typename L, typename R>
+Matrix<N, K, T> MultiplyOperands(const L& left, const R& right) {
+  Matrix<N, K, T> result;
+  gemm::ParallelMultiply(N, M, K, GemmOperand(left), GemmOperand(right),
+                         result.Data(), K, MatrixExecutor());
+  return result;
+}
+
+// Умножение с транспонированными множителями, например A.TransposedView() * B
+template <size_t N, size_t M, size_t K, typename T>
+Matrix<N, K, T> operator*(const TransposedRef<N, M, T>& left,
+                          const Matrix<M, K, T>& right) {
+  return MultiplyOperands<N, M, K, T>(left, right);
+}
+
+template <size_t N, size_t M, size_t K, typename T>
+Matrix<N, K, T> operator*(const Matrix<N, M, T>& left,
+                          const TransposedRef<M, K, T>& right) {
+  return MultiplyOperands<N, M, K, T>(left, right);
+}
+
+template <size_t N, size_t M, size_t K, typename T>
+Matrix<N, K, T> operator*(const TransposedRef<N, M, T>& left,
+                          const TransposedRef<M, K, T>& right) {
+  return MultiplyOperands<N, M, K, T>(left, right);
+}
@@ -0,0 +1,410 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "aligned_allocator.hpp"
+#include "gemm.hpp"
+#include "matrix.hpp"
+
+// Матрицы в пакете лежат блоками по kBatchLanes: внутри блока хранится
+// сначала элемент (0, 0) всех kBatchLanes матриц подряд, потом (0, 1)
+// и так далее (structure of arrays внутри блока). Поэтому операция над
+// одним элементом сразу для kBatchLanes матриц - один проход по
+// непрерывным kBatchLanes числам, который компилятор делает векторными
+// инструкциями: для float это одна строка кэша, 16 чисел.
+static const size_t kBatchLanes = 16;
+
+namespace batch {
+
+// Указатель на элемент (row, col) всех матриц блока матриц N x M
+template <size_t N, size_t M, typename T>
+inline T* Lanes(T* block, size_t row, size_t col) {
+  return block + (row * M + col) * kBatchLanes;
+}
+
+// c := a * b для каждой из kBatchLanes пар матриц блока
+template <size_t N, size_t M, size_t K, typename T>
+__attribute__((always_inline)) inline void MultiplyBlock(const T* a,
+                                                         const T* b, T* c) {
+  for (size_t i = 0; i < N; i++) {
+    for (size_t j = 0; j < K; j++) {
+      T acc[kBatchLanes] = {};
+      for (size_t p = 0; p < M; p++) {
+        const T* a_lanes = Lanes<N, M>(a, i, p);
+        const T* b_lanes = Lanes<M, K>(b, p, j);
+#pragma GCC unroll 16
+        for (size_t lane = 0; lane < kBatchLanes; lane++) {
+          acc[lane] += a_lanes[lane] * b_lanes[lane];
+        }
+      }
+      T* c_lanes = Lanes<N, K>(c, i, j);
+#pragma GCC unroll 16
+      for (size_t lane = 0; lane < kBatchLanes; lane++) {
+        c_lanes[lane] = acc[lane];
+      }
+    }
+  }
+}
+
+// Определители kBatchLanes матриц N x N блока. Для N <= 4 - явные
+// формулы без ветвлений, одинаковые для всех матриц блока
+template <typename T>
+__attribute__((always_inline)) inline void DeterminantBlock(
+    const T* a, T* det, std::integral_constant<size_t, 1> /*size*/) {
+  std::copy(a, a + kBatchLanes, det);
+}
+
+template <typename T>
+__attribute__((always_inline)) inline void DeterminantBlock(
+    const T* a, T* det, std::integral_constant<size_t, 2> /*size*/) {
+  const T* a00 = Lanes<2, 2>(a, 0, 0);
+  const T* a01 = Lanes<2, 2>(a, 0, 1);
+  const T* a10 = Lanes<2, 2>(a, 1, 0);
+  const T* a11 = Lanes<2, 2>(a, 1, 1);
+  for (size_t lane = 0; lane < kBatchLanes; lane++) {
+    det[lane] = a00[lane] * a11[lane] - a01[lane] * a10[lane];
+  }
+}
+
+template <typename T>
+__attribute__((always_inline)) inline void DeterminantBlock(
+    const T* a, T* det, std::integral_constant<size_t, 3> /*size*/) {
+  const T* m[3][3];
+  for (size_t i = 0; i < 3; i++) {
+    for (size_t j = 0; j < 3; j++) {
+      m[i][j] = Lanes<3, 3>(a, i, j);
+    }
+  }
+  for (size_t lane = 0; lane < kBatchLanes; lane++) {
+    det[lane] =
+        m[0][0][lane] *
+            (m[1][1][lane] * m[2][2][lane] - m[1][2][lane] * m[2][1][lane]) -
+        m[0][1][lane] *
+            (m[1][0][lane] * m[2][2][lane] - m[1][2][lane] * m[2][0][lane]) +
+        m[0][2][lane] *
+            (m[1][0][lane] * m[2][1][lane] - m[1][1][lane] * m[2][0][lane]);
+  }
+}
+
+// разложение Лапласа по двум верхним строкам: 2 x 2 миноры сверху
+// умножаются на дополнительные миноры снизу
+template <typename T>
+__attribute__((always_inline)) inline void DeterminantBlock(
+    const T* a, T* det, std::integral_constant<size_t, 4> /*size*/) {
+  const T* m[4][4];
+  for (size_t i = 0; i < 4; i++) {
+    for (size_t j = 0; j < 4; j++) {
+      m[i][j] = Lanes<4, 4>(a, i, j);
+    }
+  }
+  for (size_t lane = 0; lane < kBatchLanes; lane++) {
+    auto minor = [&m, lane](size_t row, size_t left, size_t right) {
+      return m[row][left][lane] * m[row + 1][right][lane] -
+             m[row][right][lane] * m[row + 1][left][lane];
+    };
+    det[lane] = minor(0, 0, 1) * minor(2, 2, 3) -
+                minor(0, 0, 2) * minor(2, 1, 3) +
+                minor(0, 0, 3) * minor(2, 1, 2) +
+                minor(0, 1, 2) * minor(2, 0, 3) -
+                minor(0, 1, 3) * minor(2, 0, 2) +
+                minor(0, 2, 3) * minor(2, 0, 1);
+  }
+}
+
+// остальные размеры - по одной матрице через Matrix::Determinant()
+template <size_t N, typename T>
+void DeterminantBlock(const T* a, T* det,
+                      std::integral_constant<size_t, N> /*size*/) {
+  for (size_t lane = 0; lane < kBatchLanes; lane++) {
+    Matrix<N, N, T> matrix;
+    for (size_t i = 0; i < N * N; i++) {
+      matrix.Data()[i] = a[i * kBatchLanes + lane];
+    }
+    det[lane] = matrix.Determinant();
+  }
+}
+
+// Вызывает kernel(block) для блоков [begin, end)
+template <typename Kernel>
+void RunBlocks(size_t begin, size_t end, const Kernel& kernel) {
+  for (size_t block = begin; block < end; block++) {
+    kernel(block);
+  }
+}
+
+#ifdef MATRIX_GEMM_X86
+
+// То же, но ядра, встроенные в этот цикл, компилируются с AVX2 и
+// обрабатывают по 8 float или 4 double за инструкцию
+template <typename Kernel>
+__attribute__((target("avx2,fma"))) void RunBlocksAvx2(size_t begin,
+                                                        size_t end,
+                                                        const Kernel& kernel) {
+  for (size_t block = begin; block < end; block++) {
+    kernel(block);
+  }
+}
+
+#endif
+
+// Вызывает kernel(block) для block из [0, blocks). Ядро должно быть
+// always_inline, чтобы его циклы компилировались вместе с циклом блоков.
+// block_size - число элементов в блоке, по нему большие пакеты делятся
+// между потоками MatrixExecutor()
+template <typename Kernel>
+void ForEachBlock(size_t blocks, size_t block_size, const Kernel& kernel) {
+  ForEachMatrixBlock(blocks * block_size, [&](size_t begin, size_t end) {
+#ifdef MATRIX_GEMM_X86
+    if (gemm::HasAvx2()) {
+      RunBlocksAvx2(begin / block_size, end / block_size, kernel);
+      return;
+    }
+#endif
+    RunBlocks(begin / block_size, end / block_size, kernel);
+  }, block_size);
+}
+
+}  // namespace batch
+
+// Пакет из Size() независимых матриц N x M для поэлементных операций
+// и попарного умножения сразу над многими матрицами. Операции над
+// пакетами разного размера приводят к исключению std::invalid_argument
+template <size_t N, size_t M, typename T = int64_t>
+class MatrixBatch {
+ public:
+  // Пустой пакет
+  MatrixBatch() = default;
+
+  // Пакет из count матриц, заполненных T()
+  explicit MatrixBatch(size_t count)
+      : count_(count), data_(BlockCount(count) * kBlockSize) {}
+
+  // Сбор (gather) матриц в пакет
+  explicit MatrixBatch(const std::vector<Matrix<N, M, T>>& matrices)
+      : MatrixBatch(matrices.size()) {
+    for (size_t index = 0; index < count_; index++) {
+      Set(index, matrices[index]);
+    }
+  }
+
+  size_t Size() const { return count_; }
+
+  // Элемент (row, col) матрицы с номером index
+  T& operator()(size_t index, size_t row, size_t col) {
+    return data_[Offset(index, row, col)];
+  }
+  const T& operator()(size_t index, size_t row, size_t col) const {
+    return data_[Offset(index, row, col)];
+  }
+
+  // Матрица с номером index
+  Matrix<N, M, T> Get(size_t index) const {
+    Matrix<N, M, T> matrix;
+    const T* lane = data_.data() + Offset(index, 0, 0);
+    for (size_t i = 0; i < N * M; i++) {
+      matrix.Data()[i] = lane[i * kBatchLanes];
+    }
+    return matrix;
+  }
+
+  void Set(size_t index, const Matrix<N, M, T>& matrix) {
+    T* lane = data_.data() + Offset(index, 0, 0);
+    for (size_t i = 0; i < N * M; i++) {
+      lane[i * kBatchLanes] = matrix.Data()[i];
+    }
+  }
+
+  // Добавляет матрицу в конец пакета
+  void PushBack(const Matrix<N, M, T>& matrix) {
+    if (count_ % kBatchLanes == 0) {
+      data_.resize(data_.size() + kBlockSize);
+    }
+    Set(count_++, matrix);
+  }
+
+  // Разбор (scatter) пакета в отдельные матрицы
+  std::vector<Matrix<N, M, T>> Scatter() const {
+    std::vector<Matrix<N, M, T>> matrices;
+    matrices.reserve(count_);
+    for (size_t index = 0; index < count_; index++) {
+      matrices.push_back(Get(index));
+    }
+    return matrices;
+  }
+
+  // Поэлементные операции над соответствующими матрицами пакетов
+  MatrixBatch& operator+=(const MatrixBatch& to_add) {
+    CheckSize(to_add.count_, "operator+=");
+    T* data = data_.data();
+    const T* other = to_add.data_.data();
+    ForEachMatrixBlock(data_.size(), [data, other](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        data[i] += other[i];
+      }
+    });
+    return *this;
+  }
+
+  MatrixBatch& operator-=(const MatrixBatch& to_sub) {
+    CheckSize(to_sub.count_, "operator-=");
+    T* data = data_.data();
+    const T* other = to_sub.data_.data();
+    ForEachMatrixBlock(data_.size(), [data, other](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        data[i] -= other[i];
+      }
+    });
+    return *this;
+  }
+
+  // Умножение всех матриц на элемент типа T
+  MatrixBatch& operator*=(const T& factor) {
+    T* data = data_.data();
+    ForEachMatrixBlock(data_.size(), [data, &factor](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        data[i] *= factor;
+      }
+    });
+    return *this;
+  }
+
+  friend MatrixBatch operator+(const MatrixBatch& left,
+                               const MatrixBatch& right) {
+    MatrixBatch result(left);
+    result += right;
+    return result;
+  }
+
+  friend MatrixBatch operator-(const MatrixBatch& left,
+                               const MatrixBatch& right) {
+    MatrixBatch result(left);
+    result -= right;
+    return result;
+  }
+
+  friend MatrixBatch operator*(const MatrixBatch& batch, const T& factor) {
+    MatrixBatch result(batch);
+    result *= factor;
+    return result;
+  }
+
+  friend MatrixBatch operator*(const T& factor, const MatrixBatch& batch) {
+    MatrixBatch result(batch);
+    result *= factor;
+    return result;
+  }
+
+  // Попарные произведения: i-я матрица результата - произведение
+  // i-х матриц пакетов
+  template <size_t K>
+  MatrixBatch<N, K, T> operator*(const MatrixBatch<M, K, T>& factor) const {
+    CheckSize(factor.count_, "operator*");
+    MatrixBatch<N, K, T> result(count_);
+    const T* left = data_.data();
+    const T* right = factor.data_.data();
+    T* product = result.data_.data();
+    batch::ForEachBlock(
+        BlockCount(count_), kBlockSize,
+        [=](size_t block) __attribute__((always_inline)) {
+          batch::MultiplyBlock<N, M, K>(
+              left + block * N * M * kBatchLanes,
+              right + block * M * K * kBatchLanes,
+              product + block * N * K * kBatchLanes);
+        });
+    return result;
+  }
+
+  // Пакет транспонированных матриц
+  MatrixBatch<M, N, T> Transposed() const {
+    MatrixBatch<M, N, T> result(count_);
+    const T* data = data_.data();
+    T* transposed = result.data_.data();
+    batch::ForEachBlock(
+        BlockCount(count_), kBlockSize,
+        [=](size_t block) __attribute__((always_inline)) {
+          const T* source = data + block * kBlockSize;
+          T* target = transposed + block * kBlockSize;
+          // each element is a run of kBatchLanes numbers, runs are permuted
+          for (size_t i = 0; i < N; i++) {
+            for (size_t j = 0; j < M; j++) {
+              const T* lanes = batch::Lanes<N, M>(source, i, j);
+              std::copy(lanes, lanes + kBatchLanes,
+                        batch::Lanes<M, N>(target, j, i));
+            }
+          }
+        });
+    return result;
+  }
+
+  // Определители всех матриц пакета (только для квадратных)
+  template <size_t K = M>
+  typename std::enable_if<K == N, std::vector<T>>::type Determinants() const {
+    std::vector<T> result(BlockCount(count_) * kBatchLanes);
+    const T* data = data_.data();
+    T* det = result.data();
+    batch::ForEachBlock(
+        BlockCount(count_), kBlockSize,
+        [=](size_t block) __attribute__((always_inline)) {
+          batch::DeterminantBlock(data + block * kBlockSize,
+                                  det + block * kBatchLanes,
+                                  std::integral_constant<size_t, N>());
+        });
+    result.resize(count_);
+    return result;
+  }
+
+  // Оператор проверки на равенство
+  bool operator==(const MatrixBatch& to_cmp) const {
+    if (count_ != to_cmp.count_) {
+      return false;
+    }
+    for (size_t index = 0; index < count_; index++) {
+      for (size_t i = 0; i < N * M; i++) {
+        size_t offset = Offset(index, 0, 0) + i * kBatchLanes;
+        if (!(data_[offset] == to_cmp.data_[offset])) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  bool operator!=(const MatrixBatch& to_cmp) const {
+    return !(*this == to_cmp);
+  }
+
+ private:
+  template <size_t, size_t, typename>
+  friend class MatrixBatch;
+
+  // элементов в одном блоке из kBatchLanes матриц
+  static const size_t kBlockSize = N * M * kBatchLanes;
+
+  static size_t BlockCount(size_t count) {
+    return (count + kBatchLanes - 1) / kBatchLanes;
+  }
+
+  static size_t Offset(size_t index, size_t row, size_t col) {
+    return index / kBatchLanes * kBlockSize +
+           (row * M + col) * kBatchLanes + index % kBatchLanes;
+  }
+
+  void CheckSize(size_t count, const char* operation) const {
+    if (count != count_) {
+      throw std::invalid_argument(std::string("MatrixBatch::") + operation +
+                                  ": batch sizes " + std::to_string(count_) +
+                                  " and " + std::to_string(count) +
+                                  " differ");
+    }
+  }
+
+  size_t count_ = 0;
+  // блоки целиком; хвост последнего блока заполнен T()
+  std::vector<T, AlignedAllocator<T>> data_;
+};
@@ -0,0 +1,383 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+template <size_t N, size_t M, typename T>
+class Matrix;
+
+// Ленивые поэлементные выражения над матрицами (expression templates).
+// Операторы +, - и умножение на число возвращают не Matrix, а узел
+// выражения; элементы считаются один раз, в одном цикле, при присваивании
+// выражения матрице или при создании матрицы из выражения. Поэтому
+// A + B - 2 * C выделяет память не больше одного раза, а присваивание
+// существующей матрице не выделяет ее вообще.
+//
+// Именованные матрицы-операнды узлы хранят по ссылке, а временные
+// (A + B.Transposed(), A + A * B) забирают себе, так что результат
+// операции можно сохранить в auto, пока живут именованные операнды.
+// Результат ведет себя как матрица: у него есть (i, j), Transposed(),
+// Trace(), Determinant(), ==, умножение на матрицу, +=, -= и *=. При
+// первом изменении (s(0, 0) = 5, s += A) или обращении к Data() он
+// вычисляется во внутреннюю матрицу, и дальше читается из нее; до этого
+// он видит текущие значения операндов.
+//
+// Каждый узел умеет ответить Permutes(data): читает ли он элементы блока
+// data не по тем индексам, по которым пишется результат. Такое выражение
+// (A = A.TransposedView()) при присваивании сначала вычисляется во
+// временную матрицу, иначе оно читало бы уже перезаписанные элементы.
+
+// Базовый класс выражения размера N x M; E - конкретный узел
+template <size_t N, size_t M, typename T, typename E>
+class MatrixExpr {
+ public:
+  using Scalar = T;
+
+  const E& Expression() const { return static_cast<const E&>(*this); }
+
+  // элемент в i-й строке и j-м столбце
+  T operator()(size_t row, size_t col) const {
+    return Expression().At(row * M + col);
+  }
+
+  // вычисляет выражение в новую матрицу
+  Matrix<N, M, T> Eval() const { return Matrix<N, M, T>(*this); }
+
+  // Методы Matrix, не меняющие матрицу; выражение для них вычисляется
+  Matrix<M, N, T> Transposed() const { return Eval().Transposed(); }
+
+  // только для квадратных выражений, как у Matrix
+  template <size_t K = N>
+  typename std::enable_if<K == M, T>::type Trace() const {
+    return Eval().Trace();
+  }
+
+  template <size_t K = N>
+  typename std::enable_if<K == M, T>::type Determinant() const {
+    return Eval().Determinant();
+  }
+};
+
+// Лист выражения: элементы существующей матрицы
+template <size_t N, size_t M, typename T>
+class MatrixRef {
+ public:
+  MatrixRef(const Matrix<N, M, T>& matrix) : data_(matrix.Data()) {}
+
+  const T& At(size_t index) const { return data_[index]; }
+
+  // элемент index читается из той же позиции, куда пишется результат
+  bool Permutes(const T* /*data*/) const { return false; }
+
+ private:
+  const T* data_;
+};
+
+// Лист выражения: временная матрица, которой владеет выражение
+template <size_t N, size_t M, typename T>
+class MatrixValue {
+ public:
+  explicit MatrixValue(Matrix<N, M, T>&& matrix)
+      : matrix_(std::move(matrix)) {}
+  explicit MatrixValue(const Matrix<N, M, T>& matrix) : matrix_(matrix) {}
+
+  const T& At(size_t index) const { return matrix_.Data()[index]; }
+
+  // своя копия никогда не совпадает с матрицей, в которую пишется результат
+  bool Permutes(const T* /*data*/) const { return false; }
+
+ private:
+  Matrix<N, M, T> matrix_;
+};
+
+// Лист выражения: транспонированная матрица без копирования.
+// Элемент (i, j) - это элемент (j, i) исходной матрицы M x N.
+// Умножение матриц принимает такой лист напрямую, не создавая копию
+template <size_t N, size_t M, typename T>
+class TransposedRef : public MatrixExpr<N, M, T, TransposedRef<N, M, T>> {
+ public:
+  explicit TransposedRef(const Matrix<M, N, T>& matrix)
+      : data_(matrix.Data()) {}
+
+  const T& At(size_t index) const {
+    return data_[index % M * N + index / M];
+  }
+
+  // элементы исходной матрицы M x N, построчно
+  const T* Source() const { return data_; }
+
+  bool Permutes(const T* data) const { return data_ == data; }
+
+ private:
+  const T* data_;
+};
+
+// Результат операции над матрицами: узел выражения, который при
+// изменении вычисляется во внутреннюю матрицу и дальше ведет себя как она
+template <size_t N, size_t M, typename T, typename E>
+class LazyMatrix : public MatrixExpr<N, M, T, E> {
+ public:
+  LazyMatrix() = default;
+  LazyMatrix(const LazyMatrix& other) : value_(Copy(other.value_)) {}
+  LazyMatrix(LazyMatrix&& other) = default;
+  LazyMatrix& operator=(const LazyMatrix& other) {
+    if (this != &other) {
+      value_ = Copy(other.value_);
+    }
+    return *this;
+  }
+  LazyMatrix& operator=(LazyMatrix&& other) = default;
+
+  // Значение выражения; вычисляется при первом обращении
+  const Matrix<N, M, T>& Value() const {
+    if (value_ == nullptr) {
+      value_.reset(new Matrix<N, M, T>(*this));
+    }
+    return *value_;
+  }
+  Matrix<N, M, T>& Value() {
+    static_cast<const LazyMatrix&>(*this).Value();
+    return *value_;
+  }
+
+  // элемент в i-й строке и j-м столбце, его можно менять
+  T& operator()(size_t row, size_t col) { return Value()(row, col); }
+  T operator()(size_t row, size_t col) const {
+    return this->Expression().At(row * M + col);
+  }
+
+  T* Data() { return Value().Data(); }
+  const T* Data() const { return Value().Data(); }
+
+  // Изменения значения, как у Matrix
+  template <typename R>
+  Matrix<N, M, T>& operator=(const MatrixExpr<N, M, T, R>& expr) {
+    return Value() = expr;
+  }
+  template <typename R>
+  Matrix<N, M, T>& operator+=(const MatrixExpr<N, M, T, R>& to_add) {
+    return Value() += to_add;
+  }
+  template <typename R>
+  Matrix<N, M, T>& operator-=(const MatrixExpr<N, M, T, R>& to_sub) {
+    return Value() -= to_sub;
+  }
+  Matrix<N, M, T>& operator*=(const T& factor) { return Value() *= factor; }
+  Matrix<N, M, T>& operator*=(const Matrix<M, M, T>& factor) {
+    return Value() *= factor;
+  }
+
+ protected:
+  // элементы вычисленного значения, nullptr - значение еще не вычислено
+  const T* ValueData() const {
+    return value_ == nullptr ? nullptr : value_->Data();
+  }
+
+ private:
+  static std::unique_ptr<Matrix<N, M, T>> Copy(
+      const std::unique_ptr<Matrix<N, M, T>>& value) {
+    return std::unique_ptr<Matrix<N, M, T>>(
+        value == nullptr ? nullptr : new Matrix<N, M, T>(*value));
+  }
+
+  mutable std::unique_ptr<Matrix<N, M, T>> value_;
+};
+
+// Как операнд хранится в узле: матрица - через MatrixRef, узел - по значению
+template <typename E>
+struct ExprOperand {
+  using Type = E;
+};
+
+template <size_t N, size_t M, typename T>
+struct ExprOperand<Matrix<N, M, T>> {
+  using Type = MatrixRef<N, M, T>;
+};
+
+// Операнд, переданный оператору как Arg&&: временная матрица (Arg без
+// ссылки) переходит во владение узла, остальные - как в ExprOperand
+template <typename Arg>
+struct StoredOperand {
+  using Type = typename ExprOperand<typename std::decay<Arg>::type>::Type;
+};
+
+template <size_t N, size_t M, typename T>
+struct StoredOperand<Matrix<N, M, T>> {
+  using Type = MatrixValue<N, M, T>;
+};
+
+template <size_t N, size_t M, typename T>
+struct StoredOperand<const Matrix<N, M, T>> {
+  using Type = MatrixValue<N, M, T>;
+};
+
+template <typename Arg>
+typename StoredOperand<Arg>::Type StoreOperand(Arg&& arg) {
+  return typename StoredOperand<Arg>::Type(std::forward<Arg>(arg));
+}
+
+// Как выражение читается при вычислении: узел - по ссылке, матрица -
+// через MatrixRef
+template <typename E>
+struct ExprReader {
+  using Type = const E&;
+};
+
+template <size_t N, size_t M, typename T>
+struct ExprReader<Matrix<N, M, T>> {
+  using Type = MatrixRef<N, M, T>;
+};
+
+// Поэлементная бинарная операция Op
+template <size_t N, size_t M, typename T, typename L, typename R, typename Op>
+class BinaryExpr
+    : public LazyMatrix<N, M, T, BinaryExpr<N, M, T, L, R, Op>> {
+ public:
+  using LazyMatrix<N, M, T, BinaryExpr>::operator=;
+
+  BinaryExpr(L left, R right)
+      : left_(std::move(left)), right_(std::move(right)) {}
+
+  T At(size_t index) const {
+    const T* value = this->ValueData();
+    if (value != nullptr) {
+      return value[index];
+    }
+    return Op()(left_.At(index), right_.At(index));
+  }
+
+  bool Permutes(const T* data) const {
+    return left_.Permutes(data) || right_.Permutes(data);
+  }
+
+ private:
+  L left_;
+  R right_;
+};
+
+// Умножение каждого элемента на число
+template <size_t N, size_t M, typename T, typename E>
+class ScaleExpr : public LazyMatrix<N, M, T, ScaleExpr<N, M, T, E>> {
+ public:
+  using LazyMatrix<N, M, T, ScaleExpr>::operator=;
+
+  ScaleExpr(E expr, const T& factor)
+      : expr_(std::move(expr)), factor_(factor) {}
+
+  T At(size_t index) const {
+    const T* value = this->ValueData();
+    if (value != nullptr) {
+      return value[index];
+    }
+    return expr_.At(index) * factor_;
+  }
+
+  bool Permutes(const T* data) const { return expr_.Permutes(data); }
+
+ private:
+  E expr_;
+  T factor_;
+};
+
+// Размеры и тип элементов выражения типа Arg (без ссылок и const);
+// для типов, не являющихся выражениями, не определен
+template <size_t N, size_t M, typename T>
+struct ExprShape {};
+
+template <size_t N, size_t M, typename T, typename E>
+ExprShape<N, M, T> ShapeOf(const MatrixExpr<N, M, T, E>& expr);
+
+template <typename Arg>
+using ExprShapeOf = decltype(ShapeOf(
+    std::declval<const typename std::decay<Arg>::type&>()));
+
+template <typename Shape, typename L, typename R,
+          template <typename> class Op>
+struct BinaryResult;
+
+template <size_t N, size_t M, typename T, typename L, typename R,
+          template <typename> class Op>
+struct BinaryResult<ExprShape<N, M, T>, L, R, Op> {
+  using Type = BinaryExpr<N, M, T, typename StoredOperand<L>::Type,
+                          typename StoredOperand<R>::Type, Op<T>>;
+};
+
+template <typename Shape, typename E>
+struct ScaleResult;
+
+template <size_t N, size_t M, typename T, typename E>
+struct ScaleResult<ExprShape<N, M, T>, E> {
+  using Type = ScaleExpr<N, M, T, typename StoredOperand<E>::Type>;
+  using Scalar = T;
+};
+
+// Сложение; выражения разных размеров складывать нельзя
+template <typename L, typename R>
+typename std::enable_if<
+    std::is_same<ExprShapeOf<L>, ExprShapeOf<R>>::value,
+    typename BinaryResult<ExprShapeOf<L>, L, R, std::plus>::Type>::type
+operator+(L&& left, R&& right) {
+  return {StoreOperand<L>(std::forward<L>(left)),
+          StoreOperand<R>(std::forward<R>(right))};
+}
+
+// Вычитание
+template <typename L, typename R>
+typename std::enable_if<
+    std::is_same<ExprShapeOf<L>, ExprShapeOf<R>>::value,
+    typename BinaryResult<ExprShapeOf<L>, L, R, std::minus>::Type>::type
+operator-(L&& left, R&& right) {
+  return {StoreOperand<L>(std::forward<L>(left)),
+          StoreOperand<R>(std::forward<R>(right))};
+}
+
+// Умножение на элемент типа T. Тип числа выводится из матрицы,
+// так что Matrix<2, 2> * 2 работает без явного приведения к int64_t
+template <typename E, typename Result = ScaleResult<ExprShapeOf<E>, E>>
+typename Result::Type operator*(E&& expr,
+                                const typename Result::Scalar& factor) {
+  return {StoreOperand<E>(std::forward<E>(expr)), factor};
+}
+
+template <typename E, typename Result = ScaleResult<ExprShapeOf<E>, E>>
+typename Result::Type operator*(const typename Result::Scalar& factor,
+                                E&& expr) {
+  return {StoreOperand<E>(std::forward<E>(expr)), factor};
+}
+
+// Умножение результата операции на матрицу (и наоборот): результат
+// вычисляется, затем умножается как Matrix
+template <size_t N, size_t M, size_t K, typename T, typename L>
+Matrix<N, K, T> operator*(const LazyMatrix<N, M, T, L>& left,
+                          const Matrix<M, K, T>& right) {
+  return left.Eval() * right;
+}
+
+template <size_t N, size_t M, size_t K, typename T, typename R>
+Matrix<N, K, T> operator*(const Matrix<N, M, T>& left,
+                          const LazyMatrix<M, K, T, R>& right) {
+  return left * right.Eval();
+}
+
+template <size_t N, size_t M, size_t K, typename T, typename L, typename R>
+Matrix<N, K, T> operator*(const LazyMatrix<N, M, T, L>& left,
+                          const LazyMatrix<M, K, T, R>& right) {
+  return left.Eval() * right.Eval();
+}
+
+// Оператор проверки на равенство
+template <size_t N, size_t M, typename T, typename L, typename R>
+bool operator==(const MatrixExpr<N, M, T, L>& left,
+                const MatrixExpr<N, M, T, R>& right) {
+  typename ExprReader<L>::Type left_operand(left.Expression());
+  typename ExprReader<R>::Type right_operand(right.Expression());
+  for (size_t i = 0; i < N * M; i++) {
+    if (!(left_operand.At(i) == right_operand.At(i))) {
+      return false;
+    }
+  }
+  return true;
+}
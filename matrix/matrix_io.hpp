@@ -0,0 +1,427 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "dyn_matrix.hpp"
+#include "gemm.hpp"
+#include "matrix.hpp"
+#include "thread_pool.hpp"
+
+// Двоичный формат матриц на диске.
+//
+// Файл - заголовок FileHeader, дополненный нулями до kPayloadAlignment
+// байт, и затем элементы построчно в порядке байтов машины. Смещение
+// данных кратно 64, поэтому в отображенном через mmap файле (оно
+// начинается с границы страницы) данные выровнены так же, как блок
+// AlignedAllocator, и ядра gemm читают их прямо из кэша страниц.
+//
+// Поддерживаются арифметические T; в заголовке записаны размер и вид
+// элемента (bool - отдельный вид, не беззнаковое целое размера 1), файл
+// с другим T не загрузится. Ошибки ввода-вывода -
+// std::runtime_error, неверный файл - std::invalid_argument.
+namespace matrix_io {
+
+static const size_t kPayloadAlignment = 64;
+static const char kMagic[8] = {'M', 'A', 'T', 'R', 'I', 'X', '0', '1'};
+
+// Вид элемента в заголовке
+enum ElementKind : uint32_t {
+  kSigned = 0,
+  kUnsigned = 1,
+  kFloating = 2,
+  kBoolean = 3
+};
+
+struct FileHeader {
+  char magic[8];
+  uint64_t rows;
+  uint64_t cols;
+  uint32_t element_size;
+  uint32_t element_kind;
+  uint64_t payload_offset;
+};
+
+template <typename T>
+using EnableIfArithmetic =
+    typename std::enable_if<std::is_arithmetic<T>::value>::type;
+
+template <typename T>
+FileHeader MakeHeader(size_t rows, size_t cols) {
+  FileHeader header;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.rows = rows;
+  header.cols = cols;
+  header.element_size = sizeof(T);
+  header.element_kind = std::is_same<T, bool>::value       ? kBoolean
+                        : std::is_floating_point<T>::value ? kFloating
+                        : std::is_signed<T>::value         ? kSigned
+                                                           : kUnsigned;
+  header.payload_offset = kPayloadAlignment;
+  return header;
+}
+
+inline std::runtime_error SystemError(const std::string& path,
+                                      const char* operation) {
+  return std::runtime_error("matrix file " + path + ": " + operation +
+                            " failed: " + std::strerror(errno));
+}
+
+// Файловый дескриптор, закрывается в деструкторе
+class File {
+ public:
+  File(const std::string& path, int flags) : path_(path) {
+    fd_ = ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+      throw SystemError(path_, "open");
+    }
+  }
+
+  File(const File& other) = delete;
+  File& operator=(const File& other) = delete;
+
+  ~File() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+
+  int Descriptor() const { return fd_; }
+  const std::string& Path() const { return path_; }
+
+  uint64_t Size() const {
+    struct stat info;
+    if (::fstat(fd_, &info) != 0) {
+      throw SystemError(path_, "stat");
+    }
+    return static_cast<uint64_t>(info.st_size);
+  }
+
+  // Читает ровно size байт с позиции offset
+  void ReadAt(uint64_t offset, void* data, size_t size) const {
+    char* target = static_cast<char*>(data);
+    while (size > 0) {
+      ssize_t done = ::pread(fd_, target, size, static_cast<off_t>(offset));
+      if (done < 0 && errno == EINTR) {
+        continue;
+      }
+      if (done < 0) {
+        throw SystemError(path_, "read");
+      }
+      if (done == 0) {
+        throw std::invalid_argument("matrix file " + path_ + " is truncated");
+      }
+      target += done;
+      offset += done;
+      size -= done;
+    }
+  }
+
+  // Пишет ровно size байт с позиции offset
+  void WriteAt(uint64_t offset, const void* data, size_t size) const {
+    const char* source = static_cast<const char*>(data);
+    while (size > 0) {
+      ssize_t done = ::pwrite(fd_, source, size, static_cast<off_t>(offset));
+      if (done < 0 && errno == EINTR) {
+        continue;
+      }
+      if (done < 0) {
+        throw SystemError(path_, "write");
+      }
+      source += done;
+      offset += done;
+      size -= done;
+    }
+  }
+
+ private:
+  std::string path_;
+  int fd_ = -1;
+};
+
+inline void WriteHeader(const File& file, const FileHeader& header) {
+  char block[kPayloadAlignment] = {};
+  std::memcpy(block, &header, sizeof(header));
+  file.WriteAt(0, block, sizeof(block));
+}
+
+// Читает и проверяет заголовок: сигнатура, тип элемента и размер файла
+template <typename T>
+FileHeader ReadHeader(const File& file) {
+  FileHeader header;
+  file.ReadAt(0, &header, sizeof(header));
+  FileHeader expected = MakeHeader<T>(0, 0);
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+    throw std::invalid_argument("matrix file " + file.Path() +
+                                " has no matrix header");
+  }
+  if (header.element_size != expected.element_size ||
+      header.element_kind != expected.element_kind) {
+    throw std::invalid_argument("matrix file " + file.Path() +
+                                " holds another element type");
+  }
+  uint64_t size = file.Size();
+  uint64_t elements = header.rows * header.cols;
+  if (header.payload_offset % kPayloadAlignment != 0 ||
+      size < header.payload_offset ||
+      (header.cols != 0 && elements / header.cols != header.rows) ||
+      elements > (size - header.payload_offset) / sizeof(T)) {
+    throw std::invalid_argument("matrix file " + file.Path() +
+                                " is truncated or corrupt");
+  }
+  return header;
+}
+
+template <typename T>
+void Save(const std::string& path, size_t rows, size_t cols, const T* data) {
+  File file(path, O_WRONLY | O_CREAT | O_TRUNC);
+  WriteHeader(file, MakeHeader<T>(rows, cols));
+  file.WriteAt(kPayloadAlignment, data, rows * cols * sizeof(T));
+}
+
+inline void CheckShape(const FileHeader& header, size_t rows, size_t cols,
+                       const std::string& path) {
+  if (header.rows != rows || header.cols != cols) {
+    throw std::invalid_argument(
+        "matrix file " + path + " holds " + std::to_string(header.rows) +
+        "x" + std::to_string(header.cols) + ", expected " +
+        std::to_string(rows) + "x" + std::to_string(cols));
+  }
+}
+
+}  // namespace matrix_io
+
+// Сохраняет матрицу в двоичный файл path (см. matrix_io.hpp)
+template <size_t N, size_t M, typename T,
+          typename = matrix_io::EnableIfArithmetic<T>>
+void Save(const std::string& path, const Matrix<N, M, T>& matrix) {
+  matrix_io::Save(path, N, M, matrix.Data());
+}
+
+template <typename T, typename = matrix_io::EnableIfArithmetic<T>>
+void Save(const std::string& path, const DynMatrix<T>& matrix) {
+  matrix_io::Save(path, matrix.Rows(), matrix.Cols(), matrix.Data());
+}
+
+// Загружает матрицу N x M: данные читаются одним вызовом прямо в ее
+// хранилище, без промежуточных строк
+template <size_t N, size_t M, typename T = int64_t,
+          typename = matrix_io::EnableIfArithmetic<T>>
+Matrix<N, M, T> LoadMatrix(const std::string& path) {
+  matrix_io::File file(path, O_RDONLY);
+  matrix_io::FileHeader header = matrix_io::ReadHeader<T>(file);
+  matrix_io::CheckShape(header, N, M, path);
+  Matrix<N, M, T> matrix;
+  file.ReadAt(header.payload_offset, matrix.Data(), N * M * sizeof(T));
+  return matrix;
+}
+
+template <typename T = int64_t, typename = matrix_io::EnableIfArithmetic<T>>
+DynMatrix<T> LoadDynMatrix(const std::string& path) {
+  matrix_io::File file(path, O_RDONLY);
+  matrix_io::FileHeader header = matrix_io::ReadHeader<T>(file);
+  DynMatrix<T> matrix(header.rows, header.cols);
+  file.ReadAt(header.payload_offset, matrix.Data(),
+              header.rows * header.cols * sizeof(T));
+  return matrix;
+}
+
+// Матрица из файла, отображенного в память только для чтения: ничего
+// не копируется, страницы подгружаются ядром по мере обращения.
+// Объект владеет отображением и может только перемещаться
+template <typename T = int64_t>
+class MappedMatrix {
+ public:
+  explicit MappedMatrix(const std::string& path) {
+    matrix_io::File file(path, O_RDONLY);
+    matrix_io::FileHeader header = matrix_io::ReadHeader<T>(file);
+    rows_ = header.rows;
+    cols_ = header.cols;
+    size_ = header.payload_offset + rows_ * cols_ * sizeof(T);
+    void* address =
+        ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file.Descriptor(), 0);
+    if (address == MAP_FAILED) {
+      throw matrix_io::SystemError(path, "mmap");
+    }
+    address_ = address;
+    data_ = reinterpret_cast<const T*>(static_cast<const char*>(address) +
+                                       header.payload_offset);
+  }
+
+  MappedMatrix(MappedMatrix&& other) noexcept { Swap(other); }
+
+  MappedMatrix& operator=(MappedMatrix&& other) noexcept {
+    MappedMatrix moved(std::move(other));
+    Swap(moved);
+    return *this;
+  }
+
+  MappedMatrix(const MappedMatrix& other) = delete;
+  MappedMatrix& operator=(const MappedMatrix& other) = delete;
+
+  ~MappedMatrix() {
+    if (address_ != nullptr) {
+      ::munmap(address_, size_);
+    }
+  }
+
+  size_t Rows() const { return rows_; }
+  size_t Cols() const { return cols_; }
+
+  // Элемент (i, j) лежит по смещению i * Cols() + j
+  const T* Data() const { return data_; }
+
+  const T& operator()(size_t row, size_t col) const {
+    return data_[row * cols_ + col];
+  }
+
+  // Копия в память процесса
+  DynMatrix<T> ToDynMatrix() const {
+    DynMatrix<T> matrix(rows_, cols_);
+    std::copy(data_, data_ + rows_ * cols_, matrix.Data());
+    return matrix;
+  }
+
+  // Произведение на матрицу в памяти; левый множитель читается прямо
+  // из отображения
+  DynMatrix<T> operator*(const DynMatrix<T>& factor) const {
+    return Multiply(factor, MatrixExecutor());
+  }
+
+  DynMatrix<T> Multiply(const DynMatrix<T>& factor, ThreadPool& pool) const {
+    if (cols_ != factor.Rows()) {
+      throw std::invalid_argument(
+          "MappedMatrix: cannot multiply " + std::to_string(rows_) + "x" +
+          std::to_string(cols_) + " by " + std::to_string(factor.Rows()) +
+          "x" + std::to_string(factor.Cols()));
+    }
+    DynMatrix<T> result(rows_, factor.Cols());
+    gemm::ParallelMultiply(rows_, cols_, factor.Cols(), data_, cols_,
+                           factor.Data(), factor.Cols(), result.Data(),
+                           factor.Cols(), pool);
+    return result;
+  }
+
+ private:
+  void Swap(MappedMatrix& other) {
+    std::swap(rows_, other.rows_);
+    std::swap(cols_, other.cols_);
+    std::swap(size_, other.size_);
+    std::swap(address_, other.address_);
+    std::swap(data_, other.data_);
+  }
+
+  size_t rows_ = 0;
+  size_t cols_ = 0;
+  size_t size_ = 0;
+  void* address_ = nullptr;
+  const T* data_ = nullptr;
+};
+
+// Последовательное чтение матрицы из файла блоками по block_rows строк:
+// в памяти одновременно только один блок, так что матрица может быть
+// больше оперативной памяти
+template <typename T = int64_t>
+class MatrixRowReader {
+ public:
+  MatrixRowReader(const std::string& path, size_t block_rows)
+      : file_(path, O_RDONLY),
+        header_(matrix_io::ReadHeader<T>(file_)),
+        block_rows_(std::max<size_t>(block_rows, 1)) {
+    ::posix_fadvise(file_.Descriptor(), 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+
+  size_t Rows() const { return header_.rows; }
+  size_t Cols() const { return header_.cols; }
+
+  // Номер первой строки блока, который вернет следующий Next()
+  size_t NextRow() const { return next_row_; }
+
+  // Читает следующий блок (до block_rows строк) в block; false, если
+  // строки кончились. Блок того же размера переиспользуется
+  bool Next(DynMatrix<T>& block) {
+    if (next_row_ == Rows()) {
+      return false;
+    }
+    size_t rows = std::min(block_rows_, Rows() - next_row_);
+    if (block.Rows() != rows || block.Cols() != Cols()) {
+      block = DynMatrix<T>(rows, Cols());
+    }
+    file_.ReadAt(header_.payload_offset + next_row_ * Cols() * sizeof(T),
+                 block.Data(), rows * Cols() * sizeof(T));
+    next_row_ += rows;
+    return true;
+  }
+
+ private:
+  matrix_io::File file_;
+  matrix_io::FileHeader header_;
+  size_t block_rows_;
+  size_t next_row_ = 0;
+};
+
+// Последовательная запись матрицы rows x cols блоками строк. Пока
+// записаны не все строки, файл считается обрезанным и не загрузится
+template <typename T = int64_t>
+class MatrixRowWriter {
+ public:
+  MatrixRowWriter(const std::string& path, size_t rows, size_t cols)
+      : file_(path, O_WRONLY | O_CREAT | O_TRUNC), rows_(rows), cols_(cols) {
+    matrix_io::WriteHeader(file_, matrix_io::MakeHeader<T>(rows, cols));
+  }
+
+  // Дописывает строки block; их число не должно выйти за rows
+  void Write(const DynMatrix<T>& block) {
+    if (block.Cols() != cols_ || block.Rows() > rows_ - written_rows_) {
+      throw std::invalid_argument(
+          "MatrixRowWriter: block " + std::to_string(block.Rows()) + "x" +
+          std::to_string(block.Cols()) + " does not fit into " +
+          std::to_string(rows_) + "x" + std::to_string(cols_));
+    }
+    file_.WriteAt(matrix_io::kPayloadAlignment +
+                      written_rows_ * cols_ * sizeof(T),
+                  block.Data(), block.Rows() * cols_ * sizeof(T));
+    written_rows_ += block.Rows();
+  }
+
+  size_t WrittenRows() const { return written_rows_; }
+
+ private:
+  matrix_io::File file_;
+  size_t rows_;
+  size_t cols_;
+  size_t written_rows_ = 0;
+};
+
+// Умножение вне памяти: output := (матрица из файла input) * factor.
+// Левый множитель читается и произведение пишется блоками по block_rows
+// строк, в памяти одновременно factor и по одному блоку входа и выхода
+template <typename T = int64_t>
+void MultiplyFile(const std::string& input, const DynMatrix<T>& factor,
+                  const std::string& output, size_t block_rows,
+                  ThreadPool& pool = MatrixExecutor()) {
+  MatrixRowReader<T> reader(input, block_rows);
+  if (reader.Cols() != factor.Rows()) {
+    throw std::invalid_argument(
+        "MultiplyFile: cannot multiply " + std::to_string(reader.Rows()) +
+        "x" + std::to_string(reader.Cols()) + " by " +
+        std::to_string(factor.Rows()) + "x" + std::to_string(factor.Cols()));
+  }
+  MatrixRowWriter<T> writer(output, reader.Rows(), factor.Cols());
+  DynMatrix<T> block;
+  while (reader.Next(block)) {
+    writer.Write(block.Multiply(factor, pool));
+  }
+}
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "aligned_allocator.hpp"
+#include "gemm.hpp"
+#include "matrix.hpp"
+#include "strassen.hpp"
+#include "thread_pool.hpp"
+
+// Возведение квадратных матриц в степень и линейные рекуррентности.
+//
+// Pow(A, k) считает A^k бинарным возведением в степень: floor(log2 k)
+// возведений в квадрат и не больше стольких же умножений на A, все в двух
+// заранее выделенных буферах. PowMod делает то же по модулю для целых T.
+//
+// LinearRecurrence находит k-й член рекуррентности порядка d методом
+// Китамасы: x^k приводится по модулю характеристического многочлена,
+// это O(d^2 log k) операций вместо O(d^3 log k) у матрицы перехода.
+namespace power {
+
+// c := a * b для квадратных матриц N x N
+template <size_t N, typename T>
+void Product(const T* a, const T* b, T* c, ThreadPool& pool,
+             std::true_type /*use_strassen*/) {
+  gemm::Strassen(N, a, N, b, N, c, N, pool);
+}
+
+template <size_t N, typename T>
+void Product(const T* a, const T* b, T* c, ThreadPool& pool,
+             std::false_type /*use_strassen*/) {
+  gemm::ZeroBlock(N, N, c, N);
+  gemm::ParallelMultiply(N, N, N, a, N, b, N, c, N, pool);
+}
+
+// Строки [row_begin, row_end) произведения c := a * b mod modulus
+// матриц size x size с элементами из [0, modulus). Произведения
+// складываются в Acc, пока сумма заведомо не переполняется, потом
+// сумма приводится по модулю
+template <typename Acc, typename T>
+void MultiplyModRows(size_t row_begin, size_t row_end, size_t size,
+                     const T* a, const T* b, T* c, uint64_t modulus) {
+  Acc max_element = modulus - 1;
+  Acc max_product = max_element * max_element;
+  Acc batch = max_product == 0 ? Acc(size)
+                               : (~Acc(0) - max_element) / max_product;
+  size_t products_per_reduction =
+      std::max<size_t>(1, std::min<Acc>(batch, Acc(size)));
+  std::vector<Acc> acc(size);
+  for (size_t i = row_begin; i < row_end; i++) {
+    std::fill(acc.begin(), acc.end(), Acc(0));
+    size_t pending = 0;
+    for (size_t p = 0; p < size; p++) {
+      Acc a_value = static_cast<uint64_t>(a[i * size + p]);
+      if (a_value == 0) {
+        continue;
+      }
+      const T* b_row = b + p * size;
+      for (size_t j = 0; j < size; j++) {
+        acc[j] += a_value * static_cast<uint64_t>(b_row[j]);
+      }
+      if (++pending == products_per_reduction) {
+        for (size_t j = 0; j < size; j++) {
+          acc[j] %= modulus;
+        }
+        pending = 0;
+      }
+    }
+    for (size_t j = 0; j < size; j++) {
+      c[i * size + j] = static_cast<T>(acc[j] % modulus);
+    }
+  }
+}
+
+// c := a * b mod modulus для квадратных матриц size x size
+template <typename T>
+void MultiplyMod(size_t size, const T* a, const T* b, T* c, uint64_t modulus,
+                 ThreadPool& pool) {
+  size_t band = size * size * size < gemm::kParallelThreshold
+                    ? size
+                    : gemm::kParallelTileRows;
+  pool.ParallelFor((size + band - 1) / band, [&](size_t index) {
+    size_t begin = index * band;
+    size_t end = std::min(size, begin + band);
+    // products of residues below 2^32 fit into 64 bits
+    if (modulus <= (uint64_t(1) << 32)) {
+      MultiplyModRows<uint64_t>(begin, end, size, a, b, c, modulus);
+    } else {
+      MultiplyModRows<unsigned __int128>(begin, end, size, a, b, c, modulus);
+    }
+  });
+}
+
+// result := base^exponent для exponent > 0, base и result - size x size.
+// multiply(a, b, c) вычисляет c := a * b и не должна писать в a и b
+template <typename T, typename Multiply>
+void BinaryPower(size_t size, const T* base, uint64_t exponent, T* result,
+                 const Multiply& multiply) {
+  std::vector<T, AlignedAllocator<T>> scratch(size * size);
+  T* current = result;
+  T* next = scratch.data();
+  std::copy(base, base + size * size, current);
+  // bits from the most significant one down, the top bit is base itself
+  int bit = 63 - __builtin_clzll(exponent);
+  while (bit-- > 0) {
+    multiply(current, current, next);
+    std::swap(current, next);
+    if ((exponent >> bit) & 1) {
+      multiply(current, base, next);
+      std::swap(current, next);
+    }
+  }
+  if (current != result) {
+    std::copy(current, current + size * size, result);
+  }
+}
+
+// Обычная арифметика над T
+template <typename T>
+struct PlainArithmetic {
+  T Reduce(const T& value) const { return value; }
+  T One() const { return T(1); }
+  T MulAdd(const T& acc, const T& left, const T& right) const {
+    return acc + left * right;
+  }
+};
+
+// Арифметика вычетов по модулю modulus для целых T
+template <typename T>
+struct ModularArithmetic {
+  uint64_t modulus;
+
+  T Reduce(const T& value) const {
+    T residue = value % static_cast<T>(modulus);
+    return residue < 0 ? residue + static_cast<T>(modulus) : residue;
+  }
+  T One() const { return static_cast<T>(1 % modulus); }
+  T MulAdd(const T& acc, const T& left, const T& right) const {
+    unsigned __int128 sum = static_cast<unsigned __int128>(
+                                static_cast<uint64_t>(left)) *
+                                static_cast<uint64_t>(right) +
+                            static_cast<uint64_t>(acc);
+    return static_cast<T>(sum % modulus);
+  }
+};
+
+// k-й член рекуррентности a[n] = sum c[i] * a[n - 1 - i] методом Китамасы
+template <typename T, typename Arithmetic>
+T Kitamasa(const std::vector<T>& coefficients, const std::vector<T>& initial,
+           uint64_t index, const Arithmetic& arithmetic) {
+  if (coefficients.empty() || coefficients.size() != initial.size()) {
+    throw std::invalid_argument(
+        "LinearRecurrence: need as many initial terms as coefficients");
+  }
+  size_t order = coefficients.size();
+  if (index < order) {
+    return arithmetic.Reduce(initial[index]);
+  }
+  std::vector<T> recurrence(order);
+  for (size_t i = 0; i < order; i++) {
+    recurrence[i] = arithmetic.Reduce(coefficients[i]);
+  }
+
+  // remainder[i] - коэффициент при x^i в x^e mod f(x), где
+  // f(x) = x^order - sum c[i] * x^(order - 1 - i); изначально e = 0
+  std::vector<T> remainder(order, T());
+  std::vector<T> product(2 * order - 1);
+  remainder[0] = arithmetic.One();
+  // x^t for t >= order is replaced by sum c[i] * x^(t - 1 - i)
+  auto reduce_top = [&](std::vector<T>& poly, size_t top) {
+    for (size_t t = top; t >= order; t--) {
+      T lead = poly[t];
+      poly[t] = T();
+      for (size_t i = 0; i < order; i++) {
+        poly[t - 1 - i] =
+            arithmetic.MulAdd(poly[t - 1 - i], lead, recurrence[i]);
+      }
+    }
+  };
+  for (int bit = 63 - __builtin_clzll(index); bit >= 0; bit--) {
+    // square
+    std::fill(product.begin(), product.end(), T());
+    for (size_t i = 0; i < order; i++) {
+      for (size_t j = 0; j < order; j++) {
+        product[i + j] =
+            arithmetic.MulAdd(product[i + j], remainder[i], remainder[j]);
+      }
+    }
+    reduce_top(product, 2 * order - 2);
+    std::copy(product.begin(), product.begin() + order, remainder.begin());
+    // multiply by x
+    if ((index >> bit) & 1) {
+      remainder.insert(remainder.begin(), T());
+      reduce_top(remainder, order);
+      remainder.pop_back();
+    }
+  }
+
+  T result = arithmetic.Reduce(T());
+  for (size_t i = 0; i < order; i++) {
+    result = arithmetic.MulAdd(result, remainder[i],
+                               arithmetic.Reduce(initial[i]));
+  }
+  return result;
+}
+
+template <typename T>
+void CheckModulus(const T& modulus) {
+  if (!(modulus > 0)) {
+    throw std::invalid_argument("modulus must be positive");
+  }
+}
+
+}  // namespace power
+
+// Матрица base в степени exponent; base^0 - единичная матрица
+template <size_t N, typename T>
+Matrix<N, N, T> Pow(const Matrix<N, N, T>& base, uint64_t exponent,
+                    ThreadPool& pool = MatrixExecutor()) {
+  Matrix<N, N, T> result;
+  if (exponent == 0) {
+    for (size_t i = 0; i < N; i++) {
+      result(i, i) = T(1);
+    }
+    return result;
+  }
+  power::BinaryPower(N, base.Data(), exponent, result.Data(),
+                     [&pool](const T* a, const T* b, T* c) {
+                       power::Product<N>(a, b, c, pool,
+                                         gemm::UseStrassen<N, T>());
+                     });
+  return result;
+}
+
+// base^exponent по модулю modulus > 0; элементы результата в [0, modulus)
+template <size_t N, typename T>
+typename std::enable_if<std::is_integral<T>::value, Matrix<N, N, T>>::type
+PowMod(const Matrix<N, N, T>& base, uint64_t exponent, T modulus,
+       ThreadPool& pool = MatrixExecutor()) {
+  power::CheckModulus(modulus);
+  power::ModularArithmetic<T> arithmetic{static_cast<uint64_t>(modulus)};
+  Matrix<N, N, T> result;
+  if (exponent == 0) {
+    for (size_t i = 0; i < N; i++) {
+      result(i, i) = arithmetic.One();
+    }
+    return result;
+  }
+  Matrix<N, N, T> reduced;
+  for (size_t i = 0; i < N * N; i++) {
+    reduced.Data()[i] = arithmetic.Reduce(base.Data()[i]);
+  }
+  power::BinaryPower(N, reduced.Data(), exponent, result.Data(),
+                     [&pool, &arithmetic](const T* a, const T* b, T* c) {
+                       power::MultiplyMod(N, a, b, c, arithmetic.modulus,
+                                          pool);
+                     });
+  return result;
+}
+
+// Член a[index] рекуррентности a[n] = c[0] * a[n - 1] + ... +
+// c[d - 1] * a[n - d] с начальными членами a[0], ..., a[d - 1].
+// Например, числа Фибоначчи: LinearRecurrence<int64_t>({1, 1}, {0, 1}, k)
+template <typename T>
+T LinearRecurrence(const std::vector<T>& coefficients,
+                   const std::vector<T>& initial, uint64_t index) {
+  return power::Kitamasa(coefficients, initial, index,
+                         power::PlainArithmetic<T>());
+}
+
+// То же по модулю modulus > 0 для целых T
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value, T>::type
+LinearRecurrenceMod(const std::vector<T>& coefficients,
+                    const std::vector<T>& initial, uint64_t index,
+                    T modulus) {
+  power::CheckModulus(modulus);
+  return power::Kitamasa(
+      coefficients, initial, index,
+      power::ModularArithmetic<T>{static_cast<uint64_t>(modulus)});
+}
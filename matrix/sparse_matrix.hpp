@@ -0,0 +1,260 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "dyn_matrix.hpp"
+#include "matrix.hpp"
+
+// Умножения разреженных матриц делят строки между потоками частями
+// примерно по kSparseChunkNonZeros ненулевых элементов
+static const size_t kSparseChunkNonZeros = 1 << 14;
+
+// Разреженная матрица rows x cols в формате CSR: ненулевые элементы
+// хранятся построчно, для строки i это индексы
+// [RowOffsets()[i], RowOffsets()[i + 1]) в ColumnIndices() и Values(),
+// столбцы внутри строки возрастают. Формат CSC этой матрицы - это CSR
+// транспонированной, см. Transposed().
+//
+// Умножения делят строки между потоками MatrixExecutor() так, чтобы на
+// каждую часть приходилось примерно поровну ненулевых элементов: в
+// графах со степенным распределением строки очень неравны.
+template <typename T = int64_t>
+class SparseMatrix {
+ public:
+  // Элемент в формате COO
+  struct Entry {
+    size_t row;
+    size_t col;
+    T value;
+  };
+
+  // Пустая матрица 0 x 0
+  SparseMatrix() : row_offsets_(1, 0) {}
+
+  // Нулевая матрица rows x cols
+  SparseMatrix(size_t rows, size_t cols)
+      : rows_(rows), cols_(cols), row_offsets_(rows + 1, 0) {}
+
+  // Матрица из элементов в формате COO в любом порядке: элементы с
+  // одинаковыми координатами складываются, нулевые суммы отбрасываются
+  SparseMatrix(size_t rows, size_t cols, std::vector<Entry> entries)
+      : SparseMatrix(rows, cols) {
+    for (const Entry& entry : entries) {
+      if (entry.row >= rows_ || entry.col >= cols_) {
+        throw std::invalid_argument("SparseMatrix: entry (" +
+                                    std::to_string(entry.row) + ", " +
+                                    std::to_string(entry.col) +
+                                    ") is outside " + Shape());
+      }
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry& left, const Entry& right) {
+                return left.row != right.row ? left.row < right.row
+                                             : left.col < right.col;
+              });
+    for (size_t i = 0; i < entries.size();) {
+      Entry sum = entries[i];
+      for (i++; i < entries.size() && entries[i].row == sum.row &&
+                entries[i].col == sum.col;
+           i++) {
+        sum.value += entries[i].value;
+      }
+      if (!(sum.value == T())) {
+        row_offsets_[sum.row + 1]++;
+        col_indices_.push_back(sum.col);
+        values_.push_back(sum.value);
+      }
+    }
+    for (size_t row = 0; row < rows_; row++) {
+      row_offsets_[row + 1] += row_offsets_[row];
+    }
+  }
+
+  // Ненулевые элементы плотной матрицы
+  template <size_t N, size_t M>
+  explicit SparseMatrix(const Matrix<N, M, T>& dense)
+      : SparseMatrix(N, M) {
+    FromDense(dense.Data());
+  }
+
+  explicit SparseMatrix(const DynMatrix<T>& dense)
+      : SparseMatrix(dense.Rows(), dense.Cols()) {
+    FromDense(dense.Data());
+  }
+
+  size_t Rows() const { return rows_; }
+  size_t Cols() const { return cols_; }
+  size_t NonZeros() const { return values_.size(); }
+
+  const std::vector<size_t>& RowOffsets() const { return row_offsets_; }
+  const std::vector<size_t>& ColumnIndices() const { return col_indices_; }
+  const std::vector<T>& Values() const { return values_; }
+
+  // Элемент (row, col), T() для отсутствующих; O(log) по длине строки
+  T operator()(size_t row, size_t col) const {
+    auto begin = col_indices_.begin() + row_offsets_[row];
+    auto end = col_indices_.begin() + row_offsets_[row + 1];
+    auto found = std::lower_bound(begin, end, col);
+    if (found == end || *found != col) {
+      return T();
+    }
+    return values_[found - col_indices_.begin()];
+  }
+
+  // Плотная копия
+  DynMatrix<T> ToDense() const {
+    DynMatrix<T> dense(rows_, cols_);
+    for (size_t row = 0; row < rows_; row++) {
+      for (size_t i = row_offsets_[row]; i < row_offsets_[row + 1]; i++) {
+        dense(row, col_indices_[i]) = values_[i];
+      }
+    }
+    return dense;
+  }
+
+  // Транспонированная матрица (она же CSC исходной) сортировкой
+  // подсчетом по столбцам, O(rows + cols + NonZeros())
+  SparseMatrix Transposed() const {
+    SparseMatrix transposed(cols_, rows_);
+    std::vector<size_t>& offsets = transposed.row_offsets_;
+    for (size_t col : col_indices_) {
+      offsets[col + 1]++;
+    }
+    for (size_t col = 0; col < cols_; col++) {
+      offsets[col + 1] += offsets[col];
+    }
+    transposed.col_indices_.resize(NonZeros());
+    transposed.values_.resize(NonZeros());
+    std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+    // rows are visited in order, so every column of the result is sorted
+    for (size_t row = 0; row < rows_; row++) {
+      for (size_t i = row_offsets_[row]; i < row_offsets_[row + 1]; i++) {
+        size_t position = next[col_indices_[i]]++;
+        transposed.col_indices_[position] = row;
+        transposed.values_[position] = values_[i];
+      }
+    }
+    return transposed;
+  }
+
+  // Умножение на вектор (SpMV); размер vector должен быть Cols()
+  std::vector<T> operator*(const std::vector<T>& vector) const {
+    if (vector.size() != cols_) {
+      throw std::invalid_argument("SparseMatrix: cannot multiply " + Shape() +
+                                  " by vector of size " +
+                                  std::to_string(vector.size()));
+    }
+    std::vector<T> result(rows_);
+    ForEachRowChunk([&](size_t row_begin, size_t row_end) {
+      for (size_t row = row_begin; row < row_end; row++) {
+        T sum = T();
+        for (size_t i = row_offsets_[row]; i < row_offsets_[row + 1]; i++) {
+          sum += values_[i] * vector[col_indices_[i]];
+        }
+        result[row] = sum;
+      }
+    });
+    return result;
+  }
+
+  // Умножение на плотную матрицу (SpMM): каждая строка результата -
+  // сумма строк dense с весами из строки разреженной матрицы
+  DynMatrix<T> operator*(const DynMatrix<T>& dense) const {
+    if (dense.Rows() != cols_) {
+      throw std::invalid_argument(
+          "SparseMatrix: cannot multiply " + Shape() + " by " +
+          std::to_string(dense.Rows()) + "x" + std::to_string(dense.Cols()));
+    }
+    size_t width = dense.Cols();
+    DynMatrix<T> result(rows_, width);
+    const T* source = dense.Data();
+    T* target = result.Data();
+    ForEachRowChunk([&](size_t row_begin, size_t row_end) {
+      for (size_t row = row_begin; row < row_end; row++) {
+        T* target_row = target + row * width;
+        for (size_t i = row_offsets_[row]; i < row_offsets_[row + 1]; i++) {
+          const T& value = values_[i];
+          const T* source_row = source + col_indices_[i] * width;
+          for (size_t j = 0; j < width; j++) {
+            target_row[j] += value * source_row[j];
+          }
+        }
+      }
+    });
+    return result;
+  }
+
+  template <size_t N, size_t M>
+  DynMatrix<T> operator*(const Matrix<N, M, T>& dense) const {
+    return *this * DynMatrix<T>(dense);
+  }
+
+  // Оператор проверки на равенство (сравниваются и размеры)
+  bool operator==(const SparseMatrix& to_cmp) const {
+    return rows_ == to_cmp.rows_ && cols_ == to_cmp.cols_ &&
+           row_offsets_ == to_cmp.row_offsets_ &&
+           col_indices_ == to_cmp.col_indices_ && values_ == to_cmp.values_;
+  }
+
+  bool operator!=(const SparseMatrix& to_cmp) const {
+    return !(*this == to_cmp);
+  }
+
+ private:
+  std::string Shape() const {
+    return std::to_string(rows_) + "x" + std::to_string(cols_);
+  }
+
+  void FromDense(const T* data) {
+    for (size_t row = 0; row < rows_; row++) {
+      for (size_t col = 0; col < cols_; col++) {
+        const T& value = data[row * cols_ + col];
+        if (!(value == T())) {
+          col_indices_.push_back(col);
+          values_.push_back(value);
+        }
+      }
+      row_offsets_[row + 1] = values_.size();
+    }
+  }
+
+  // Вызывает apply(row_begin, row_end) на частях строк с примерно
+  // равным числом ненулевых элементов, больше одной части - в потоках
+  template <typename Apply>
+  void ForEachRowChunk(const Apply& apply) const {
+    size_t chunks = std::min(rows_, NonZeros() / kSparseChunkNonZeros);
+    if (chunks <= 1) {
+      apply(0, rows_);
+      return;
+    }
+    // first row whose non-zeros start at or after chunk * NonZeros() / chunks
+    auto chunk_begin = [this, chunks](size_t chunk) {
+      if (chunk == chunks) {
+        return rows_;
+      }
+      size_t target = NonZeros() / chunks * chunk;
+      return static_cast<size_t>(std::lower_bound(row_offsets_.begin(),
+                                                  row_offsets_.end() - 1,
+                                                  target) -
+                                 row_offsets_.begin());
+    };
+    MatrixExecutor().ParallelFor(chunks, [&](size_t chunk) {
+      size_t row_begin = chunk_begin(chunk);
+      size_t row_end = chunk_begin(chunk + 1);
+      if (row_begin < row_end) {
+        apply(row_begin, row_end);
+      }
+    });
+  }
+
+  size_t rows_ = 0;
+  size_t cols_ = 0;
+  std::vector<size_t> row_offsets_;
+  std::vector<size_t> col_indices_;
+  std::vector<T> values_;
+};
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "aligned_allocator.hpp"
+#include "gemm.hpp"
+#include "thread_pool.hpp"
+
+// Быстрое умножение квадратных матриц по схеме Штрассена-Винограда:
+// 7 умножений и 15 сложений блоков половинного размера на каждом уровне.
+// Для точных типов (целые, BigInt) результат совпадает с обычным
+// умножением; для float и double схема не используется, так как
+// она хуже по погрешности.
+namespace gemm {
+
+// Размер, начиная с которого выгодна рекурсия. Для арифметических типов
+// блоки меньше кратно быстрее считаются упакованным ядром, для тяжелых
+// типов (BigInt) умножение элементов дороже сложения уже на малых размерах.
+template <typename T>
+struct StrassenCutoff {
+  static const size_t kValue = std::is_arithmetic<T>::value ? 512 : 64;
+};
+
+// Применять ли схему к квадратной матрице N x N
+template <size_t N, typename T>
+struct UseStrassen
+    : std::integral_constant<bool, !std::is_floating_point<T>::value &&
+                                       N >= StrassenCutoff<T>::kValue> {};
+
+// c := a + b для блоков size x size. Сумма строится прямо в c
+// (копия a и +=), так что у тяжелых T буфер элемента c переиспользуется;
+// c может совпадать с a или b
+template <typename T>
+void AddBlocks(size_t size, const T* a, size_t lda, const T* b, size_t ldb,
+               T* c, size_t ldc) {
+  if (c == b && ldc == ldb) {
+    std::swap(a, b);
+    std::swap(lda, ldb);
+  }
+  for (size_t i = 0; i < size; i++) {
+    for (size_t j = 0; j < size; j++) {
+      T& target = c[i * ldc + j];
+      target = a[i * lda + j];
+      target += b[i * ldb + j];
+    }
+  }
+}
+
+// c := a - b для блоков size x size; c может совпадать с a или b
+template <typename T>
+void SubBlocks(size_t size, const T* a, size_t lda, const T* b, size_t ldb,
+               T* c, size_t ldc) {
+  bool in_b = c == b && ldc == ldb;
+  for (size_t i = 0; i < size; i++) {
+    for (size_t j = 0; j < size; j++) {
+      T& target = c[i * ldc + j];
+      if (in_b) {
+        target = a[i * lda + j] - target;
+      } else {
+        target = a[i * lda + j];
+        target -= b[i * ldb + j];
+      }
+    }
+  }
+}
+
+// c += a для блоков size x size
+template <typename T>
+void AccumulateBlock(size_t size, const T* a, size_t lda, T* c, size_t ldc) {
+  for (size_t i = 0; i < size; i++) {
+    for (size_t j = 0; j < size; j++) {
+      c[i * ldc + j] += a[i * lda + j];
+    }
+  }
+}
+
+// c -= a для блоков size x size
+template <typename T>
+void SubtractBlock(size_t size, const T* a, size_t lda, T* c, size_t ldc) {
+  for (size_t i = 0; i < size; i++) {
+    for (size_t j = 0; j < size; j++) {
+      c[i * ldc + j] -= a[i * lda + j];
+    }
+  }
+}
+
+// c := 0 для блока rows x cols
+template <typename T>
+void ZeroBlock(size_t rows, size_t cols, T* c, size_t ldc) {
+  for (size_t i = 0; i < rows; i++) {
+    std::fill(c + i * ldc, c + i * ldc + cols, T());
+  }
+}
+
+// C := A * B для квадратных матриц size x size
+template <typename T>
+void Strassen(size_t size, const T* a, size_t lda, const T* b, size_t ldb,
+              T* c, size_t ldc, ThreadPool& pool) {
+  if (size < StrassenCutoff<T>::kValue) {
+    ZeroBlock(size, size, c, ldc);
+    ParallelMultiply(size, size, size, a, lda, b, ldb, c, ldc, pool);
+    return;
+  }
+  if (size % 2 == 1) {
+    // peel the last row and column off, the rest has even size
+    size_t even = size - 1;
+    Strassen(even, a, lda, b, ldb, c, ldc, pool);
+    Multiply(even, 1, even, a + even, lda, b + even * ldb, ldb, c, ldc);
+    ZeroBlock(size, 1, c + even, ldc);
+    Multiply(size, size, 1, a, lda, b + even, ldb, c + even, ldc);
+    ZeroBlock(1, even, c + even * ldc, ldc);
+    Multiply(1, size, even, a + even * lda, lda, b, ldb, c + even * ldc, ldc);
+    return;
+  }
+
+  size_t half = size / 2;
+  const T* a11 = a;
+  const T* a12 = a + half;
+  const T* a21 = a + half * lda;
+  const T* a22 = a21 + half;
+  const T* b11 = b;
+  const T* b12 = b + half;
+  const T* b21 = b + half * ldb;
+  const T* b22 = b21 + half;
+  T* c11 = c;
+  T* c12 = c + half;
+  T* c21 = c + half * ldc;
+  T* c22 = c21 + half;
+
+  // three scratch blocks, the quadrants of C hold the other products
+  std::vector<T, AlignedAllocator<T>> scratch(3 * half * half);
+  T* x = scratch.data();
+  T* y = x + half * half;
+  T* p = y + half * half;
+
+  SubBlocks(half, a11, lda, a21, lda, x, half);  // S3
+  SubBlocks(half, b22, ldb, b12, ldb, y, half);  // T3
+  Strassen(half, x, half, y, half, c21, ldc, pool);  // M7
+  AddBlocks(half, a21, lda, a22, lda, x, half);  // S1
+  SubBlocks(half, b12, ldb, b11, ldb, y, half);  // T1
+  Strassen(half, x, half, y, half, c22, ldc, pool);  // M5
+  SubBlocks(half, x, half, a11, lda, x, half);  // S2
+  SubBlocks(half, b22, ldb, y, half, y, half);  // T2
+  Strassen(half, x, half, y, half, c12, ldc, pool);  // M6
+  Strassen(half, a11, lda, b11, ldb, p, half, pool);  // M1
+
+  AccumulateBlock(half, p, half, c12, ldc);    // U2 = M1 + M6
+  AccumulateBlock(half, c12, ldc, c21, ldc);   // U3 = U2 + M7
+  AccumulateBlock(half, c22, ldc, c12, ldc);   // U4 = U2 + M5
+  AccumulateBlock(half, c21, ldc, c22, ldc);   // C22 = U3 + M5
+
+  SubBlocks(half, a12, lda, x, half, x, half);  // S4
+  Strassen(half, x, half, b22, ldb, c11, ldc, pool);  // M3
+  AccumulateBlock(half, c11, ldc, c12, ldc);  // C12 = U4 + M3
+
+  SubBlocks(half, y, half, b21, ldb, y, half);  // T4
+  Strassen(half, a22, lda, y, half, c11, ldc, pool);  // M4
+  SubtractBlock(half, c11, ldc, c21, ldc);  // C21 = U3 - M4
+
+  Strassen(half, a12, lda, b21, ldb, c11, ldc, pool);  // M2
+  AccumulateBlock(half, p, half, c11, ldc);  // C11 = M1 + M2
+}
+
+}  // namespace gemm
@@ -0,0 +1,1081 @@
+#include "dyn_matrix.hpp"
+#include "matrix.hpp"
+#include "matrix_batch.hpp"
+#include "matrix_io.hpp"
+#include "power.hpp"
+#include "sparse_matrix.hpp"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+template <size_t N>
+Matrix<N, N> Numbered() {
+  Matrix<N, N> matrix;
+  for (size_t i = 0; i < N; ++i) {
+    for (size_t j = 0; j < N; ++j) {
+      matrix(i, j) = static_cast<int64_t>(i * N + j);
+    }
+  }
+  return matrix;
+}
+
+// entries in [-9, 9]
+template <size_t N, size_t M, typename T = int64_t>
+Matrix<N, M, T> Random(std::mt19937_64& random) {
+  std::uniform_int_distribution<int> entry(-9, 9);
+  Matrix<N, M, T> matrix;
+  for (size_t i = 0; i < N; ++i) {
+    for (size_t j = 0; j < M; ++j) {
+      matrix(i, j) = static_cast<T>(entry(random));
+    }
+  }
+  return matrix;
+}
+
+template <size_t N, size_t M, typename T>
+void ExpectNear(const Matrix<N, M, T>& actual, const Matrix<N, M, T>& expected,
+                T tolerance) {
+  for (size_t i = 0; i < N; ++i) {
+    for (size_t j = 0; j < M; ++j) {
+      ASSERT_NEAR(actual(i, j), expected(i, j), tolerance) << i << " " << j;
+    }
+  }
+}
+
+TEST(Expression, ResultAsMatrix) {
+  Matrix<3, 3> a = Numbered<3>();
+  Matrix<3, 3> b(2);
+  Matrix<3, 2> c(1);
+  Matrix<3, 3> sum = a;
+  sum += b;
+  Matrix<3, 3> difference = a;
+  difference -= b;
+  Matrix<3, 3> twice = a;
+  twice *= 2;
+
+  ASSERT_TRUE((a + b) * c == sum * c);
+  ASSERT_TRUE((a + b).Transposed() == sum.Transposed());
+  ASSERT_EQ((a - b).Trace(), difference.Trace());
+  ASSERT_EQ((a + b).Determinant(), sum.Determinant());
+  ASSERT_TRUE((a * 2) * a == twice * a);
+  ASSERT_TRUE(a * (a - b) == a * difference);
+  ASSERT_TRUE((a - b) * (a + b) == difference * sum);
+  ASSERT_EQ((a + b)(1, 2), sum(1, 2));
+}
+
+TEST(Expression, ChangeStoredResult) {
+  Matrix<3, 3> a = Numbered<3>();
+  Matrix<3, 3> b(2);
+  Matrix<3, 3> expected = a;
+  expected += b;
+  expected(0, 0) = 5;
+
+  auto s = a + b;
+  s(0, 0) = 5;
+  ASSERT_EQ(s(0, 0), 5);
+  ASSERT_TRUE(s == expected);
+  // the value is kept apart from the operands
+  a(1, 1) = 100;
+  ASSERT_TRUE(s == expected);
+  auto copy = s;
+  copy(0, 1) = -1;
+  ASSERT_TRUE(s == expected);
+
+  s += b;
+  s *= 3;
+  expected += b;
+  expected *= 3;
+  ASSERT_TRUE(s == expected);
+  Matrix<3, 3> evaluated = s;
+  ASSERT_TRUE(evaluated == expected);
+
+  auto t = b * 2;
+  t = a;
+  ASSERT_TRUE(t == a);
+}
+
+TEST(Expression, KeepsTemporaryOperands) {
+  Matrix<3, 3> a = Numbered<3>();
+  auto e = a + Matrix<3, 3>(7);
+  auto f = Matrix<100, 100>(1) * 3 - Numbered<100>().Transposed();
+  Matrix<3, 3> expected(7);
+  expected += a;
+  ASSERT_TRUE(e == expected);
+  Matrix<100, 100> g = f;
+  ASSERT_EQ(g(2, 1), 3 - 102);
+  ASSERT_EQ(f(2, 1), 3 - 102);
+}
+
+TEST(TransposedView, AssignToSource) {
+  Matrix<3, 3> a = Numbered<3>();
+  Matrix<3, 3> expected = a.Transposed();
+  a = a.TransposedView();
+  ASSERT_TRUE(a == expected);
+
+  Matrix<100, 100> big = Numbered<100>();
+  Matrix<100, 100> big_expected = big.Transposed();
+  big = big.TransposedView();
+  ASSERT_TRUE(big == big_expected);
+}
+
+TEST(TransposedView, AddAndSubtractToSource) {
+  Matrix<100, 100> a = Numbered<100>();
+  Matrix<100, 100> expected = a + a.Transposed();
+  a += a.TransposedView();
+  ASSERT_TRUE(a == expected);
+
+  Matrix<3, 3> b = Numbered<3>();
+  Matrix<3, 3> b_expected = b - b.Transposed() * 2;
+  b -= b.TransposedView() * 2;
+  ASSERT_TRUE(b == b_expected);
+}
+
+TEST(TransposedView, ExpressionWithSource) {
+  Matrix<3, 3> a = Numbered<3>();
+  Matrix<3, 3> expected = a + a.Transposed();
+  a = a + a.TransposedView();
+  ASSERT_TRUE(a == expected);
+}
+
+TEST(ThreadPool, EveryIndexOnce) {
+  ThreadPool pool(4);
+  for (size_t count : {0, 1, 2, 3, 5, 1000}) {
+    std::vector<std::atomic<int>> seen(count);
+    // the first indices are much slower, so the other threads steal them
+    pool.ParallelFor(count, [&seen, count](size_t index) {
+      if (index < count / 4) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+      }
+      seen[index]++;
+    });
+    for (size_t index = 0; index < count; ++index) {
+      ASSERT_EQ(seen[index].load(), 1) << count << " " << index;
+    }
+  }
+}
+
+TEST(ThreadPool, NestedCall) {
+  ThreadPool pool(3);
+  std::vector<std::atomic<int>> seen(20 * 30);
+  pool.ParallelFor(20, [&](size_t outer) {
+    std::thread::id thread = std::this_thread::get_id();
+    // runs on the thread of the task, in order
+    size_t next = 0;
+    pool.ParallelFor(30, [&](size_t inner) {
+      ASSERT_EQ(std::this_thread::get_id(), thread);
+      ASSERT_EQ(inner, next++);
+      seen[outer * 30 + inner]++;
+    });
+  });
+  for (size_t index = 0; index < seen.size(); ++index) {
+    ASSERT_EQ(seen[index].load(), 1) << index;
+  }
+  // and the pool is free again for the outer level
+  std::atomic<size_t> sum(0);
+  pool.ParallelFor(100, [&sum](size_t index) { sum += index; });
+  ASSERT_EQ(sum.load(), 4950u);
+}
+
+TEST(ThreadPool, ExceptionFromBody) {
+  ThreadPool pool(4);
+  std::thread::id caller = std::this_thread::get_id();
+  // the caller is slow, so the other threads get indices and throw
+  auto body = [caller](size_t /*index*/) {
+    if (std::this_thread::get_id() != caller) {
+      throw std::runtime_error("body");
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  };
+  ASSERT_THROW(pool.ParallelFor(100, body), std::runtime_error);
+
+  // the pool stays usable and the caller is not left marked as a worker
+  std::mutex mutex;
+  std::set<std::thread::id> threads;
+  std::vector<int> seen(100, 0);
+  pool.ParallelFor(seen.size(), [&](size_t index) {
+    seen[index]++;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      threads.insert(std::this_thread::get_id());
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  });
+  ASSERT_EQ(std::count(seen.begin(), seen.end(), 1), 100);
+  ASSERT_GT(threads.size(), 1u);
+}
+
+TEST(Linalg, Determinant) {
+  const int64_t entries[3][3] = {{6, 1, 1}, {4, -2, 5}, {2, 8, 7}};
+  Matrix<3, 3> small;
+  Matrix<3, 3, double> small_double;
+  for (size_t i = 0; i < 3; ++i) {
+    for (size_t j = 0; j < 3; ++j) {
+      small(i, j) = entries[i][j];
+      small_double(i, j) = static_cast<double>(entries[i][j]);
+    }
+  }
+  ASSERT_EQ(small.Determinant(), -306);
+  ASSERT_NEAR(small_double.Determinant(), -306.0, 1e-9);
+
+  // upper triangular with 2 on four diagonal entries and 1 on the rest,
+  // then the rows 0 and 1 swapped: the determinant is -2^4
+  Matrix<40, 40> large;
+  Matrix<40, 40, double> large_double;
+  std::mt19937_64 random(39);
+  for (size_t i = 0; i < 40; ++i) {
+    for (size_t j = i; j < 40; ++j) {
+      large(i, j) = static_cast<int64_t>(random() % 7) - 3;
+    }
+    large(i, i) = i % 10 == 0 ? 2 : 1;
+  }
+  for (size_t j = 0; j < 40; ++j) {
+    std::swap(large(0, j), large(1, j));
+  }
+  for (size_t i = 0; i < 40; ++i) {
+    for (size_t j = 0; j < 40; ++j) {
+      large_double(i, j) = static_cast<double>(large(i, j));
+    }
+  }
+  ASSERT_EQ(large.Determinant(), -16);
+  ASSERT_NEAR(large_double.Determinant(), -16.0, 1e-6);
+
+  Matrix<3, 3> singular = Numbered<3>();
+  ASSERT_EQ(singular.Determinant(), 0);
+}
+
+template <size_t N>
+void ExpectInverse(std::mt19937_64& random) {
+  // diagonally dominant, so far from singular
+  Matrix<N, N, double> a = Random<N, N, double>(random);
+  Matrix<N, N, double> identity;
+  for (size_t i = 0; i < N; ++i) {
+    a(i, i) += 10.0 * N;
+    identity(i, i) = 1.0;
+  }
+  ExpectNear(Matrix<N, N, double>(a * a.Inverse()), identity, 1e-9);
+  Matrix<N, 2, double> b = Random<N, 2, double>(random);
+  ExpectNear(Matrix<N, 2, double>(a * a.Solve(b)), b, 1e-9);
+}
+
+TEST(Linalg, Inverse) {
+  std::mt19937_64 random(39);
+  // unrolled, one panel and several panels of the blocked LU
+  ExpectInverse<3>(random);
+  ExpectInverse<8>(random);
+  ExpectInverse<20>(random);
+  ExpectInverse<70>(random);
+}
+
+TEST(Linalg, Singular) {
+  Matrix<3, 3, double> small;
+  Matrix<40, 40, double> large;
+  for (size_t i = 0; i < 3; ++i) {
+    for (size_t j = 0; j < 3; ++j) {
+      small(i, j) = static_cast<double>(i * 3 + j);
+    }
+  }
+  std::mt19937_64 random(39);
+  large = Random<40, 40, double>(random);
+  // the column in the second panel stays exactly zero during elimination
+  for (size_t i = 0; i < 40; ++i) {
+    large(i, 35) = 0.0;
+  }
+  ASSERT_EQ(small.Determinant(), 0.0);
+  ASSERT_THROW(small.Inverse(), std::invalid_argument);
+  ASSERT_THROW(small.Solve(Matrix<3, 1, double>(1.0)), std::invalid_argument);
+  ASSERT_THROW(large.Inverse(), std::invalid_argument);
+  ASSERT_THROW((Matrix<4, 4, double>().Inverse()), std::invalid_argument);
+}
+
+TEST(Linalg, Cholesky) {
+  std::mt19937_64 random(39);
+  Matrix<12, 12, double> factor = Random<12, 12, double>(random);
+  for (size_t i = 0; i < 12; ++i) {
+    factor(i, i) = 12.0;
+  }
+  Matrix<12, 12, double> a = factor * factor.Transposed();
+  Matrix<12, 12, double> lower = a.Cholesky();
+  for (size_t i = 0; i < 12; ++i) {
+    for (size_t j = i + 1; j < 12; ++j) {
+      ASSERT_EQ(lower(i, j), 0.0);
+    }
+  }
+  ExpectNear(Matrix<12, 12, double>(lower * lower.Transposed()), a, 1e-9);
+  Matrix<12, 1, double> b = Random<12, 1, double>(random);
+  ExpectNear(Matrix<12, 1, double>(a * a.SolvePositiveDefinite(b)), b, 1e-9);
+
+  // symmetric, but with eigenvalues -1 and 3
+  Matrix<2, 2, double> indefinite(1.0);
+  indefinite(0, 1) = 2.0;
+  indefinite(1, 0) = 2.0;
+  ASSERT_THROW(indefinite.Cholesky(), std::invalid_argument);
+  a(5, 5) = -1.0;
+  ASSERT_THROW(a.Cholesky(), std::invalid_argument);
+  ASSERT_THROW(a.SolvePositiveDefinite(b), std::invalid_argument);
+}
+
+// c := a * b by the definition; a is rows x inner, b is inner x cols
+template <typename T>
+std::vector<T> NaiveProduct(size_t rows, size_t inner, size_t cols,
+                            const std::vector<T>& a, const std::vector<T>& b) {
+  std::vector<T> c(rows * cols);
+  for (size_t i = 0; i < rows; ++i) {
+    for (size_t j = 0; j < cols; ++j) {
+      T sum = T();
+      for (size_t k = 0; k < inner; ++k) {
+        sum += a[i * inner + k] * b[k * cols + j];
+      }
+      c[i * cols + j] = sum;
+    }
+  }
+  return c;
+}
+
+// the integer entries keep double sums exact, so both types compare equal
+template <typename T>
+void ExpectGemm(size_t rows, size_t inner, size_t cols, ThreadPool& pool) {
+  std::mt19937_64 random(rows * 10007 + inner * 101 + cols);
+  std::uniform_int_distribution<int> entry(-9, 9);
+  std::vector<T> a(rows * inner);
+  std::vector<T> b(inner * cols);
+  for (T& value : a) {
+    value = static_cast<T>(entry(random));
+  }
+  for (T& value : b) {
+    value = static_cast<T>(entry(random));
+  }
+  std::vector<T> expected = NaiveProduct(rows, inner, cols, a, b);
+
+  std::vector<T> c(rows * cols, T(1));
+  gemm::Multiply(rows, inner, cols, a.data(), inner, b.data(), cols, c.data(),
+                 cols);
+  for (size_t i = 0; i < c.size(); ++i) {
+    ASSERT_EQ(c[i], expected[i] + T(1)) << rows << " " << inner << " " << cols;
+  }
+  std::fill(c.begin(), c.end(), T());
+  gemm::ParallelMultiply(rows, inner, cols, a.data(), inner, b.data(), cols,
+                         c.data(), cols, pool);
+  ASSERT_TRUE(c == expected) << rows << " " << inner << " " << cols;
+
+  // a and b stored transposed and read through strides
+  std::vector<T> a_columns(a.size());
+  std::vector<T> b_columns(b.size());
+  for (size_t i = 0; i < rows; ++i) {
+    for (size_t k = 0; k < inner; ++k) {
+      a_columns[k * rows + i] = a[i * inner + k];
+    }
+  }
+  for (size_t k = 0; k < inner; ++k) {
+    for (size_t j = 0; j < cols; ++j) {
+      b_columns[j * inner + k] = b[k * cols + j];
+    }
+  }
+  std::fill(c.begin(), c.end(), T());
+  gemm::Multiply(rows, inner, cols, gemm::Strided<T>{a_columns.data(), 1, rows},
+                 gemm::Strided<T>{b_columns.data(), 1, inner}, c.data(), cols);
+  ASSERT_TRUE(c == expected) << rows << " " << inner << " " << cols;
+}
+
+template <typename T>
+void ExpectGemmSizes() {
+  ThreadPool pool(3);
+  // below the packing threshold, exactly at it, just above it with edge
+  // tiles on every side, across the cache blocks and above the parallel
+  // threshold
+  ExpectGemm<T>(1, 1, 1, pool);
+  ExpectGemm<T>(5, 7, 9, pool);
+  ExpectGemm<T>(31, 33, 31, pool);
+  ExpectGemm<T>(32, 32, 32, pool);
+  ExpectGemm<T>(33, 35, 37, pool);
+  ExpectGemm<T>(7, 1000, 5, pool);
+  ExpectGemm<T>(97, 259, 61, pool);
+  ExpectGemm<T>(13, 17, 1031, pool);
+  ExpectGemm<T>(131, 129, 263, pool);
+}
+
+TEST(Gemm, Int64) { ExpectGemmSizes<int64_t>(); }
+
+TEST(Gemm, Double) { ExpectGemmSizes<double>(); }
+
+TEST(Gemm, MatrixProduct) {
+  std::mt19937_64 random(32);
+  Matrix<37, 35> a = Random<37, 35>(random);
+  Matrix<35, 33> b = Random<35, 33>(random);
+  Matrix<37, 33> product = a * b;
+  Matrix<130, 129, double> c = Random<130, 129, double>(random);
+  Matrix<129, 131, double> d = Random<129, 131, double>(random);
+  Matrix<130, 131, double> large_product = c * d;
+  Matrix<130, 131, double> transposed_product =
+      c.Transposed().Transposed() * d;
+  for (size_t i = 0; i < 37; ++i) {
+    for (size_t j = 0; j < 33; ++j) {
+      int64_t sum = 0;
+      for (size_t k = 0; k < 35; ++k) {
+        sum += a(i, k) * b(k, j);
+      }
+      ASSERT_EQ(product(i, j), sum);
+    }
+  }
+  for (size_t i = 0; i < 130; ++i) {
+    for (size_t j = 0; j < 131; ++j) {
+      double sum = 0;
+      for (size_t k = 0; k < 129; ++k) {
+        sum += c(i, k) * d(k, j);
+      }
+      ASSERT_EQ(large_product(i, j), sum);
+      ASSERT_EQ(transposed_product(i, j), sum);
+    }
+  }
+}
+
+TEST(DynMatrix, ShapeErrors) {
+  DynMatrix<int64_t> a(2, 3, 1);
+  DynMatrix<int64_t> b(3, 2, 1);
+  ASSERT_THROW(a += b, std::invalid_argument);
+  ASSERT_THROW(a -= b, std::invalid_argument);
+  ASSERT_THROW(a + b, std::invalid_argument);
+  ASSERT_THROW(a * a, std::invalid_argument);
+  ASSERT_THROW(a *= a, std::invalid_argument);
+  ASSERT_THROW(a.Trace(), std::invalid_argument);
+  ASSERT_THROW((a.ToMatrix<3, 2>()), std::invalid_argument);
+  ASSERT_THROW((std::move(a).ToMatrix<3, 2>()), std::invalid_argument);
+  // a failed move leaves the matrix as it was
+  ASSERT_EQ(a.Rows(), 2u);
+  ASSERT_EQ(a.Cols(), 3u);
+  ASSERT_TRUE(a == DynMatrix<int64_t>(2, 3, 1));
+  ASSERT_THROW(DynMatrix<int64_t>({{1, 2}, {3}}), std::invalid_argument);
+
+  DynMatrix<int64_t> product = a * b;
+  ASSERT_TRUE(product == DynMatrix<int64_t>(2, 2, 3));
+  ASSERT_EQ(product.Trace(), 6);
+  ASSERT_TRUE(a != b);
+}
+
+TEST(DynMatrix, MoveFromMatrix) {
+  // 40 x 40 int64_t is stored on the heap, 3 x 3 inside the object
+  Matrix<40, 40> large = Numbered<40>();
+  const int64_t* data = large.Data();
+  DynMatrix<int64_t> adopted(std::move(large));
+  ASSERT_EQ(adopted.Data(), data);
+  ASSERT_EQ(adopted.Rows(), 40u);
+  ASSERT_TRUE(adopted == DynMatrix<int64_t>(Numbered<40>()));
+  large = Numbered<40>();
+  ASSERT_TRUE(large == Numbered<40>());
+
+  Matrix<3, 3> small = Numbered<3>();
+  DynMatrix<int64_t> copied(std::move(small));
+  ASSERT_EQ(copied(2, 1), 7);
+
+  Matrix<40, 40> back = std::move(adopted).ToMatrix<40, 40>();
+  ASSERT_EQ(back.Data(), data);
+  ASSERT_TRUE(back == Numbered<40>());
+  ASSERT_EQ(adopted.Rows(), 0u);
+  ASSERT_EQ(adopted.Cols(), 0u);
+  ASSERT_TRUE(adopted == DynMatrix<int64_t>());
+
+  Matrix<3, 3> small_back = std::move(copied).ToMatrix<3, 3>();
+  ASSERT_TRUE(small_back == Numbered<3>());
+  ASSERT_TRUE(copied == DynMatrix<int64_t>());
+  ASSERT_TRUE((DynMatrix<int64_t>(Numbered<3>()).ToMatrix<3, 3>() ==
+               Numbered<3>()));
+}
+
+// Strassen on blocks with row strides wider than the block, against the
+// classic product
+void ExpectStrassen(size_t size, ThreadPool& pool) {
+  const size_t stride = size + 3;
+  std::mt19937_64 random(size);
+  std::uniform_int_distribution<int64_t> entry(-1000, 1000);
+  std::vector<int64_t> a(size * stride);
+  std::vector<int64_t> b(size * stride);
+  for (size_t i = 0; i < a.size(); ++i) {
+    a[i] = entry(random);
+    b[i] = entry(random);
+  }
+  std::vector<int64_t> expected(size * size);
+  gemm::Multiply(size, size, size, a.data(), stride, b.data(), stride,
+                 expected.data(), size);
+  std::vector<int64_t> c(size * stride, -1);
+  gemm::Strassen(size, a.data(), stride, b.data(), stride, c.data(), stride,
+                 pool);
+  for (size_t i = 0; i < size; ++i) {
+    for (size_t j = 0; j < size; ++j) {
+      ASSERT_EQ(c[i * stride + j], expected[i * size + j]) << i << " " << j;
+    }
+    // the padding after each row stays untouched
+    for (size_t j = size; j < stride; ++j) {
+      ASSERT_EQ(c[i * stride + j], -1);
+    }
+  }
+}
+
+TEST(Strassen, MatchesClassicProduct) {
+  ThreadPool pool(2);
+  const size_t cutoff = gemm::StrassenCutoff<int64_t>::kValue;
+  // below the cutoff, and one or two levels with odd sizes on the way
+  ExpectStrassen(cutoff - 1, pool);
+  ExpectStrassen(cutoff, pool);
+  ExpectStrassen(cutoff + 1, pool);
+  ExpectStrassen(2 * cutoff + 6, pool);
+}
+
+TEST(Strassen, MatrixProduct) {
+  ASSERT_TRUE((gemm::UseStrassen<515, int64_t>::value));
+  std::mt19937_64 random(36);
+  Matrix<515, 515> a = Random<515, 515>(random);
+  Matrix<515, 515> b = Random<515, 515>(random);
+  Matrix<515, 515> product = a * b;
+  std::vector<int64_t> expected(515 * 515);
+  gemm::Multiply(515, 515, 515, a.Data(), 515, b.Data(), 515, expected.data(),
+                 515);
+  ASSERT_TRUE(std::equal(expected.begin(), expected.end(), product.Data()));
+  a *= b;
+  ASSERT_TRUE(a == product);
+}
+
+// the tiled transpose of a rows x cols block inside a wider buffer, and
+// the in-place transpose of the square blocks of every side up to it
+template <typename T>
+void ExpectTranspose(size_t rows, size_t cols) {
+  const size_t src_stride = cols + 5;
+  const size_t dst_stride = rows + 3;
+  std::vector<T> src(rows * src_stride);
+  for (size_t i = 0; i < src.size(); ++i) {
+    src[i] = static_cast<T>(i % 1000 + 1);
+  }
+  std::vector<T> dst(cols * dst_stride, T(-1));
+  transpose::Transpose(rows, cols, src.data(), src_stride, dst.data(),
+                       dst_stride);
+  for (size_t j = 0; j < cols; ++j) {
+    for (size_t i = 0; i < dst_stride; ++i) {
+      T expected = i < rows ? src[i * src_stride + j] : T(-1);
+      ASSERT_EQ(dst[j * dst_stride + i], expected) << rows << " " << cols;
+    }
+  }
+
+  size_t size = std::min(rows, cols);
+  std::vector<T> square(src);
+  transpose::TransposeSquare(size, square.data(), src_stride);
+  for (size_t i = 0; i < rows; ++i) {
+    for (size_t j = 0; j < src_stride; ++j) {
+      T expected = i < size && j < size ? src[j * src_stride + i]
+                                        : src[i * src_stride + j];
+      ASSERT_EQ(square[i * src_stride + j], expected) << size;
+    }
+  }
+}
+
+template <typename T>
+void ExpectTransposeSizes() {
+  const size_t sizes[] = {1, 3, 4, 7, 8, 9, 31, 33, 70, 129};
+  for (size_t rows : sizes) {
+    for (size_t cols : sizes) {
+      ExpectTranspose<T>(rows, cols);
+    }
+  }
+}
+
+TEST(Transpose, Tiled) {
+  ExpectTransposeSizes<double>();
+  ExpectTransposeSizes<float>();
+  ExpectTransposeSizes<int64_t>();
+  ExpectTransposeSizes<int32_t>();
+  ExpectTransposeSizes<int16_t>();
+}
+
+TEST(Transpose, Matrix) {
+  Matrix<70, 33> a;
+  for (size_t i = 0; i < 70; ++i) {
+    for (size_t j = 0; j < 33; ++j) {
+      a(i, j) = static_cast<int64_t>(i * 1000 + j);
+    }
+  }
+  Matrix<33, 70> transposed = a.Transposed();
+  for (size_t i = 0; i < 70; ++i) {
+    for (size_t j = 0; j < 33; ++j) {
+      ASSERT_EQ(transposed(j, i), a(i, j));
+    }
+  }
+  Matrix<67, 67> square = Numbered<67>();
+  square.TransposeInPlace();
+  ASSERT_TRUE(square == Numbered<67>().Transposed());
+  ASSERT_EQ(square(3, 5), 5 * 67 + 3);
+}
+
+static Matrix<2, 2> FibonacciStep() {
+  Matrix<2, 2> step(1);
+  step(1, 1) = 0;
+  return step;
+}
+
+TEST(Power, Fibonacci) {
+  std::vector<int64_t> fibonacci = {0, 1};
+  while (fibonacci.size() <= 92) {
+    fibonacci.push_back(fibonacci[fibonacci.size() - 1] +
+                        fibonacci[fibonacci.size() - 2]);
+  }
+  Matrix<2, 2> identity;
+  identity(0, 0) = 1;
+  identity(1, 1) = 1;
+  ASSERT_TRUE(Pow(FibonacciStep(), 0) == identity);
+  ASSERT_TRUE(Pow(Numbered<3>(), 1) == Numbered<3>());
+  // F(k + 1) in the step power still fits for k <= 91
+  for (uint64_t k = 0; k <= 91; ++k) {
+    ASSERT_EQ(Pow(FibonacciStep(), k)(0, 1), fibonacci[k]) << k;
+    ASSERT_EQ(LinearRecurrence<int64_t>({1, 1}, {0, 1}, k), fibonacci[k]);
+  }
+  // tribonacci through a 3 x 3 step and through Kitamasa of order 3
+  Matrix<3, 3> step;
+  step(0, 0) = step(0, 1) = step(0, 2) = 1;
+  step(1, 0) = step(2, 1) = 1;
+  for (uint64_t k = 0; k < 40; ++k) {
+    ASSERT_EQ(Pow(step, k)(2, 0), LinearRecurrence<int64_t>({1, 1, 1},
+                                                            {0, 0, 1}, k));
+  }
+  ASSERT_THROW(LinearRecurrence<int64_t>({1, 1}, {0}, 5),
+               std::invalid_argument);
+  ASSERT_THROW(LinearRecurrence<int64_t>({}, {}, 5), std::invalid_argument);
+}
+
+TEST(Power, FibonacciModulo) {
+  // the Pisano period modulo 10 is 60
+  const uint64_t huge = 60 * uint64_t(1000000000000000) + 7;
+  ASSERT_EQ(PowMod(FibonacciStep(), huge, int64_t(10))(0, 1), 3);
+  ASSERT_EQ(LinearRecurrenceMod<int64_t>({1, 1}, {0, 1}, huge, 10), 3);
+
+  // moduli up to 2^63 - 1: the products need 126 bits
+  const int64_t moduli[] = {1, 2, 1000000007, (int64_t(1) << 62) + 135,
+                            std::numeric_limits<int64_t>::max()};
+  for (int64_t modulus : moduli) {
+    int64_t previous = 0;
+    int64_t current = 1 % modulus;
+    for (uint64_t k = 0; k < 300; ++k) {
+      ASSERT_EQ(PowMod(FibonacciStep(), k, modulus)(0, 1), previous)
+          << modulus << " " << k;
+      ASSERT_EQ(LinearRecurrenceMod<int64_t>({1, 1}, {0, 1}, k, modulus),
+                previous);
+      auto next = static_cast<int64_t>(
+          (static_cast<unsigned __int128>(previous) + current) % modulus);
+      previous = current;
+      current = next;
+    }
+    ASSERT_EQ(PowMod(FibonacciStep(), huge, modulus)(0, 1),
+              LinearRecurrenceMod<int64_t>({1, 1}, {0, 1}, huge, modulus));
+  }
+  // negative entries and initial terms are reduced into [0, modulus)
+  ASSERT_EQ(PowMod(Matrix<1, 1>(-3), 3, int64_t(5))(0, 0), 3);
+  ASSERT_EQ(LinearRecurrenceMod<int64_t>({-1}, {-2}, 3, 7), 2);
+  ASSERT_EQ(PowMod(FibonacciStep(), 0, int64_t(1))(0, 0), 0);
+  ASSERT_THROW(PowMod(FibonacciStep(), 5, int64_t(0)), std::invalid_argument);
+  ASSERT_THROW(LinearRecurrenceMod<int64_t>({1, 1}, {0, 1}, 5, -7),
+               std::invalid_argument);
+}
+
+template <size_t N, size_t M, size_t K, typename T>
+void ExpectBatch(size_t count) {
+  std::mt19937_64 random(count);
+  std::vector<Matrix<N, M, T>> left;
+  std::vector<Matrix<N, M, T>> right;
+  std::vector<Matrix<M, K, T>> factors;
+  for (size_t i = 0; i < count; ++i) {
+    left.push_back(Random<N, M, T>(random));
+    right.push_back(Random<N, M, T>(random));
+    factors.push_back(Random<M, K, T>(random));
+  }
+  MatrixBatch<N, M, T> a(left);
+  MatrixBatch<N, M, T> b;
+  for (const Matrix<N, M, T>& matrix : right) {
+    b.PushBack(matrix);
+  }
+  MatrixBatch<M, K, T> c(factors);
+  ASSERT_EQ(a.Size(), count);
+  ASSERT_EQ(b.Size(), count);
+
+  MatrixBatch<N, M, T> sum = a + b;
+  MatrixBatch<N, M, T> difference = a - b;
+  MatrixBatch<N, M, T> scaled = T(3) * a;
+  MatrixBatch<N, K, T> product = a * c;
+  MatrixBatch<M, N, T> transposed = a.Transposed();
+  std::vector<Matrix<N, M, T>> scattered = a.Scatter();
+  for (size_t i = 0; i < count; ++i) {
+    ASSERT_TRUE(scattered[i] == left[i]);
+    Matrix<N, M, T> expected_sum = left[i];
+    expected_sum += right[i];
+    Matrix<N, M, T> expected_difference = left[i];
+    expected_difference -= right[i];
+    Matrix<N, M, T> expected_scaled = left[i];
+    expected_scaled *= T(3);
+    ASSERT_TRUE(sum.Get(i) == expected_sum) << i;
+    ASSERT_TRUE(difference.Get(i) == expected_difference) << i;
+    ASSERT_TRUE(scaled.Get(i) == expected_scaled) << i;
+    ASSERT_TRUE(product.Get(i) == left[i] * factors[i]) << i;
+    ASSERT_TRUE(transposed.Get(i) == left[i].Transposed()) << i;
+    ASSERT_EQ(a(i, N - 1, M - 1), left[i](N - 1, M - 1));
+  }
+  a += b;
+  ASSERT_TRUE(a == sum);
+  a -= b;
+  ASSERT_TRUE((a == MatrixBatch<N, M, T>(left)));
+  ASSERT_TRUE(a != sum || count == 0);
+}
+
+template <size_t N, typename T>
+void ExpectDeterminants(size_t count) {
+  std::mt19937_64 random(N);
+  std::vector<Matrix<N, N, T>> matrices;
+  for (size_t i = 0; i < count; ++i) {
+    matrices.push_back(Random<N, N, T>(random));
+  }
+  std::vector<T> determinants = MatrixBatch<N, N, T>(matrices).Determinants();
+  ASSERT_EQ(determinants.size(), count);
+  for (size_t i = 0; i < count; ++i) {
+    ASSERT_NEAR(determinants[i], matrices[i].Determinant(), 1e-6) << N;
+  }
+}
+
+TEST(MatrixBatch, MatchesMatrix) {
+  // a partial block, whole blocks and enough blocks to run in parallel
+  for (size_t count : {0, 1, 15, 16, 33, 3000}) {
+    ExpectBatch<3, 2, 4, int64_t>(count);
+    ExpectBatch<4, 4, 4, double>(count);
+    ExpectBatch<2, 5, 1, float>(count);
+  }
+}
+
+TEST(MatrixBatch, Determinants) {
+  ExpectDeterminants<1, int64_t>(20);
+  ExpectDeterminants<2, int64_t>(20);
+  ExpectDeterminants<3, int64_t>(40);
+  ExpectDeterminants<4, int64_t>(40);
+  ExpectDeterminants<5, int64_t>(40);
+  ExpectDeterminants<3, double>(40);
+  ExpectDeterminants<4, double>(40);
+}
+
+TEST(MatrixBatch, SizeMismatch) {
+  MatrixBatch<2, 2> a(3);
+  MatrixBatch<2, 2> b(4);
+  ASSERT_THROW(a += b, std::invalid_argument);
+  ASSERT_THROW(a - b, std::invalid_argument);
+  ASSERT_THROW(a * b, std::invalid_argument);
+  ASSERT_FALSE(a == b);
+}
+
+// rows x cols with about one entry in density nonzero, every third row
+// empty, and a few very long rows as in power-law graphs
+static DynMatrix<int64_t> RandomSparse(size_t rows, size_t cols,
+                                       size_t density,
+                                       std::mt19937_64& random) {
+  DynMatrix<int64_t> dense(rows, cols);
+  std::uniform_int_distribution<int64_t> entry(-9, 9);
+  for (size_t row = 0; row < rows; ++row) {
+    if (row % 3 == 1) {
+      continue;
+    }
+    size_t row_density = row % 50 == 0 ? 2 : density;
+    for (size_t col = 0; col < cols; ++col) {
+      if (random() % row_density == 0) {
+        dense(row, col) = entry(random);
+      }
+    }
+  }
+  return dense;
+}
+
+void ExpectSparse(size_t rows, size_t cols, size_t density) {
+  std::mt19937_64 random(rows * 31 + cols);
+  DynMatrix<int64_t> dense = RandomSparse(rows, cols, density, random);
+  SparseMatrix<int64_t> sparse(dense);
+  ASSERT_TRUE(sparse.ToDense() == dense);
+  ASSERT_EQ(sparse.RowOffsets().size(), rows + 1);
+  ASSERT_EQ(sparse.NonZeros(), sparse.Values().size());
+
+  std::vector<int64_t> vector(cols);
+  DynMatrix<int64_t> column(cols, 1);
+  for (size_t col = 0; col < cols; ++col) {
+    vector[col] = static_cast<int64_t>(random() % 19) - 9;
+    column(col, 0) = vector[col];
+  }
+  std::vector<int64_t> product = sparse * vector;
+  DynMatrix<int64_t> expected = dense * column;
+  ASSERT_EQ(product.size(), rows);
+  for (size_t row = 0; row < rows; ++row) {
+    ASSERT_EQ(product[row], expected(row, 0)) << row;
+  }
+
+  DynMatrix<int64_t> right = RandomSparse(cols, 7, 1, random);
+  ASSERT_TRUE(sparse * right == dense * right);
+  ASSERT_TRUE(sparse.Transposed().ToDense() == dense.Transposed());
+}
+
+TEST(SparseMatrix, MatchesDense) {
+  // one chunk, and enough non-zeros for several chunks of rows
+  ExpectSparse(1, 1, 1);
+  ExpectSparse(10, 13, 3);
+  ExpectSparse(700, 900, 5);
+  ExpectSparse(0, 5, 1);
+}
+
+TEST(SparseMatrix, Entries) {
+  using Entry = SparseMatrix<int64_t>::Entry;
+  // duplicates are summed, zero sums dropped, rows 0 and 2 stay empty
+  SparseMatrix<int64_t> sparse(
+      4, 3, {Entry{3, 2, 5}, Entry{1, 0, 2}, Entry{3, 2, -5}, Entry{1, 2, 4},
+             Entry{1, 0, 1}, Entry{3, 0, 7}});
+  ASSERT_EQ(sparse.NonZeros(), 3u);
+  ASSERT_EQ(sparse(1, 0), 3);
+  ASSERT_EQ(sparse(3, 2), 0);
+  ASSERT_EQ(sparse(3, 0), 7);
+  std::vector<size_t> offsets = {0, 0, 2, 2, 3};
+  ASSERT_EQ(sparse.RowOffsets(), offsets);
+  Matrix<4, 3> dense;
+  dense(1, 0) = 3;
+  dense(1, 2) = 4;
+  dense(3, 0) = 7;
+  ASSERT_TRUE(sparse == SparseMatrix<int64_t>(dense));
+  std::mt19937_64 random(41);
+  Matrix<3, 2> right = Random<3, 2>(random);
+  ASSERT_TRUE(sparse * right == DynMatrix<int64_t>(dense * right));
+  std::vector<int64_t> product = sparse * std::vector<int64_t>{1, 1, 1};
+  ASSERT_EQ(product, (std::vector<int64_t>{0, 7, 0, 7}));
+
+  ASSERT_THROW(sparse * std::vector<int64_t>(4), std::invalid_argument);
+  ASSERT_THROW(sparse * DynMatrix<int64_t>(4, 2), std::invalid_argument);
+  ASSERT_THROW(SparseMatrix<int64_t>(2, 2, {Entry{2, 0, 1}}),
+               std::invalid_argument);
+}
+
+template <size_t N, size_t M, size_t K, typename T>
+void ExpectUnrolled(std::mt19937_64& random) {
+  ASSERT_TRUE((unrolled::Fits<N, M, K>::value));
+  Matrix<N, M, T> a = Random<N, M, T>(random);
+  Matrix<M, K, T> b = Random<M, K, T>(random);
+  std::vector<T> a_values(a.Data(), a.Data() + N * M);
+  std::vector<T> b_values(b.Data(), b.Data() + M * K);
+  std::vector<T> expected = NaiveProduct(N, M, K, a_values, b_values);
+
+  std::vector<T> product(N * K, T(-1));
+  unrolled::Multiply<N, M, K>(a.Data(), b.Data(), product.data());
+  ASSERT_TRUE(product == expected) << N << " " << M << " " << K;
+  Matrix<N, K, T> matrix_product = a * b;
+  ASSERT_TRUE(std::equal(expected.begin(), expected.end(),
+                         matrix_product.Data()));
+
+  std::vector<T> transposed(N * M);
+  unrolled::Transpose<N, M>(a.Data(), transposed.data());
+  for (size_t i = 0; i < N; ++i) {
+    for (size_t j = 0; j < M; ++j) {
+      ASSERT_EQ(transposed[j * N + i], a(i, j));
+    }
+  }
+  ASSERT_TRUE(a.Transposed().Transposed() == a);
+}
+
+template <size_t N, size_t M, typename T>
+void ExpectUnrolledRows(std::mt19937_64& random) {
+  ExpectUnrolled<N, M, 1, T>(random);
+  ExpectUnrolled<N, M, 2, T>(random);
+  ExpectUnrolled<N, M, 3, T>(random);
+  ExpectUnrolled<N, M, 4, T>(random);
+}
+
+template <size_t N, typename T>
+void ExpectUnrolledSide(std::mt19937_64& random) {
+  ExpectUnrolledRows<N, 1, T>(random);
+  ExpectUnrolledRows<N, 2, T>(random);
+  ExpectUnrolledRows<N, 3, T>(random);
+  ExpectUnrolledRows<N, 4, T>(random);
+  Matrix<N, N, T> square = Random<N, N, T>(random);
+  T trace = T();
+  for (size_t i = 0; i < N; ++i) {
+    trace += square(i, i);
+  }
+  ASSERT_EQ(unrolled::Trace<N>(square.Data()), trace);
+  ASSERT_EQ(square.Trace(), trace);
+}
+
+TEST(Unrolled, EverySide) {
+  std::mt19937_64 random(42);
+  ExpectUnrolledSide<1, int64_t>(random);
+  ExpectUnrolledSide<2, int64_t>(random);
+  ExpectUnrolledSide<3, int64_t>(random);
+  ExpectUnrolledSide<4, int64_t>(random);
+  ExpectUnrolledSide<1, double>(random);
+  ExpectUnrolledSide<2, double>(random);
+  ExpectUnrolledSide<3, double>(random);
+  ExpectUnrolledSide<4, double>(random);
+  ASSERT_FALSE((unrolled::Fits<5, 4, 4>::value));
+  ASSERT_FALSE((unrolled::Fits<4, 4, 5>::value));
+}
+
+// a file in the test temporary directory, removed with the object
+class TempFile {
+ public:
+  explicit TempFile(const std::string& name)
+      : path_(testing::TempDir() + "matrix_io_" + std::to_string(::getpid()) +
+              "_" + name) {}
+  ~TempFile() { std::remove(path_.c_str()); }
+
+  const std::string& Path() const { return path_; }
+
+ private:
+  std::string path_;
+};
+
+template <typename T>
+void ExpectRoundTrip(const char* name) {
+  TempFile file(name);
+  std::mt19937_64 random(43);
+  Matrix<5, 7, T> matrix = Random<5, 7, T>(random);
+  Save(file.Path(), matrix);
+  ASSERT_TRUE((LoadMatrix<5, 7, T>(file.Path()) == matrix)) << name;
+}
+
+TEST(MatrixIo, RoundTrip) {
+  ExpectRoundTrip<int64_t>("int64");
+  ExpectRoundTrip<double>("double");
+  ExpectRoundTrip<float>("float");
+  ExpectRoundTrip<int8_t>("int8");
+  ExpectRoundTrip<uint8_t>("uint8");
+  ExpectRoundTrip<bool>("bool");
+
+  // DynMatrix has no bool, its storage is a std::vector
+  TempFile file("dyn");
+  std::mt19937_64 random(45);
+  Matrix<6, 3, double> matrix = Random<6, 3, double>(random);
+  Save(file.Path(), matrix);
+  ASSERT_TRUE(LoadDynMatrix<double>(file.Path()) == DynMatrix<double>(matrix));
+  DynMatrix<int64_t> empty(0, 4);
+  Save(file.Path(), empty);
+  ASSERT_TRUE(LoadDynMatrix<int64_t>(file.Path()) == empty);
+  Save(file.Path(), DynMatrix<int64_t>({{1, 2}, {3, 4}, {5, 6}}));
+  ASSERT_TRUE((LoadMatrix<3, 2>(file.Path()) == DynMatrix<int64_t>(
+                                                    {{1, 2}, {3, 4}, {5, 6}})
+                                                    .ToMatrix<3, 2>()));
+  ASSERT_THROW((LoadMatrix<2, 3>(file.Path())), std::invalid_argument);
+}
+
+TEST(MatrixIo, WrongType) {
+  TempFile file("type");
+  Save(file.Path(), Matrix<2, 2, bool>(true));
+  ASSERT_THROW((LoadMatrix<2, 2, uint8_t>(file.Path())), std::invalid_argument);
+  ASSERT_THROW((LoadMatrix<2, 2, int8_t>(file.Path())), std::invalid_argument);
+  Save(file.Path(), Matrix<2, 2, uint8_t>(1));
+  ASSERT_THROW((LoadMatrix<2, 2, bool>(file.Path())), std::invalid_argument);
+  Save(file.Path(), Numbered<2>());
+  ASSERT_THROW(LoadDynMatrix<double>(file.Path()), std::invalid_argument);
+  ASSERT_THROW(LoadDynMatrix<uint64_t>(file.Path()), std::invalid_argument);
+  ASSERT_THROW(LoadDynMatrix<int32_t>(file.Path()), std::invalid_argument);
+  ASSERT_THROW(MappedMatrix<double>(file.Path()), std::invalid_argument);
+  ASSERT_THROW(MatrixRowReader<double>(file.Path(), 1), std::invalid_argument);
+}
+
+TEST(MatrixIo, BrokenFiles) {
+  TempFile file("broken");
+  Save(file.Path(), Numbered<8>());
+  ASSERT_EQ(::truncate(file.Path().c_str(), 64 + 8 * 8 * 8 - 1), 0);
+  ASSERT_THROW((LoadMatrix<8, 8>(file.Path())), std::invalid_argument);
+  ASSERT_THROW(LoadDynMatrix<int64_t>(file.Path()), std::invalid_argument);
+  ASSERT_THROW(MappedMatrix<int64_t>(file.Path()), std::invalid_argument);
+  ASSERT_EQ(::truncate(file.Path().c_str(), 20), 0);
+  ASSERT_THROW(LoadDynMatrix<int64_t>(file.Path()), std::invalid_argument);
+
+  // not a matrix file, and no file at all
+  {
+    matrix_io::File text(file.Path(), O_WRONLY | O_TRUNC);
+    const char kText[] = "rows and columns, but no header at all";
+    text.WriteAt(0, kText, sizeof(kText));
+  }
+  ASSERT_THROW(LoadDynMatrix<int64_t>(file.Path()), std::invalid_argument);
+  ASSERT_THROW(LoadDynMatrix<int64_t>(file.Path() + "_missing"),
+               std::runtime_error);
+}
+
+TEST(MatrixIo, MappedMatrix) {
+  TempFile file("mapped");
+  std::mt19937_64 random(44);
+  Matrix<40, 30, double> matrix = Random<40, 30, double>(random);
+  Matrix<30, 20, double> factor = Random<30, 20, double>(random);
+  Save(file.Path(), matrix);
+  MappedMatrix<double> mapped(file.Path());
+  ASSERT_EQ(mapped.Rows(), 40u);
+  ASSERT_EQ(mapped.Cols(), 30u);
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(mapped.Data()) % 64, 0u);
+  ASSERT_EQ(mapped(39, 29), matrix(39, 29));
+  ASSERT_TRUE(mapped.ToDynMatrix() == DynMatrix<double>(matrix));
+  ASSERT_TRUE(mapped * DynMatrix<double>(factor) ==
+              DynMatrix<double>(matrix * factor));
+
+  MappedMatrix<double> moved(std::move(mapped));
+  ASSERT_EQ(moved(1, 2), matrix(1, 2));
+  mapped = std::move(moved);
+  ASSERT_EQ(mapped(3, 4), matrix(3, 4));
+  ASSERT_THROW(mapped * DynMatrix<double>(20, 1), std::invalid_argument);
+}
+
+TEST(MatrixIo, RowBlocks) {
+  TempFile input("rows_input");
+  TempFile output("rows_output");
+  DynMatrix<int64_t> matrix(Numbered<10>());
+  {
+    MatrixRowWriter<int64_t> writer(input.Path(), 10, 10);
+    DynMatrix<int64_t> block(3, 10);
+    for (size_t row = 0; row < 9; row += 3) {
+      for (size_t i = 0; i < 3; ++i) {
+        for (size_t j = 0; j < 10; ++j) {
+          block(i, j) = matrix(row + i, j);
+        }
+      }
+      writer.Write(block);
+    }
+    ASSERT_EQ(writer.WrittenRows(), 9u);
+    // the last row is missing yet
+    ASSERT_THROW(LoadDynMatrix<int64_t>(input.Path()), std::invalid_argument);
+    ASSERT_THROW(writer.Write(block), std::invalid_argument);
+    ASSERT_THROW(writer.Write(DynMatrix<int64_t>(1, 9)), std::invalid_argument);
+    DynMatrix<int64_t> last(1, 10);
+    for (size_t j = 0; j < 10; ++j) {
+      last(0, j) = matrix(9, j);
+    }
+    writer.Write(last);
+  }
+  ASSERT_TRUE(LoadDynMatrix<int64_t>(input.Path()) == matrix);
+
+  MatrixRowReader<int64_t> reader(input.Path(), 4);
+  DynMatrix<int64_t> block;
+  std::vector<size_t> first_rows;
+  std::vector<size_t> block_rows;
+  while (reader.NextRow() < reader.Rows()) {
+    first_rows.push_back(reader.NextRow());
+    ASSERT_TRUE(reader.Next(block));
+    block_rows.push_back(block.Rows());
+    for (size_t i = 0; i < block.Rows(); ++i) {
+      for (size_t j = 0; j < 10; ++j) {
+        ASSERT_EQ(block(i, j), matrix(first_rows.back() + i, j));
+      }
+    }
+  }
+  ASSERT_FALSE(reader.Next(block));
+  ASSERT_EQ(first_rows, (std::vector<size_t>{0, 4, 8}));
+  ASSERT_EQ(block_rows, (std::vector<size_t>{4, 4, 2}));
+
+  DynMatrix<int64_t> factor({{1, 2}, {0, 1}, {3, 0}, {1, 1}, {0, 0},
+                             {2, 5}, {1, 0}, {0, 3}, {4, 4}, {1, 1}});
+  MultiplyFile(input.Path(), factor, output.Path(), 3);
+  ASSERT_TRUE(LoadDynMatrix<int64_t>(output.Path()) == matrix * factor);
+  ASSERT_THROW(MultiplyFile(input.Path(), DynMatrix<int64_t>(9, 2),
+                            output.Path(), 3),
+               std::invalid_argument);
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Пул потоков для параллельных операций над матрицами.
+// ParallelFor делит диапазон индексов на равные части по числу потоков;
+// закончив свою часть, поток забирает индексы из чужих частей
+// (work stealing), так что неравномерные задачи не простаивают.
+class ThreadPool {
+ public:
+  // thread_count - общее число потоков, включая вызывающий
+  explicit ThreadPool(size_t thread_count) {
+    size_t worker_count = std::max<size_t>(thread_count, 1) - 1;
+    ranges_.reset(new Range[worker_count + 1]);
+    for (size_t i = 0; i < worker_count; i++) {
+      workers_.emplace_back([this, i] { WorkerLoop(i); });
+    }
+  }
+
+  ThreadPool(const ThreadPool& other) = delete;
+  ThreadPool& operator=(const ThreadPool& other) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  size_t ThreadCount() const { return workers_.size() + 1; }
+
+  // Вызывает body(i) для всех i из [0, count) и ждет завершения.
+  // Вложенный вызов из задачи выполняется последовательно.
+  // Если body бросает исключение, оставшиеся индексы пропускаются, и после
+  // завершения всех потоков первое исключение бросается дальше.
+  void ParallelFor(size_t count, const std::function<void(size_t)>& body) {
+    if (workers_.empty() || count <= 1 || IsWorkerThread()) {
+      for (size_t i = 0; i < count; i++) {
+        body(i);
+      }
+      return;
+    }
+    std::lock_guard<std::mutex> call_lock(call_mutex_);
+    size_t parts = ThreadCount();
+    for (size_t part = 0; part < parts; part++) {
+      ranges_[part].next.store(count * part / parts, std::memory_order_relaxed);
+      ranges_[part].end = count * (part + 1) / parts;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      body_ = &body;
+      active_ = workers_.size();
+      generation_++;
+    }
+    wake_.notify_all();
+    {
+      WorkerFlag flag;
+      Run(workers_.size());
+    }
+    std::exception_ptr error;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      done_.wait(lock, [this] { return active_ == 0; });
+      body_ = nullptr;
+      std::swap(error, error_);
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  // Общий пул на все аппаратные потоки, создается при первом обращении
+  static ThreadPool& Default() {
+    static ThreadPool pool(std::max(std::thread::hardware_concurrency(), 1u));
+    return pool;
+  }
+
+ private:
+  struct Range {
+    std::atomic<size_t> next{0};
+    size_t end = 0;
+  };
+
+  static bool& IsWorkerThread() {
+    static thread_local bool is_worker = false;
+    return is_worker;
+  }
+
+  // Помечает поток как занятый задачей пула, пока жив объект
+  struct WorkerFlag {
+    WorkerFlag() { IsWorkerThread() = true; }
+    ~WorkerFlag() { IsWorkerThread() = false; }
+  };
+
+  // participant сначала разбирает свою часть, потом чужие. Исключение из
+  // body_ запоминается в error_ (только первое), и все части закрываются
+  void Run(size_t participant) {
+    size_t parts = ThreadCount();
+    try {
+      for (size_t shift = 0; shift < parts; shift++) {
+        Range& range = ranges_[(participant + shift) % parts];
+        size_t index = range.next.fetch_add(1, std::memory_order_relaxed);
+        while (index < range.end) {
+          (*body_)(index);
+          index = range.next.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!error_) {
+        error_ = std::current_exception();
+      }
+      // a late fetch_add only moves next further past end
+      for (size_t part = 0; part < parts; part++) {
+        ranges_[part].next.store(ranges_[part].end,
+                                 std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void WorkerLoop(size_t participant) {
+    WorkerFlag flag;
+    size_t seen_generation = 0;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this, seen_generation] {
+          return stop_ || generation_ != seen_generation;
+        });
+        if (stop_) {
+          return;
+        }
+        seen_generation = generation_;
+      }
+      Run(participant);
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--active_ == 0) {
+        done_.notify_one();
+      }
+    }
+  }
+
+  std::vector<std::thread> workers_;
+  std::unique_ptr<Range[]> ranges_;
+  const std::function<void(size_t)>* body_ = nullptr;
+  std::exception_ptr error_;
+
+  std::mutex call_mutex_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  size_t generation_ = 0;
+  size_t active_ = 0;
+  bool stop_ = false;
+};
@@ -0,0 +1,301 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MATRIX_TRANSPOSE_X86 1
+#include <immintrin.h>
+#endif
+
+// Транспонирование блоков матриц, хранящихся построчно с шагом строки ld.
+//
+// Блок рекурсивно делится пополам по большей стороне, пока не станет
+// не больше kLeafSize x kLeafSize (cache-oblivious схема: и чтение,
+// и запись идут по плиткам, помещающимся в кэш на любом уровне).
+// Лист транспонируется плитками MicroTile<T>::kSize x kSize; для
+// double и int64_t плитка 4 x 4, для float и int32_t - 8 x 8, и на
+// процессорах с AVX она переставляется целиком в регистрах.
+namespace transpose {
+
+static const size_t kLeafSize = 32;
+
+// Размер плитки микроядра
+template <typename T>
+struct MicroTile {
+  static const size_t kSize = 4;
+};
+
+template <>
+struct MicroTile<float> {
+  static const size_t kSize = 8;
+};
+
+template <>
+struct MicroTile<int32_t> {
+  static const size_t kSize = 8;
+};
+
+// dst := src^T для блока rows x cols
+template <typename T>
+inline void ScalarBlock(size_t rows, size_t cols, const T* src, size_t lds,
+                        T* dst, size_t ldd) {
+  for (size_t i = 0; i < rows; i++) {
+    for (size_t j = 0; j < cols; j++) {
+      dst[j * ldd + i] = src[i * lds + j];
+    }
+  }
+}
+
+template <typename T>
+inline void ScalarTile(const T* src, size_t lds, T* dst, size_t ldd) {
+  const size_t kSize = MicroTile<T>::kSize;
+  ScalarBlock(kSize, kSize, src, lds, dst, ldd);
+}
+
+#ifdef MATRIX_TRANSPOSE_X86
+
+inline bool HasAvx() {
+  static const bool kHasAvx = __builtin_cpu_supports("avx");
+  return kHasAvx;
+}
+
+// Транспонирует в регистрах четыре строки по 4 double
+__attribute__((target("avx"))) inline void AvxTranspose(__m256d rows[4]) {
+  // pairs (r0[0], r1[0], r0[2], r1[2]) etc., then swap 128-bit halves
+  __m256d low01 = _mm256_unpacklo_pd(rows[0], rows[1]);
+  __m256d high01 = _mm256_unpackhi_pd(rows[0], rows[1]);
+  __m256d low23 = _mm256_unpacklo_pd(rows[2], rows[3]);
+  __m256d high23 = _mm256_unpackhi_pd(rows[2], rows[3]);
+  rows[0] = _mm256_permute2f128_pd(low01, low23, 0x20);
+  rows[1] = _mm256_permute2f128_pd(high01, high23, 0x20);
+  rows[2] = _mm256_permute2f128_pd(low01, low23, 0x31);
+  rows[3] = _mm256_permute2f128_pd(high01, high23, 0x31);
+}
+
+// Транспонирует в регистрах восемь строк по 8 float
+__attribute__((target("avx"))) inline void AvxTranspose(__m256 rows[8]) {
+  __m256 pairs[8];
+  // interleave pairs of rows, then pairs of pairs, then 128-bit halves
+#pragma GCC unroll 4
+  for (size_t r = 0; r < 8; r += 2) {
+    pairs[r] = _mm256_unpacklo_ps(rows[r], rows[r + 1]);
+    pairs[r + 1] = _mm256_unpackhi_ps(rows[r], rows[r + 1]);
+  }
+#pragma GCC unroll 2
+  for (size_t r = 0; r < 8; r += 4) {
+    rows[r] = _mm256_shuffle_ps(pairs[r], pairs[r + 2], 0x44);
+    rows[r + 1] = _mm256_shuffle_ps(pairs[r], pairs[r + 2], 0xEE);
+    rows[r + 2] = _mm256_shuffle_ps(pairs[r + 1], pairs[r + 3], 0x44);
+    rows[r + 3] = _mm256_shuffle_ps(pairs[r + 1], pairs[r + 3], 0xEE);
+  }
+#pragma GCC unroll 4
+  for (size_t r = 0; r < 4; r++) {
+    __m256 low = rows[r];
+    __m256 high = rows[r + 4];
+    rows[r] = _mm256_permute2f128_ps(low, high, 0x20);
+    rows[r + 4] = _mm256_permute2f128_ps(low, high, 0x31);
+  }
+}
+
+__attribute__((target("avx"))) inline void AvxTile(const double* src,
+                                                    size_t lds, double* dst,
+                                                    size_t ldd) {
+  __m256d rows[4];
+#pragma GCC unroll 4
+  for (size_t r = 0; r < 4; r++) {
+    rows[r] = _mm256_loadu_pd(src + r * lds);
+  }
+  AvxTranspose(rows);
+#pragma GCC unroll 4
+  for (size_t r = 0; r < 4; r++) {
+    _mm256_storeu_pd(dst + r * ldd, rows[r]);
+  }
+}
+
+__attribute__((target("avx"))) inline void AvxTile(const float* src,
+                                                    size_t lds, float* dst,
+                                                    size_t ldd) {
+  __m256 rows[8];
+#pragma GCC unroll 8
+  for (size_t r = 0; r < 8; r++) {
+    rows[r] = _mm256_loadu_ps(src + r * lds);
+  }
+  AvxTranspose(rows);
+#pragma GCC unroll 8
+  for (size_t r = 0; r < 8; r++) {
+    _mm256_storeu_ps(dst + r * ldd, rows[r]);
+  }
+}
+
+// Целые той же ширины переставляются как биты double и float: они
+// загружаются как __m256i и приводятся только в регистрах, так что целые
+// не читаются через указатель на вещественный тип
+__attribute__((target("avx"))) inline void AvxTile(const int64_t* src,
+                                                    size_t lds, int64_t* dst,
+                                                    size_t ldd) {
+  __m256d rows[4];
+#pragma GCC unroll 4
+  for (size_t r = 0; r < 4; r++) {
+    rows[r] = _mm256_castsi256_pd(_mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(src + r * lds)));
+  }
+  AvxTranspose(rows);
+#pragma GCC unroll 4
+  for (size_t r = 0; r < 4; r++) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + r * ldd),
+                        _mm256_castpd_si256(rows[r]));
+  }
+}
+
+__attribute__((target("avx"))) inline void AvxTile(const int32_t* src,
+                                                    size_t lds, int32_t* dst,
+                                                    size_t ldd) {
+  __m256 rows[8];
+#pragma GCC unroll 8
+  for (size_t r = 0; r < 8; r++) {
+    rows[r] = _mm256_castsi256_ps(_mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(src + r * lds)));
+  }
+  AvxTranspose(rows);
+#pragma GCC unroll 8
+  for (size_t r = 0; r < 8; r++) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + r * ldd),
+                        _mm256_castps_si256(rows[r]));
+  }
+}
+
+// Плитка через AVX, если процессор его поддерживает
+template <typename T>
+inline void AvxOrScalarTile(const T* src, size_t lds, T* dst, size_t ldd) {
+  if (HasAvx()) {
+    AvxTile(src, lds, dst, ldd);
+  } else {
+    ScalarTile(src, lds, dst, ldd);
+  }
+}
+
+inline void Tile(const double* src, size_t lds, double* dst, size_t ldd) {
+  AvxOrScalarTile(src, lds, dst, ldd);
+}
+
+inline void Tile(const float* src, size_t lds, float* dst, size_t ldd) {
+  AvxOrScalarTile(src, lds, dst, ldd);
+}
+
+inline void Tile(const int64_t* src, size_t lds, int64_t* dst, size_t ldd) {
+  AvxOrScalarTile(src, lds, dst, ldd);
+}
+
+inline void Tile(const int32_t* src, size_t lds, int32_t* dst, size_t ldd) {
+  AvxOrScalarTile(src, lds, dst, ldd);
+}
+
+#endif
+
+template <typename T>
+inline void Tile(const T* src, size_t lds, T* dst, size_t ldd) {
+  ScalarTile(src, lds, dst, ldd);
+}
+
+// Лист рекурсии: целые плитки микроядром, края - поэлементно
+template <typename T>
+void Leaf(size_t rows, size_t cols, const T* src, size_t lds, T* dst,
+          size_t ldd) {
+  const size_t kSize = MicroTile<T>::kSize;
+  size_t full_rows = rows / kSize * kSize;
+  size_t full_cols = cols / kSize * kSize;
+  for (size_t i = 0; i < full_rows; i += kSize) {
+    for (size_t j = 0; j < full_cols; j += kSize) {
+      Tile(src + i * lds + j, lds, dst + j * ldd + i, ldd);
+    }
+  }
+  ScalarBlock(full_rows, cols - full_cols, src + full_cols, lds,
+              dst + full_cols * ldd, ldd);
+  ScalarBlock(rows - full_rows, cols, src + full_rows * lds, lds,
+              dst + full_rows, ldd);
+}
+
+// Половина стороны, кратная размеру плитки
+template <typename T>
+inline size_t Half(size_t size) {
+  const size_t kSize = MicroTile<T>::kSize;
+  return std::max(size / 2 / kSize * kSize, kSize);
+}
+
+// dst := src^T, где src - блок rows x cols, dst - блок cols x rows;
+// блоки не должны пересекаться
+template <typename T>
+void Transpose(size_t rows, size_t cols, const T* src, size_t lds, T* dst,
+               size_t ldd) {
+  if (rows <= kLeafSize && cols <= kLeafSize) {
+    Leaf(rows, cols, src, lds, dst, ldd);
+  } else if (rows >= cols) {
+    size_t half = Half<T>(rows);
+    Transpose(half, cols, src, lds, dst, ldd);
+    Transpose(rows - half, cols, src + half * lds, lds, dst + half, ldd);
+  } else {
+    size_t half = Half<T>(cols);
+    Transpose(rows, half, src, lds, dst, ldd);
+    Transpose(rows, cols - half, src + half, lds, dst + half * ldd, ldd);
+  }
+}
+
+// Меняет местами блок a (rows x cols) и транспонированный блок b
+// (cols x rows): a := b^T, b := a^T. Блоки не должны пересекаться
+template <typename T>
+void SwapTransposed(size_t rows, size_t cols, T* a, T* b, size_t ld) {
+  const size_t kSize = MicroTile<T>::kSize;
+  if (rows > kLeafSize || cols > kLeafSize) {
+    if (rows >= cols) {
+      size_t half = Half<T>(rows);
+      SwapTransposed(half, cols, a, b, ld);
+      SwapTransposed(rows - half, cols, a + half * ld, b + half, ld);
+    } else {
+      size_t half = Half<T>(cols);
+      SwapTransposed(rows, half, a, b, ld);
+      SwapTransposed(rows, cols - half, a + half, b + half * ld, ld);
+    }
+    return;
+  }
+  size_t full_rows = rows / kSize * kSize;
+  size_t full_cols = cols / kSize * kSize;
+  T saved[kSize * kSize];
+  for (size_t i = 0; i < full_rows; i += kSize) {
+    for (size_t j = 0; j < full_cols; j += kSize) {
+      T* a_tile = a + i * ld + j;
+      T* b_tile = b + j * ld + i;
+      for (size_t r = 0; r < kSize; r++) {
+        std::copy(a_tile + r * ld, a_tile + r * ld + kSize, saved + r * kSize);
+      }
+      Tile(b_tile, ld, a_tile, ld);
+      Tile(static_cast<const T*>(saved), kSize, b_tile, ld);
+    }
+  }
+  for (size_t i = 0; i < rows; i++) {
+    for (size_t j = i < full_rows ? full_cols : 0; j < cols; j++) {
+      std::swap(a[i * ld + j], b[j * ld + i]);
+    }
+  }
+}
+
+// Транспонирует квадратный блок size x size на месте
+template <typename T>
+void TransposeSquare(size_t size, T* data, size_t ld) {
+  if (size <= kLeafSize) {
+    for (size_t i = 0; i < size; i++) {
+      for (size_t j = i + 1; j < size; j++) {
+        std::swap(data[i * ld + j], data[j * ld + i]);
+      }
+    }
+    return;
+  }
+  size_t half = Half<T>(size);
+  TransposeSquare(half, data, ld);
+  TransposeSquare(size - half, data + half * ld + half, ld);
+  SwapTransposed(half, size - half, data + half, data + half * ld, ld);
+}
+
+}  // namespace transpose
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "gemm.hpp"
+
+// Ядра для маленьких матриц, у которых обе стороны не больше
+// kMaxUnrolledSide (2 x 2, 3 x 4, 4 x 4 и т.п.).
+//
+// Циклы ядер разворачиваются рекурсией шаблона Unroll: индекс каждой
+// итерации известен при компиляции, так что ни счетчиков, ни ветвлений
+// не остается, а соседние операции компилятор склеивает в векторные.
+// Умножение таких матриц не проходит через упаковку gemm и пул потоков,
+// на которые у 4 x 4 уходит больше времени, чем на сами 64 умножения.
+namespace unrolled {
+
+static const size_t kMaxUnrolledSide = 4;
+
+// Помещаются ли матрицы N x M и M x K в развернутые ядра
+template <size_t N, size_t M, size_t K = 1>
+struct Fits
+    : std::integral_constant<bool, 0 < M && N <= kMaxUnrolledSide &&
+                                       M <= kMaxUnrolledSide &&
+                                       K <= kMaxUnrolledSide> {};
+
+// Вызывает apply(Begin), apply(Begin + 1), ..., apply(End - 1)
+template <size_t Begin, size_t End>
+struct Unroll {
+  template <typename Apply>
+  __attribute__((always_inline)) static void Run(const Apply& apply) {
+    apply(Begin);
+    Unroll<Begin + 1, End>::Run(apply);
+  }
+};
+
+template <size_t End>
+struct Unroll<End, End> {
+  template <typename Apply>
+  __attribute__((always_inline)) static void Run(const Apply& /*apply*/) {}
+};
+
+// c := a * b для a (N x M) и b (M x K), хранящихся построчно плотно
+template <size_t N, size_t M, size_t K, typename T>
+__attribute__((always_inline)) inline void Multiply(const T* a, const T* b,
+                                                    T* c) {
+  Unroll<0, N>::Run([a, b, c](size_t i) __attribute__((always_inline)) {
+    // row i of c is a[i][0] * b[0] + ... + a[i][M - 1] * b[M - 1]
+    T row[K];
+    Unroll<0, K>::Run([&](size_t j) __attribute__((always_inline)) {
+      row[j] = a[i * M] * b[j];
+    });
+    Unroll<1, M>::Run([&](size_t p) __attribute__((always_inline)) {
+      Unroll<0, K>::Run([&](size_t j) __attribute__((always_inline)) {
+        using gemm::AddMul;
+        AddMul(row[j], a[i * M + p], b[p * K + j]);
+      });
+    });
+    Unroll<0, K>::Run([&](size_t j) __attribute__((always_inline)) {
+      c[i * K + j] = std::move(row[j]);
+    });
+  });
+}
+
+// dst := src^T для src (N x M)
+template <size_t N, size_t M, typename T>
+__attribute__((always_inline)) inline void Transpose(const T* src, T* dst) {
+  Unroll<0, N * M>::Run([src, dst](size_t index) __attribute__((always_inline)) {
+    dst[index % M * N + index / M] = src[index];
+  });
+}
+
+// Сумма диагональных элементов матрицы N x N
+template <size_t N, typename T>
+__attribute__((always_inline)) inline T Trace(const T* data) {
+  T result = T();
+  Unroll<0, N>::Run([data, &result](size_t i) __attribute__((always_inline)) {
+    result += data[i * N + i];
+  });
+  return result;
+}
+
+}  // namespace unrolled
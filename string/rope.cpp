@@ -0,0 +1,202 @@
+#include "rope.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+Rope::NodePtr Rope::MakeLeaf(const char* data, size_t size) {
+  if (size == 0) {
+    return nullptr;
+  }
+  std::shared_ptr<Node> leaf = std::make_shared<Node>();
+  leaf->chunk.Resize(size);
+  memcpy((void*)leaf->chunk.Data(), data, size);
+  leaf->size = size;
+  return leaf;
+}
+
+Rope::NodePtr Rope::MakeConcat(const NodePtr& left, const NodePtr& right) {
+  if (left == nullptr) {
+    return right;
+  }
+  if (right == nullptr) {
+    return left;
+  }
+  size_t size = left->size + right->size;
+  if (left->height == 1 && right->height == 1 && size <= kMaxLeafSize) {
+    // glue small neighbouring leaves so that edits do not fragment the text
+    std::shared_ptr<Node> leaf = std::make_shared<Node>();
+    leaf->chunk.Reserve(size);
+    leaf->chunk += left->chunk;
+    leaf->chunk += right->chunk;
+    leaf->size = size;
+    return leaf;
+  }
+  std::shared_ptr<Node> node = std::make_shared<Node>();
+  node->left = left;
+  node->right = right;
+  node->size = size;
+  node->height = std::max(left->height, right->height) + 1;
+  return node;
+}
+
+Rope::NodePtr Rope::Build(const char* data, size_t size) {
+  if (size <= kMaxLeafSize) {
+    return MakeLeaf(data, size);
+  }
+  // split on a leaf boundary so that all leaves but the last one are full
+  size_t leaves = (size + kMaxLeafSize - 1) / kMaxLeafSize;
+  size_t half = leaves / 2 * kMaxLeafSize;
+  return MakeConcat(Build(data, half), Build(data + half, size - half));
+}
+
+// left and right are balanced, their heights differ by at most 2
+Rope::NodePtr Rope::Rebalance(const NodePtr& left, const NodePtr& right) {
+  if (HeightOf(left) > HeightOf(right) + 1) {
+    if (HeightOf(left->left) >= HeightOf(left->right)) {
+      return MakeConcat(left->left, MakeConcat(left->right, right));
+    }
+    const NodePtr& middle = left->right;
+    return MakeConcat(MakeConcat(left->left, middle->left),
+                      MakeConcat(middle->right, right));
+  }
+  if (HeightOf(right) > HeightOf(left) + 1) {
+    if (HeightOf(right->right) >= HeightOf(right->left)) {
+      return MakeConcat(MakeConcat(left, right->left), right->right);
+    }
+    const NodePtr& middle = right->left;
+    return MakeConcat(MakeConcat(left, middle->left),
+                      MakeConcat(middle->right, right->right));
+  }
+  return MakeConcat(left, right);
+}
+
+// descends along the spine of the higher tree,
+// works in O(|height(left) - height(right)| + 1)
+Rope::NodePtr Rope::Join(const NodePtr& left, const NodePtr& right) {
+  if (HeightOf(left) > HeightOf(right) + 1) {
+    return Rebalance(left->left, Join(left->right, right));
+  }
+  if (HeightOf(right) > HeightOf(left) + 1) {
+    return Rebalance(Join(left, right->left), right->right);
+  }
+  return MakeConcat(left, right);
+}
+
+std::pair<Rope::NodePtr, Rope::NodePtr> Rope::Split(const NodePtr& node,
+                                                    size_t pos) {
+  if (pos == 0) {
+    return {nullptr, node};
+  }
+  if (pos >= SizeOf(node)) {
+    return {node, nullptr};
+  }
+  if (node->height == 1) {
+    const char* data = node->chunk.Data();
+    return {MakeLeaf(data, pos), MakeLeaf(data + pos, node->size - pos)};
+  }
+  size_t left_size = node->left->size;
+  if (pos < left_size) {
+    std::pair<NodePtr, NodePtr> parts = Split(node->left, pos);
+    return {parts.first, Join(parts.second, node->right)};
+  }
+  if (pos == left_size) {
+    return {node->left, node->right};
+  }
+  std::pair<NodePtr, NodePtr> parts = Split(node->right, pos - left_size);
+  return {Join(node->left, parts.first), parts.second};
+}
+
+Rope::Rope(const char* c_string) : root_(Build(c_string, strlen(c_string))) {}
+
+Rope::Rope(const String& string) : root_(Build(string.Data(), string.Size())) {}
+
+size_t Rope::Size() const { return SizeOf(root_); }
+
+char Rope::operator[](size_t id) const {
+  const Node* node = root_.get();
+  while (node->height > 1) {
+    if (id < node->left->size) {
+      node = node->left.get();
+    } else {
+      id -= node->left->size;
+      node = node->right.get();
+    }
+  }
+  return node->chunk[id];
+}
+
+void Rope::Insert(size_t pos, const Rope& other) {
+  std::pair<NodePtr, NodePtr> parts = Split(root_, pos);
+  root_ = Join(Join(parts.first, other.root_), parts.second);
+}
+
+void Rope::Erase(size_t pos, size_t count) {
+  std::pair<NodePtr, NodePtr> head = Split(root_, pos);
+  std::pair<NodePtr, NodePtr> tail = Split(head.second, count);
+  root_ = Join(head.first, tail.second);
+}
+
+Rope Rope::Substr(size_t pos, size_t count) const {
+  std::pair<NodePtr, NodePtr> tail = Split(root_, pos);
+  return Rope(Split(tail.second, count).first);
+}
+
+Rope& Rope::operator+=(const Rope& other) {
+  root_ = Join(root_, other.root_);
+  return *this;
+}
+
+Rope operator+(const Rope& left, const Rope& right) {
+  return Rope(Rope::Join(left.root_, right.root_));
+}
+
+String Rope::Flatten() const {
+  String res;
+  res.Reserve(Size());
+  for (Iterator it = begin(); it != end(); it.NextLeaf()) {
+    res += it.leaf_->chunk;
+  }
+  return res;
+}
+
+void Rope::Iterator::Descend(const Node* node) {
+  while (node->height > 1) {
+    path_.push_back(node->right.get());
+    node = node->left.get();
+  }
+  leaf_ = node;
+}
+
+Rope::Iterator& Rope::Iterator::operator++() {
+  if (++offset_ == leaf_->size) {
+    NextLeaf();
+  }
+  return *this;
+}
+
+void Rope::Iterator::NextLeaf() {
+  offset_ = 0;
+  if (path_.empty()) {
+    leaf_ = nullptr;
+    return;
+  }
+  const Node* next = path_.back();
+  path_.pop_back();
+  Descend(next);
+}
+
+Rope::Iterator Rope::begin() const {
+  Iterator it;
+  if (root_ != nullptr) {
+    it.Descend(root_.get());
+  }
+  return it;
+}
+
+std::ostream& operator<<(std::ostream& output, const Rope& rope) {
+  for (Rope::Iterator it = rope.begin(); it != rope.end(); it.NextLeaf()) {
+    const String& chunk = it.leaf_->chunk;
+    output.write(chunk.Data(), chunk.Size());
+  }
+  return output;
+}
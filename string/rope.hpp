@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "string.hpp"
+
+// Веревка (rope) для больших редактируемых текстов.
+// Хранит текст в листьях-кусках String не длиннее kMaxLeafSize,
+// собранных в сбалансированное (AVL) дерево конкатенаций.
+// Узлы неизменяемы и разделяются между веревками, поэтому
+// Insert, Erase, конкатенация и Substr работают за O(log n).
+class Rope {
+  struct Node;
+  using NodePtr = std::shared_ptr<const Node>;
+
+ public:
+  // Максимальная длина листа: несколько кэш-линий,
+  // чтобы обход листа не требовал лишних переходов по указателям
+  static const size_t kMaxLeafSize = 512;
+
+  // Итератор по символам веревки (только чтение)
+  class Iterator {
+   public:
+    char operator*() const { return leaf_->chunk[offset_]; }
+    Iterator& operator++();
+    bool operator==(const Iterator& other) const {
+      return leaf_ == other.leaf_ && offset_ == other.offset_;
+    }
+    bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+   private:
+    friend class Rope;
+    friend std::ostream& operator<<(std::ostream& output, const Rope& rope);
+
+    // спуск к самому левому листу, правые поддеревья откладываются в path_
+    void Descend(const Node* node);
+
+    // переход к началу следующего листа
+    void NextLeaf();
+
+    std::vector<const Node*> path_;
+    const Node* leaf_ = nullptr;
+    size_t offset_ = 0;
+  };
+
+  // Пустая веревка, память не выделяется
+  Rope() = default;
+
+  Rope(const char* c_string);
+  Rope(const String& string);
+
+  // возвращает размер
+  size_t Size() const;
+
+  // true, если веревка пустая (размер 0)
+  bool Empty() const { return Size() == 0; }
+
+  // Доступ к символу за O(log n)
+  char operator[](size_t id) const;
+
+  // вставляет other перед позицией pos
+  void Insert(size_t pos, const Rope& other);
+
+  // удаляет count символов, начиная с позиции pos
+  void Erase(size_t pos, size_t count);
+
+  // подстрока длины не больше count, начиная с позиции pos
+  Rope Substr(size_t pos, size_t count) const;
+
+  // Конкатенация за O(log n)
+  Rope& operator+=(const Rope& other);
+  friend Rope operator+(const Rope& left, const Rope& right);
+
+  // собирает содержимое в одну непрерывную String
+  String Flatten() const;
+
+  Iterator begin() const;
+  Iterator end() const { return Iterator(); }
+
+  // Оператор вывода в поток, пишет листья без сборки в одну строку
+  friend std::ostream& operator<<(std::ostream& output, const Rope& rope);
+
+ private:
+  // Лист хранит chunk, внутренний узел - два непустых поддерева
+  struct Node {
+    String chunk;
+    NodePtr left;
+    NodePtr right;
+    size_t size = 0;
+    int height = 1;
+  };
+
+  explicit Rope(NodePtr root) : root_(std::move(root)) {}
+
+  static size_t SizeOf(const NodePtr& node) {
+    return node == nullptr ? 0 : node->size;
+  }
+  static int HeightOf(const NodePtr& node) {
+    return node == nullptr ? 0 : node->height;
+  }
+
+  static NodePtr MakeLeaf(const char* data, size_t size);
+  static NodePtr MakeConcat(const NodePtr& left, const NodePtr& right);
+  static NodePtr Build(const char* data, size_t size);
+  static NodePtr Rebalance(const NodePtr& left, const NodePtr& right);
+  static NodePtr Join(const NodePtr& left, const NodePtr& right);
+  static std::pair<NodePtr, NodePtr> Split(const NodePtr& node, size_t pos);
+
+  NodePtr root_;
+};
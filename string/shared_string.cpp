@@ -0,0 +1,140 @@
+#include "shared_string.hpp"
+
+#include <cstring>
+#include <new>
+
+SharedString::Buffer* SharedString::Allocate(const char* data, size_t size) {
+  if (size == 0) {
+    return nullptr;
+  }
+  void* raw = ::operator new(sizeof(Buffer) + size + 1);
+  Buffer* buffer = new (raw) Buffer;
+  buffer->ref_count.store(1, std::memory_order_relaxed);
+  buffer->hash.store(0, std::memory_order_relaxed);
+  buffer->size = size;
+  buffer->shareable = true;
+  memcpy(buffer->Chars(), data, size);
+  buffer->Chars()[size] = '\0';
+  return buffer;
+}
+
+void SharedString::Release(Buffer* buffer) {
+  if (buffer == nullptr) {
+    return;
+  }
+  // the last owner has to see all writes made by the other owners
+  if (buffer->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    buffer->~Buffer();
+    ::operator delete(buffer);
+  }
+}
+
+SharedString::SharedString(const char* c_string)
+    : buffer_(Allocate(c_string, strlen(c_string))) {}
+
+SharedString::SharedString(const String& string)
+    : buffer_(Allocate(string.Data(), string.Size())) {}
+
+SharedString::SharedString(const SharedString& other) : buffer_(other.buffer_) {
+  if (buffer_ == nullptr) {
+    return;
+  }
+  if (!buffer_->shareable) {
+    // other may still write through a reference it handed out
+    buffer_ = Allocate(buffer_->Chars(), buffer_->size);
+    return;
+  }
+  buffer_->ref_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+SharedString& SharedString::operator=(const SharedString& other) {
+  if (other.buffer_ != buffer_) {
+    SharedString copy(other);
+    Swap(copy);
+  }
+  return *this;
+}
+
+SharedString::~SharedString() { Release(buffer_); }
+
+char& SharedString::operator[](size_t id) {
+  Detach();
+  // the buffer is ours now and is about to change, possibly long after
+  // this call returns
+  buffer_->shareable = false;
+  buffer_->hash.store(0, std::memory_order_relaxed);
+  return buffer_->Chars()[id];
+}
+
+size_t SharedString::Hash() const {
+  if (buffer_ == nullptr) {
+    return HashBytes("", 0);
+  }
+  if (!buffer_->shareable) {
+    // a reference handed out by operator[] may change the characters
+    return HashBytes(buffer_->Chars(), buffer_->size);
+  }
+  size_t hash = buffer_->hash.load(std::memory_order_relaxed);
+  if (hash == 0) {
+    // racing readers compute the same value, so a plain store is enough
+    hash = HashBytes(buffer_->Chars(), buffer_->size);
+    buffer_->hash.store(hash, std::memory_order_relaxed);
+  }
+  return hash;
+}
+
+size_t SharedString::UseCount() const {
+  if (buffer_ == nullptr) {
+    return 0;
+  }
+  return buffer_->ref_count.load(std::memory_order_relaxed);
+}
+
+void SharedString::Swap(SharedString& other) {
+  Buffer* tmp = other.buffer_;
+  other.buffer_ = buffer_;
+  buffer_ = tmp;
+}
+
+void SharedString::Detach() {
+  if (buffer_ == nullptr ||
+      buffer_->ref_count.load(std::memory_order_acquire) == 1) {
+    return;
+  }
+  Buffer* unique = Allocate(buffer_->Chars(), buffer_->size);
+  Release(buffer_);
+  buffer_ = unique;
+}
+
+String SharedString::ToString() const {
+  String res;
+  res.Resize(Size());
+  memcpy((void*)res.Data(), Data(), Size());
+  return res;
+}
+
+bool operator==(const SharedString& s1, const SharedString& s2) {
+  if (s1.buffer_ == s2.buffer_) {
+    return true;
+  }
+  if (s1.Size() != s2.Size()) {
+    return false;
+  }
+  if (s1.buffer_ != nullptr && s2.buffer_ != nullptr) {
+    size_t hash1 = s1.buffer_->hash.load(std::memory_order_relaxed);
+    size_t hash2 = s2.buffer_->hash.load(std::memory_order_relaxed);
+    if (hash1 != 0 && hash2 != 0 && hash1 != hash2) {
+      return false;
+    }
+  }
+  return memcmp(s1.Data(), s2.Data(), s1.Size()) == 0;
+}
+
+bool operator!=(const SharedString& s1, const SharedString& s2) {
+  return !(s1 == s2);
+}
+
+std::ostream& operator<<(std::ostream& output, const SharedString& s) {
+  output.write(s.Data(), s.Size());
+  return output;
+}
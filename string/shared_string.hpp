@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+
+#include "string.hpp"
+
+// Неизменяемая строка с разделяемым буфером (copy-on-write).
+// Копирование работает за O(1): копии ссылаются на один буфер
+// с атомарным счетчиком ссылок. Неконстантный доступ по индексу
+// отделяет собственную копию буфера, если он кем-то разделяется, и
+// делает буфер неразделяемым: выданная ссылка на символ может быть
+// записана позже, поэтому следующие копии строки копируют буфер целиком.
+class SharedString {
+ public:
+  // Пустая строка, память не выделяется
+  SharedString() = default;
+
+  SharedString(const char* c_string);
+
+  // Копирует содержимое String в новый разделяемый буфер
+  SharedString(const String& string);
+
+  // Конструктор копирования за O(1)
+  SharedString(const SharedString& other);
+
+  // Копирующий оператор присваивания за O(1)
+  SharedString& operator=(const SharedString& other);
+
+  ~SharedString();
+
+  // Константный оператор доступа по индексу[]
+  const char& operator[](size_t id) const { return buffer_->Chars()[id]; }
+
+  // Неконстантный оператор доступа по индексу[],
+  // отделяет буфер перед записью и запрещает его разделять
+  char& operator[](size_t id);
+
+  // true, если строка пустая (размер 0)
+  bool Empty() const { return Size() == 0; }
+
+  // возвращает размер
+  size_t Size() const { return buffer_ == nullptr ? 0 : buffer_->size; }
+
+  // возвращает указатель на начало массива (всегда нуль-терминирован)
+  const char* Data() const {
+    return buffer_ == nullptr ? "" : buffer_->Chars();
+  }
+
+  // число строк, разделяющих буфер (0 для пустой строки)
+  size_t UseCount() const;
+
+  // обменивает содержимое с другой строкой other за O(1)
+  void Swap(SharedString& other);
+
+  // Хэш содержимого. Считается один раз и кэшируется в общем буфере,
+  // так что все копии строки получают его за O(1). Для неразделяемого
+  // буфера (после неконстантного operator[]) считается при каждом вызове:
+  // символы могут меняться через выданную ссылку
+  size_t Hash() const;
+
+  // глубокая копия в обычную String
+  String ToString() const;
+
+  // Сравнение на равенство. Строки с общим буфером сравниваются за O(1)
+  friend bool operator==(const SharedString& s1, const SharedString& s2);
+  friend bool operator!=(const SharedString& s1, const SharedString& s2);
+
+  // Оператор вывода в поток.
+  friend std::ostream& operator<<(std::ostream& output, const SharedString& s);
+
+ private:
+  // Заголовок буфера, символы лежат сразу за ним в той же аллокации
+  struct Buffer {
+    std::atomic<size_t> ref_count;
+    // 0 - хэш еще не посчитан (всегда 0 у неразделяемого буфера)
+    mutable std::atomic<size_t> hash;
+    size_t size;
+    // false, если строке выдавалась неконстантная ссылка на символ
+    bool shareable;
+
+    char* Chars() { return reinterpret_cast<char*>(this + 1); }
+  };
+
+  static Buffer* Allocate(const char* data, size_t size);
+  static void Release(Buffer* buffer);
+
+  // делает буфер уникальным для этой строки
+  void Detach();
+
+  Buffer* buffer_ = nullptr;
+};
+
+namespace std {
+template <>
+struct hash<SharedString> {
+  size_t operator()(const SharedString& s) const { return s.Hash(); }
+};
+}  // namespace std
@@ -1,8 +1,13 @@
 #include "string.hpp"
 
+#include <cstdint>
 #include <cstring>
 #include <vector>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 static int Max(int a, int b) { return a > b ? a : b; }
 
 String::~String() { delete[] s_; }
@@ -93,6 +98,217 @@ void String::Swap(String& other) {
 
 static int Min(int a, int b) { return a < b ? a : b; }
 
+// wyhash: a 64x64->128 bit multiply-and-fold per 16 input bytes.
+// Long inputs are consumed 48 bytes at a time by three independent
+// multiplication chains, which keeps the multiplier pipeline busy.
+static const uint64_t kHashSecret[4] = {
+    0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL, 0x8ebc6af09c88c6e3ULL,
+    0x589965cc75374cc3ULL};
+
+static uint64_t MulFold(uint64_t a, uint64_t b) {
+  unsigned __int128 product = (unsigned __int128)a * b;
+  return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+static uint64_t Read64(const unsigned char* p) {
+  uint64_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static uint64_t Read32(const unsigned char* p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+size_t HashBytes(const char* data, size_t size) {
+  const unsigned char* p = (const unsigned char*)data;
+  uint64_t seed = MulFold(kHashSecret[0], kHashSecret[1]);
+  uint64_t a = 0;
+  uint64_t b = 0;
+  if (size <= 16) {
+    if (size >= 4) {
+      size_t shift = (size >> 3) << 2;
+      a = (Read32(p) << 32) | Read32(p + shift);
+      b = (Read32(p + size - 4) << 32) | Read32(p + size - 4 - shift);
+    } else if (size > 0) {
+      a = ((uint64_t)p[0] << 16) | ((uint64_t)p[size >> 1] << 8) | p[size - 1];
+    }
+  } else {
+    size_t rest = size;
+    if (rest > 48) {
+      uint64_t seed1 = seed;
+      uint64_t seed2 = seed;
+      do {
+        seed = MulFold(Read64(p) ^ kHashSecret[1], Read64(p + 8) ^ seed);
+        seed1 = MulFold(Read64(p + 16) ^ kHashSecret[2], Read64(p + 24) ^ seed1);
+        seed2 = MulFold(Read64(p + 32) ^ kHashSecret[3], Read64(p + 40) ^ seed2);
+        p += 48;
+        rest -= 48;
+      } while (rest > 48);
+      seed ^= seed1 ^ seed2;
+    }
+    while (rest > 16) {
+      seed = MulFold(Read64(p) ^ kHashSecret[1], Read64(p + 8) ^ seed);
+      p += 16;
+      rest -= 16;
+    }
+    a = Read64(p + rest - 16);
+    b = Read64(p + rest - 8);
+  }
+  unsigned __int128 product =
+      (unsigned __int128)(a ^ kHashSecret[1]) * (b ^ seed);
+  a = (uint64_t)product;
+  b = (uint64_t)(product >> 64);
+  return MulFold(a ^ kHashSecret[0] ^ size, b ^ kHashSecret[1]);
+}
+
+size_t String::Hash() const { return HashBytes(s_, size_); }
+
+// Length of the ASCII prefix of [data, data + size).
+// Checks 16 bytes per step with SSE2 (or 8 with a word mask otherwise).
+static size_t AsciiPrefix(const unsigned char* data, size_t size) {
+  size_t i = 0;
+#ifdef __SSE2__
+  const size_t kStep = 16;
+  for (; i + kStep <= size; i += kStep) {
+    __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+    int high_bits = _mm_movemask_epi8(block);
+    if (high_bits != 0) {
+      return i + __builtin_ctz(high_bits);
+    }
+  }
+#else
+  const uint64_t kHighBits = 0x8080808080808080ULL;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    if ((Read64(data + i) & kHighBits) != 0) {
+      break;
+    }
+  }
+#endif
+  while (i < size && data[i] < 0x80) {
+    i++;
+  }
+  return i;
+}
+
+static bool IsContinuation(unsigned char byte) { return (byte & 0xC0) == 0x80; }
+
+// Length of a well-formed UTF-8 sequence at data, 0 if it is malformed.
+// Second byte ranges follow the Unicode table "Well-Formed UTF-8 Byte
+// Sequences", they rule out overlong forms, surrogates and > U+10FFFF.
+static size_t SequenceLength(const unsigned char* data, size_t size) {
+  unsigned char lead = data[0];
+  size_t length = 0;
+  unsigned char low = 0x80;
+  unsigned char high = 0xBF;
+  if (lead < 0x80) {
+    return 1;
+  }
+  if (lead >= 0xC2 && lead <= 0xDF) {
+    length = 2;
+  } else if (lead >= 0xE0 && lead <= 0xEF) {
+    length = 3;
+    low = lead == 0xE0 ? 0xA0 : low;
+    high = lead == 0xED ? 0x9F : high;
+  } else if (lead >= 0xF0 && lead <= 0xF4) {
+    length = 4;
+    low = lead == 0xF0 ? 0x90 : low;
+    high = lead == 0xF4 ? 0x8F : high;
+  } else {
+    return 0;
+  }
+  if (size < length || data[1] < low || data[1] > high) {
+    return 0;
+  }
+  for (size_t i = 2; i < length; i++) {
+    if (!IsContinuation(data[i])) {
+      return 0;
+    }
+  }
+  return length;
+}
+
+bool String::IsValidUtf8() const {
+  const unsigned char* data = (const unsigned char*)s_;
+  size_t i = 0;
+  while (i < size_) {
+    i += AsciiPrefix(data + i, size_ - i);
+    // stay on the scalar path while the text is not ASCII
+    while (i < size_ && data[i] >= 0x80) {
+      size_t length = SequenceLength(data + i, size_ - i);
+      if (length == 0) {
+        return false;
+      }
+      i += length;
+    }
+  }
+  return true;
+}
+
+size_t String::CodePointCount() const {
+  const unsigned char* data = (const unsigned char*)s_;
+  size_t count = 0;
+  size_t i = 0;
+#ifdef __SSE2__
+  // continuation bytes 0x80..0xBF are exactly the signed bytes below -64
+  const size_t kStep = 16;
+  const __m128i kLastContinuation = _mm_set1_epi8((char)0xBF);
+  for (; i + kStep <= size_; i += kStep) {
+    __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+    int leading = _mm_movemask_epi8(_mm_cmpgt_epi8(block, kLastContinuation));
+    count += __builtin_popcount(leading);
+  }
+#endif
+  for (; i < size_; i++) {
+    count += IsContinuation(data[i]) ? 0 : 1;
+  }
+  return count;
+}
+
+String::CodePointIterator::CodePointIterator(const char* pos, const char* end)
+    : pos_(pos), end_(end) {
+  Decode();
+}
+
+void String::CodePointIterator::Decode() {
+  if (pos_ == end_) {
+    return;
+  }
+  const unsigned char* data = (const unsigned char*)pos_;
+  length_ = SequenceLength(data, end_ - pos_);
+  if (length_ == 0) {
+    const char32_t kReplacementCharacter = 0xFFFD;
+    length_ = 1;
+    code_point_ = kReplacementCharacter;
+    return;
+  }
+  if (length_ == 1) {
+    code_point_ = data[0];
+    return;
+  }
+  // the lead byte keeps 7 - length payload bits, the others keep 6
+  code_point_ = data[0] & (0x7F >> length_);
+  for (size_t i = 1; i < length_; i++) {
+    code_point_ = (code_point_ << 6) | (data[i] & 0x3F);
+  }
+}
+
+String::CodePointIterator& String::CodePointIterator::operator++() {
+  pos_ += length_;
+  Decode();
+  return *this;
+}
+
+String::CodePointIterator String::CodePointBegin() const {
+  return CodePointIterator(s_, s_ + size_);
+}
+
+String::CodePointIterator String::CodePointEnd() const {
+  return CodePointIterator(s_ + size_, s_ + size_);
+}
+
 bool operator<(const String& s1, const String& s2) {
   size_t size = Min(s1.Size(), s2.Size());
   for (size_t i = 0; i < size; i++) {
@@ -122,14 +338,7 @@ bool operator==(const String& s1, const String& s2) {
     return false;
   }
 
-  size_t size = s1.Size();
-
-  for (size_t i = 0; i < size; i++) {
-    if (s1[i] != s2[i]) {
-      return false;
-    }
-  }
-  return true;
+  return s1.Size() == 0 || memcmp(s1.Data(), s2.Data(), s1.Size()) == 0;
 }
 
 bool operator!=(const String& s1, const String& s2) { return !(s1 == s2); }
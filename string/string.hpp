@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <functional>
 #include <iostream>
 #include <vector>
 
@@ -130,8 +131,59 @@ class String {
   // Аналог джоина в питоне.
   String Join(const std::vector<String>& strings) const;
 
+  // Быстрый некриптографический хэш содержимого (семейство wyhash)
+  size_t Hash() const;
+
+  // Итератор по кодовым точкам UTF-8.
+  // Некорректная последовательность выдается как U+FFFD длиной в один байт
+  class CodePointIterator {
+   public:
+    char32_t operator*() const { return code_point_; }
+    CodePointIterator& operator++();
+    bool operator==(const CodePointIterator& other) const {
+      return pos_ == other.pos_;
+    }
+    bool operator!=(const CodePointIterator& other) const {
+      return pos_ != other.pos_;
+    }
+
+   private:
+    friend class String;
+
+    CodePointIterator(const char* pos, const char* end);
+
+    // декодирует кодовую точку, начинающуюся в pos_
+    void Decode();
+
+    const char* pos_;
+    const char* end_;
+    size_t length_ = 0;
+    char32_t code_point_ = 0;
+  };
+
+  // true, если строка - корректный UTF-8
+  // (без overlong-кодировок, суррогатов и значений больше U+10FFFF)
+  bool IsValidUtf8() const;
+
+  // число кодовых точек; для некорректного UTF-8 -
+  // число байт, не являющихся продолжением последовательности
+  size_t CodePointCount() const;
+
+  CodePointIterator CodePointBegin() const;
+  CodePointIterator CodePointEnd() const;
+
  private:
   char* s_ = nullptr;
   size_t size_ = 0;
   size_t capacity_ = 0;
-};
\ No newline at end of file
+};
+
+// хэш size байт, начиная с data; совпадает с String::Hash()
+size_t HashBytes(const char* data, size_t size);
+
+namespace std {
+template <>
+struct hash<String> {
+  size_t operator()(const String& s) const { return s.Hash(); }
+};
+}  // namespace std
@@ -0,0 +1,128 @@
+#include "string_pool.hpp"
+
+#include <cstring>
+#include <new>
+
+String Atom::ToString() const {
+  String res;
+  res.Resize(Size());
+  memcpy((void*)res.Data(), Data(), Size());
+  return res;
+}
+
+std::ostream& operator<<(std::ostream& output, const Atom& atom) {
+  output.write(atom.Data(), atom.Size());
+  return output;
+}
+
+StringPool::~StringPool() {
+  for (Stripe& stripe : stripes_) {
+    for (char* block : stripe.blocks) {
+      delete[] block;
+    }
+  }
+}
+
+Atom StringPool::Intern(const char* data, size_t size) {
+  if (size == 0) {
+    return Atom();
+  }
+  size_t hash = HashBytes(data, size);
+  // low bits pick the slot inside a stripe, so take the stripe from the top
+  Stripe& stripe = stripes_[(hash >> (sizeof(size_t) * 8 - 4)) % kStripeCount];
+  std::lock_guard<std::mutex> lock(stripe.mutex);
+  const Record* record = stripe.Find(data, size, hash);
+  if (record == nullptr) {
+    record = stripe.Add(data, size, hash);
+  }
+  return Atom(record);
+}
+
+Atom StringPool::Intern(const char* c_string) {
+  return Intern(c_string, strlen(c_string));
+}
+
+Atom StringPool::Intern(const String& string) {
+  return Intern(string.Data(), string.Size());
+}
+
+size_t StringPool::Size() const {
+  size_t size = 0;
+  for (const Stripe& stripe : stripes_) {
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    size += stripe.count;
+  }
+  return size;
+}
+
+const Atom::Record* StringPool::Stripe::Find(const char* data, size_t size,
+                                             size_t hash) const {
+  if (slots.empty()) {
+    return nullptr;
+  }
+  size_t mask = slots.size() - 1;
+  for (size_t i = hash & mask; slots[i] != nullptr; i = (i + 1) & mask) {
+    const Record* record = slots[i];
+    if (record->hash == hash && record->size == size &&
+        memcmp(record->Chars(), data, size) == 0) {
+      return record;
+    }
+  }
+  return nullptr;
+}
+
+const Atom::Record* StringPool::Stripe::Add(const char* data, size_t size,
+                                            size_t hash) {
+  // keep the load factor at most 1/2
+  if (2 * (count + 1) > slots.size()) {
+    Grow();
+  }
+  void* raw = Allocate(sizeof(Record) + size + 1);
+  Record* record = new (raw) Record{size, hash};
+  char* chars = reinterpret_cast<char*>(record + 1);
+  memcpy(chars, data, size);
+  chars[size] = '\0';
+  Insert(record);
+  return record;
+}
+
+void StringPool::Stripe::Insert(const Record* record) {
+  size_t mask = slots.size() - 1;
+  size_t i = record->hash & mask;
+  while (slots[i] != nullptr) {
+    i = (i + 1) & mask;
+  }
+  slots[i] = record;
+  count++;
+}
+
+void StringPool::Stripe::Grow() {
+  const size_t kInitialSlots = 16;
+  std::vector<const Record*> old;
+  old.swap(slots);
+  slots.resize(old.empty() ? kInitialSlots : old.size() * 2, nullptr);
+  count = 0;
+  for (const Record* record : old) {
+    if (record != nullptr) {
+      Insert(record);
+    }
+  }
+}
+
+void* StringPool::Stripe::Allocate(size_t bytes) {
+  const size_t kAlignment = alignof(Record);
+  bytes = (bytes + kAlignment - 1) / kAlignment * kAlignment;
+  if (bytes > kArenaBlockSize / 4) {
+    // long strings get their own block, the current one keeps being filled
+    char* block = new char[bytes];
+    blocks.insert(blocks.end() - (blocks.empty() ? 0 : 1), block);
+    return block;
+  }
+  if (block_used + bytes > kArenaBlockSize) {
+    blocks.push_back(new char[kArenaBlockSize]);
+    block_used = 0;
+  }
+  void* res = blocks.back() + block_used;
+  block_used += bytes;
+  return res;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include "string.hpp"
+
+class StringPool;
+
+// Дескриптор строки, интернированной в StringPool.
+// Одинаковые строки из одного пула получают один и тот же Atom,
+// поэтому сравнение и хэш работают за O(1).
+class Atom {
+ public:
+  // Пустая строка
+  Atom() = default;
+
+  size_t Size() const { return record_ == nullptr ? 0 : record_->size; }
+  bool Empty() const { return Size() == 0; }
+
+  // возвращает указатель на начало (нуль-терминированной) строки в пуле
+  const char* Data() const {
+    return record_ == nullptr ? "" : record_->Chars();
+  }
+
+  // хэш содержимого, посчитанный при интернировании
+  size_t Hash() const { return record_ == nullptr ? 0 : record_->hash; }
+
+  // копия содержимого в обычную String
+  String ToString() const;
+
+  // Сравнение атомов одного пула за O(1)
+  bool operator==(const Atom& other) const { return record_ == other.record_; }
+  bool operator!=(const Atom& other) const { return record_ != other.record_; }
+
+  friend std::ostream& operator<<(std::ostream& output, const Atom& atom);
+
+ private:
+  friend class StringPool;
+
+  // Заголовок записи в арене, символы лежат сразу за ним
+  struct Record {
+    size_t size;
+    size_t hash;
+
+    const char* Chars() const {
+      return reinterpret_cast<const char*>(this + 1);
+    }
+  };
+
+  explicit Atom(const Record* record) : record_(record) {}
+
+  const Record* record_ = nullptr;
+};
+
+namespace std {
+template <>
+struct hash<Atom> {
+  size_t operator()(const Atom& atom) const { return atom.Hash(); }
+};
+}  // namespace std
+
+// Пул интернированных строк.
+// Содержимое копируется в арену пула один раз и живет до уничтожения пула.
+// Таблица разбита на kStripeCount независимых частей со своими мьютексами,
+// поэтому Intern можно вызывать из нескольких потоков одновременно.
+class StringPool {
+ public:
+  static const size_t kStripeCount = 16;
+  static const size_t kArenaBlockSize = 1 << 16;
+
+  StringPool() = default;
+  StringPool(const StringPool& other) = delete;
+  StringPool& operator=(const StringPool& other) = delete;
+  ~StringPool();
+
+  // возвращает атом для строки, добавляя ее в пул при первом обращении
+  Atom Intern(const char* data, size_t size);
+  Atom Intern(const char* c_string);
+  Atom Intern(const String& string);
+
+  // число различных строк в пуле
+  size_t Size() const;
+
+ private:
+  using Record = Atom::Record;
+
+  struct Stripe {
+    mutable std::mutex mutex;
+    // открытая адресация с линейным пробированием, размер - степень двойки
+    std::vector<const Record*> slots;
+    size_t count = 0;
+    // блоки арены; последний из них заполняется
+    std::vector<char*> blocks;
+    size_t block_used = kArenaBlockSize;
+
+    const Record* Find(const char* data, size_t size, size_t hash) const;
+    const Record* Add(const char* data, size_t size, size_t hash);
+    void Insert(const Record* record);
+    void Grow();
+    void* Allocate(size_t bytes);
+  };
+
+  Stripe stripes_[kStripeCount];
+};
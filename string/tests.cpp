@@ -1,7 +1,12 @@
 #include "string.hpp"
+#include "rope.hpp"
+#include "shared_string.hpp"
+#include "string_pool.hpp"
 #include <gtest/gtest.h>
 
 #include <random>
+#include <thread>
+#include <unordered_map>
 
 TEST(Constructors, Default) {
   String s;
@@ -422,6 +427,185 @@ TEST(Join, Stress) {
   EXPECT_TRUE(expected == b.Join({a, a}).Join({c, c}));
 }
 
+TEST(SharedString, CopyIsShallow) {
+  SharedString s = "aboba";
+  SharedString t = s;
+  ASSERT_EQ(s.Data(), t.Data());
+  ASSERT_EQ(s.UseCount(), 2);
+  ASSERT_TRUE(s == t);
+}
+
+TEST(SharedString, WriteDetaches) {
+  SharedString s = "aboba";
+  SharedString t = s;
+  t[0] = 'c';
+  ASSERT_NE(s.Data(), t.Data());
+  ASSERT_EQ(s.UseCount(), 1);
+  ASSERT_TRUE(s.ToString() == "aboba");
+  ASSERT_TRUE(t.ToString() == "cboba");
+}
+
+TEST(SharedString, WriteAfterCopy) {
+  SharedString s = "aboba";
+  char& c = s[0];
+  SharedString t = s;
+  SharedString u;
+  u = s;
+  c = 'x';
+  ASSERT_TRUE(s.ToString() == "xboba");
+  ASSERT_TRUE(t.ToString() == "aboba");
+  ASSERT_TRUE(u.ToString() == "aboba");
+  ASSERT_EQ(s.UseCount(), 1);
+  ASSERT_EQ(t.UseCount(), 1);
+}
+
+TEST(SharedString, Empty) {
+  SharedString s;
+  SharedString t = String();
+  ASSERT_TRUE(s.Empty());
+  ASSERT_EQ(s.UseCount(), 0);
+  ASSERT_TRUE(s == t);
+}
+
+TEST(Rope, InsertErase) {
+  Rope r = "aboba";
+  r.Insert(2, "biba");
+  EXPECT_TRUE(r.Flatten() == "abbibaoba");
+  r.Erase(1, 4);
+  EXPECT_TRUE(r.Flatten() == "aaoba");
+  EXPECT_EQ(r[2], 'o');
+}
+
+TEST(Rope, Stress) {
+  std::mt19937 gen(42);
+  std::string expected;
+  Rope r;
+  const size_t num_iterations = 1 << 12;
+  for (size_t i = 0; i < num_iterations; ++i) {
+    size_t pos = expected.empty() ? 0 : gen() % (expected.size() + 1);
+    if (gen() % 3 != 0) {
+      String to_add(gen() % 1000, 'a' + gen() % 26);
+      expected.insert(pos, to_add.Data(), to_add.Size());
+      r.Insert(pos, to_add);
+    } else {
+      size_t count = gen() % 700;
+      expected.erase(pos, count);
+      r.Erase(pos, count);
+    }
+  }
+  ASSERT_EQ(r.Size(), expected.size());
+  EXPECT_TRUE(r.Flatten() == expected.data());
+  std::stringstream os;
+  os << r.Substr(expected.size() / 3, 5000);
+  EXPECT_EQ(os.str(), expected.substr(expected.size() / 3, 5000));
+  std::string iterated;
+  for (char c : r) {
+    iterated.push_back(c);
+  }
+  EXPECT_EQ(iterated, expected);
+}
+
+TEST(StringPool, SameContentSameAtom) {
+  StringPool pool;
+  Atom a = pool.Intern("aboba");
+  Atom b = pool.Intern(String("abo") + "ba");
+  Atom c = pool.Intern("biba");
+  EXPECT_TRUE(a == b);
+  EXPECT_TRUE(a != c);
+  EXPECT_EQ(a.Data(), b.Data());
+  EXPECT_EQ(std::hash<Atom>()(a), std::hash<Atom>()(b));
+  EXPECT_TRUE(a.ToString() == "aboba");
+  EXPECT_EQ(pool.Size(), 2);
+  EXPECT_TRUE(pool.Intern("") == Atom());
+}
+
+TEST(StringPool, Concurrent) {
+  StringPool pool;
+  const size_t num_threads = 4;
+  const size_t num_strings = 1 << 12;
+  std::vector<std::vector<Atom>> atoms(num_threads);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&pool, &atoms, t] {
+      for (size_t i = 0; i < num_strings; ++i) {
+        atoms[t].push_back(pool.Intern(std::to_string(i).c_str()));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(pool.Size(), num_strings);
+  for (size_t t = 1; t < num_threads; ++t) {
+    EXPECT_TRUE(atoms[t] == atoms[0]);
+  }
+}
+
+TEST(Hash, UnorderedMap) {
+  std::unordered_map<String, int> map;
+  const int num_keys = 1000;
+  for (int i = 0; i < num_keys; ++i) {
+    map[String(std::to_string(i).c_str()) * 7] = i;
+  }
+  ASSERT_EQ(map.size(), num_keys);
+  for (int i = 0; i < num_keys; ++i) {
+    ASSERT_EQ(map[String(std::to_string(i).c_str()) * 7], i);
+  }
+}
+
+TEST(Hash, SharedStringCache) {
+  String s = String("aboba") * 20;
+  SharedString t = s;
+  SharedString u = t;
+  EXPECT_EQ(t.Hash(), s.Hash());
+  EXPECT_EQ(u.Hash(), s.Hash());
+  u[0] = 'c';
+  EXPECT_NE(u.Hash(), s.Hash());
+  EXPECT_EQ(u.Hash(), u.ToString().Hash());
+  EXPECT_FALSE(t == u);
+}
+
+TEST(Hash, SharedStringWriteThroughReference) {
+  SharedString u = String("aboba") * 20;
+  char& d = u[0];
+  size_t before = u.Hash();
+  d = 'z';
+  EXPECT_NE(u.Hash(), before);
+  EXPECT_EQ(u.Hash(), u.ToString().Hash());
+  SharedString v = u;
+  EXPECT_TRUE(u == v);
+  d = 'y';
+  EXPECT_FALSE(u == v);
+  EXPECT_EQ(v.Hash(), v.ToString().Hash());
+}
+
+TEST(Utf8, Validation) {
+  EXPECT_TRUE(String("").IsValidUtf8());
+  EXPECT_TRUE(String("plain ascii text, long enough for a vector step").IsValidUtf8());
+  EXPECT_TRUE(String("\xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 \xe2\x82\xac \xf0\x9f\x98\x80").IsValidUtf8());
+  EXPECT_FALSE(String("\xc0\xaf").IsValidUtf8());
+  EXPECT_FALSE(String("\xed\xa0\x80").IsValidUtf8());
+  EXPECT_FALSE(String("\xf4\x90\x80\x80").IsValidUtf8());
+  EXPECT_FALSE(String("0123456789abcdef\xe2\x82").IsValidUtf8());
+  EXPECT_FALSE(String("\x80").IsValidUtf8());
+}
+
+TEST(Utf8, CodePoints) {
+  String s = String("\xd0\xbf\xd1\x80\xd0\xb8 \xe2\x82\xac \xf0\x9f\x98\x80 ") * 5;
+  ASSERT_EQ(s.CodePointCount(), 40);
+  std::vector<char32_t> expected{0x43F, 0x440, 0x438, ' ', 0x20AC, ' ', 0x1F600, ' '};
+  std::vector<char32_t> decoded;
+  for (auto it = s.CodePointBegin(); it != s.CodePointEnd(); ++it) {
+    decoded.push_back(*it);
+  }
+  ASSERT_EQ(decoded.size(), 40);
+  EXPECT_TRUE(std::equal(expected.begin(), expected.end(), decoded.begin()));
+  String broken = "a\xff" "b";
+  auto it = broken.CodePointBegin();
+  EXPECT_EQ(*++it, 0xFFFD);
+  EXPECT_EQ(*++it, 'b');
+}
+
 
 int main(int argc, char **argv) {
   testing::InitGoogleTest(&argc, argv);